@@ -0,0 +1,2 @@
+/* host build: see tfa_host_shim.h */
+#include "../../tfa_host_shim.h"
@@ -0,0 +1 @@
+/* host build: trace events are not created, see tfa_host_shim.h */
@@ -0,0 +1,91 @@
+/*
+ * Copyright 2020 GOODIX, All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ */
+
+/*
+ * Offline container compiler.
+ * usage: tfa_cont_compile <legacy.cnt> <compiled.cnt>
+ * The output is accepted by the driver in place of the legacy file.
+ */
+
+#include "tfa_host.h"
+
+static uint8_t *tfa_host_read_file(const char *path, int *length)
+{
+	uint8_t *data;
+	long size;
+	FILE *f;
+
+	f = fopen(path, "rb");
+	if (f == NULL)
+		return NULL;
+	fseek(f, 0, SEEK_END);
+	size = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	data = malloc(size > 0 ? size : 1);
+	if (data && fread(data, 1, size, f) != (size_t)size) {
+		free(data);
+		data = NULL;
+	}
+	fclose(f);
+	*length = (int)size;
+
+	return data;
+}
+
+int main(int argc, char **argv)
+{
+	struct tfa_cont_compile_stats stats;
+	struct tfa_cont_image *img;
+	uint8_t *data, *out;
+	int length, out_len;
+	FILE *f;
+
+	if (argc != 3) {
+		fprintf(stderr, "usage: %s <legacy.cnt> <compiled.cnt>\n",
+			argv[0]);
+		return 2;
+	}
+
+	data = tfa_host_read_file(argv[1], &length);
+	if (data == NULL) {
+		perror(argv[1]);
+		return 1;
+	}
+
+	memset(&stats, 0, sizeof(stats));
+	out = tfa_cont_compile(data, length, &out_len, &stats);
+	if (out == NULL) {
+		fprintf(stderr, "%s: not a valid legacy container\n", argv[1]);
+		return 1;
+	}
+
+	/* the driver must take what we produce */
+	img = tfa_cont_image_create(out, out_len);
+	if (img == NULL) {
+		fprintf(stderr, "compiled container does not load\n");
+		return 1;
+	}
+	tfa_cont_image_put(img);
+
+	f = fopen(argv[2], "wb");
+	if (f == NULL || fwrite(out, 1, out_len, f) != (size_t)out_len) {
+		perror(argv[2]);
+		return 1;
+	}
+	fclose(f);
+
+	printf("%s: %d -> %d bytes, %d profiles, %d register items in %d entries\n",
+		argv[2], length, out_len, stats.profiles, stats.reg_items,
+		stats.reg_entries);
+
+	free(out);
+	free(data);
+
+	return 0;
+}
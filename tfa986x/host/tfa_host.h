@@ -0,0 +1,75 @@
+/*
+ * Copyright 2020 GOODIX, All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ */
+
+#ifndef __TFA_HOST_H__
+#define __TFA_HOST_H__
+
+#include "tfa_host_shim.h"
+#include "../inc/tfa.h"
+#include "../inc/tfa_device.h"
+#include "../inc/tfa_container.h"
+#include "../inc/tfa_internal.h"
+
+/* stub amplifier: register file plus bus/DSP traffic counters */
+struct tfa_host_dev {
+	struct tfa_device tfa;
+	uint16_t regs[256];
+	unsigned long reg_reads;
+	unsigned long reg_writes;
+	unsigned long dsp_msgs;
+	unsigned long dsp_bytes;
+};
+
+extern struct tfa_host_dev tfa_host_devs[MAX_HANDLES];
+extern int tfa_host_ndev;
+
+/*
+ * Attach stub devices to a container and probe them like the driver does.
+ * @param cnt container, validated
+ * @param ndev nr of devices to attach (responder 0x34 + index)
+ * @return 0 on success
+ */
+int tfa_host_attach(struct tfa_container *cnt, int ndev);
+
+/* clear the traffic counters of all stub devices */
+void tfa_host_reset_counters(void);
+
+/*
+ * Build a synthetic container in the legacy format.
+ * @param ndev nr of device lists
+ * @param nprof nr of profiles per device
+ * @param nregs nr of register/bitfield items per profile
+ * @param msg_size payload size of the msg file in each profile
+ * @param length returns the container length in bytes
+ * @return malloc'ed container, CRC filled in
+ */
+uint8_t *tfa_host_cnt_build(int ndev, int nprof, int nregs,
+	int msg_size, int *length);
+
+/* recompute the CRC field of a container buffer, legacy or compiled */
+void tfa_host_cnt_fix_crc(uint8_t *buf, size_t length);
+
+struct tfa_cont_compile_stats {
+	int reg_items;	/* register and bitfield items compiled */
+	int reg_entries;	/* entries after merging */
+	int profiles;
+};
+
+/*
+ * Compile a legacy container into the v2 format.
+ * @param data legacy container, checked like the driver does
+ * @param length its length in bytes
+ * @param out_len returns the compiled length
+ * @param stats optional, filled in
+ * @return malloc'ed compiled container, or NULL
+ */
+uint8_t *tfa_cont_compile(const uint8_t *data, int length, int *out_len,
+	struct tfa_cont_compile_stats *stats);
+
+#endif /* __TFA_HOST_H__ */
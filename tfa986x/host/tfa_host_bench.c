@@ -0,0 +1,173 @@
+/*
+ * Copyright 2020 GOODIX, All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ */
+
+/*
+ * Micro-benchmark of the container path on the host: image creation,
+ * lookups, and a profile write against the stub register backend, for
+ * the legacy container and its compiled (v2) form.
+ * usage: tfa_host_bench [ndev nprof nregs msg_size]
+ */
+
+#include "tfa_host.h"
+
+#define BENCH_ROUNDS	200
+#define BENCH_LOOKUPS	100000
+
+static double tfa_host_ns(ktime_t start, long ops)
+{
+	return (double)(ktime_get_boottime() - start) / ops;
+}
+
+static int tfa_host_bench(const char *label, uint8_t *data, int length,
+	int ndev, int nprof, uint16_t regs[][256])
+{
+	struct tfa_cont_image *img;
+	struct tfa_container *cnt;
+	volatile size_t sink = 0;
+	unsigned long reads = 0, writes = 0, msgs = 0, bytes = 0;
+	int i, dev, prof;
+	ktime_t start;
+
+	printf("%s: %d bytes\n", label, length);
+
+	start = ktime_get_boottime();
+	for (i = 0; i < BENCH_ROUNDS; i++) {
+		img = tfa_cont_image_create(data, length);
+		if (img == NULL) {
+			fprintf(stderr, "image create failed\n");
+			return 1;
+		}
+		tfa_cont_image_put(img);
+	}
+	printf("  %-28s %12.0f ns/op\n", "tfa_cont_image_create",
+		tfa_host_ns(start, BENCH_ROUNDS));
+
+	img = tfa_cont_image_create(data, length);
+	tfa_cont_image_publish(tfa_cont_image_get(img));
+	cnt = tfa_cont_image_container(img);
+
+	start = ktime_get_boottime();
+	for (i = 0; i < BENCH_LOOKUPS; i++)
+		sink += (size_t)tfa_cont_get_dev_prof_list(cnt,
+			i % ndev, i % nprof);
+	printf("  %-28s %12.1f ns/op\n", "tfa_cont_get_dev_prof_list",
+		tfa_host_ns(start, BENCH_LOOKUPS));
+
+	start = ktime_get_boottime();
+	for (i = 0; i < BENCH_LOOKUPS; i++)
+		sink += strlen(tfa_cont_profile_name(cnt,
+			i % ndev, i % nprof));
+	printf("  %-28s %12.1f ns/op\n", "tfa_cont_profile_name",
+		tfa_host_ns(start, BENCH_LOOKUPS));
+
+	if (tfa_host_attach(cnt, ndev)) {
+		fprintf(stderr, "cannot attach stub devices\n");
+		return 1;
+	}
+
+	start = ktime_get_boottime();
+	for (i = 0; i < BENCH_LOOKUPS; i++)
+		sink += (size_t)tfa_cont_get_file_data(&tfa_host_devs[0].tfa,
+			i % nprof, msg_hdr);
+	printf("  %-28s %12.1f ns/op\n", "tfa_cont_get_file_data",
+		tfa_host_ns(start, BENCH_LOOKUPS));
+
+	tfa_host_reset_counters();
+	start = ktime_get_boottime();
+	for (prof = 0; prof < nprof; prof++)
+		for (dev = 0; dev < ndev; dev++) {
+			tfa_cont_write_profile(&tfa_host_devs[dev].tfa,
+				prof, 0);
+			tfa_dev_set_swprof(&tfa_host_devs[dev].tfa,
+				(unsigned short)prof);
+		}
+	printf("  %-28s %12.0f ns/op\n", "tfa_cont_write_profile",
+		tfa_host_ns(start, (long)nprof * ndev));
+
+	for (dev = 0; dev < ndev; dev++) {
+		memcpy(regs[dev], tfa_host_devs[dev].regs, sizeof(regs[dev]));
+		reads += tfa_host_devs[dev].reg_reads;
+		writes += tfa_host_devs[dev].reg_writes;
+		msgs += tfa_host_devs[dev].dsp_msgs;
+		bytes += tfa_host_devs[dev].dsp_bytes;
+	}
+	printf("  per profile switch: %.1f reg reads, %.1f reg writes, %.1f dsp msgs, %.0f dsp bytes\n",
+		(double)reads / (nprof * ndev),
+		(double)writes / (nprof * ndev),
+		(double)msgs / (nprof * ndev),
+		(double)bytes / (nprof * ndev));
+
+	tfa_cont_image_publish(NULL);
+	tfa_cont_image_put(img);
+	(void)sink;
+
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	static uint16_t regs[MAX_HANDLES][256], regs2[MAX_HANDLES][256];
+	struct tfa_cont_compile_stats stats;
+	int ndev = 2, nprof = 8, nregs = 16, msg_size = 2048;
+	int length, length2;
+	uint8_t *data, *data2;
+	ktime_t start;
+	int i;
+
+	if (argc > 4) {
+		ndev = atoi(argv[1]);
+		nprof = atoi(argv[2]);
+		nregs = atoi(argv[3]);
+		msg_size = atoi(argv[4]);
+	}
+	if (ndev < 1 || ndev > MAX_HANDLES || nprof < 1
+		|| nprof > TFACONT_MAXPROFS || nregs < 0 || msg_size < 0) {
+		fprintf(stderr, "bad arguments\n");
+		return 1;
+	}
+
+	data = tfa_host_cnt_build(ndev, nprof, nregs, msg_size, &length);
+	printf("container: %d devices, %d profiles\n", ndev, nprof);
+
+	if (tfa_load_cnt(data, length) != tfa_error_ok) {
+		fprintf(stderr, "generated container does not load\n");
+		return 1;
+	}
+
+	start = ktime_get_boottime();
+	for (i = 0; i < BENCH_ROUNDS; i++)
+		tfa_load_cnt(data, length);
+	printf("%-30s %12.0f ns/op\n", "tfa_load_cnt",
+		tfa_host_ns(start, BENCH_ROUNDS));
+
+	memset(&stats, 0, sizeof(stats));
+	data2 = tfa_cont_compile(data, length, &length2, &stats);
+	if (data2 == NULL) {
+		fprintf(stderr, "cannot compile container\n");
+		return 1;
+	}
+	printf("compiled: %d register items in %d entries\n",
+		stats.reg_items, stats.reg_entries);
+
+	if (tfa_host_bench("legacy", data, length, ndev, nprof, regs)
+		|| tfa_host_bench("compiled", data2, length2, ndev, nprof,
+		regs2))
+		return 1;
+
+	/* both forms must leave the devices in the same state */
+	if (memcmp(regs, regs2, ndev * sizeof(regs[0]))) {
+		fprintf(stderr, "compiled register state differs\n");
+		return 1;
+	}
+
+	free(data2);
+	free(data);
+
+	return 0;
+}
@@ -0,0 +1,227 @@
+/*
+ * Copyright 2020 GOODIX, All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ */
+
+/*
+ * Synthetic container generator, legacy (PM) format.
+ * Each device gets a bitfield item and its profile lists; a profile holds
+ * bitfields (four to a register) and register patches, one msg file, a
+ * default section and one bitfield after it. The msg payload only depends on the profile
+ * index, so devices carry byte-identical copies of it.
+ */
+
+#include "tfa_host.h"
+
+struct tfa_host_buf {
+	uint8_t *data;
+	size_t len;
+	size_t cap;
+};
+
+static uint32_t tfa_host_put(struct tfa_host_buf *b,
+	const void *p, size_t len)
+{
+	uint32_t offset = (uint32_t)b->len;
+
+	if (b->len + len > b->cap) {
+		b->cap = (b->len + len) * 2;
+		b->data = realloc(b->data, b->cap);
+		if (b->data == NULL) {
+			perror("realloc");
+			exit(1);
+		}
+	}
+	if (p)
+		memcpy(b->data + b->len, p, len);
+	else
+		memset(b->data + b->len, 0, len);
+	b->len += len;
+
+	return offset;
+}
+
+static struct tfa_desc_ptr tfa_host_dsc(uint32_t offset, int type)
+{
+	struct tfa_desc_ptr dsc;
+
+	dsc.offset = offset;
+	dsc.type = type;
+
+	return dsc;
+}
+
+static struct tfa_desc_ptr tfa_host_put_string(struct tfa_host_buf *b,
+	const char *s)
+{
+	return tfa_host_dsc(tfa_host_put(b, s, strlen(s) + 1), dsc_string);
+}
+
+static struct tfa_desc_ptr tfa_host_put_msg(struct tfa_host_buf *b,
+	int prof, int msg_size)
+{
+	struct tfa_file_dsc dsc;
+	struct tfa_header hdr;
+	char name[32];
+	uint32_t offset;
+	uint8_t *payload;
+	int i;
+
+	snprintf(name, sizeof(name), "prof%d.msg", prof);
+	dsc.name = tfa_host_put_string(b, name);
+	dsc.size = sizeof(hdr) + msg_size;
+
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.id = msg_hdr;
+	memcpy(hdr.version, "1_", 2);
+	memcpy(hdr.subversion, "00", 2);
+	hdr.size = (uint16_t)(sizeof(hdr) + msg_size);
+	memcpy(hdr.customer, "host", 4);
+
+	payload = malloc(msg_size);
+	for (i = 0; i < msg_size; i++)
+		payload[i] = (uint8_t)(prof * 31 + i);
+
+	offset = tfa_host_put(b, &dsc, sizeof(dsc));
+	tfa_host_put(b, &hdr, sizeof(hdr));
+	tfa_host_put(b, payload, msg_size);
+	free(payload);
+
+	return tfa_host_dsc(offset, dsc_file);
+}
+
+static struct tfa_desc_ptr tfa_host_put_bitfield(struct tfa_host_buf *b,
+	int addr, int pos, int len, uint16_t value)
+{
+	struct tfa_bitfield bf;
+
+	bf.field = (uint16_t)(addr << 8 | pos << 4 | (len - 1));
+	bf.value = value;
+
+	return tfa_host_dsc(tfa_host_put(b, &bf, sizeof(bf)), dsc_bit_field);
+}
+
+static struct tfa_desc_ptr tfa_host_put_reg(struct tfa_host_buf *b,
+	int addr, uint16_t value)
+{
+	struct tfa_reg_patch reg;
+
+	reg.address = (uint8_t)addr;
+	reg.value = value;
+	reg.mask = 0xffff;
+
+	return tfa_host_dsc(tfa_host_put(b, &reg, sizeof(reg)), dsc_register);
+}
+
+void tfa_host_cnt_fix_crc(uint8_t *buf, size_t length)
+{
+	struct tfa_container *cnt = (struct tfa_container *)buf;
+	size_t skip = offsetof(struct tfa_container, rev);
+	size_t crc_at = offsetof(struct tfa_container, crc);
+	uint32_t size = (uint32_t)length;
+	uint32_t crc;
+
+	if (length < sizeof(*cnt))
+		return;
+
+	if (HDR(cnt->id[0], cnt->id[1]) == params2_hdr) {
+		skip = offsetof(struct tfa_cont2_header, ndev);
+		crc_at = offsetof(struct tfa_cont2_header, crc);
+		memcpy(buf + offsetof(struct tfa_cont2_header, size), &size,
+			sizeof(size));
+	} else {
+		cnt->size = size;
+	}
+	crc = ~crc32_le(~0u, buf + skip, length - skip);
+	memcpy(buf + crc_at, &crc, sizeof(crc));
+}
+
+uint8_t *tfa_host_cnt_build(int ndev, int nprof, int nregs,
+	int msg_size, int *length)
+{
+	struct tfa_host_buf b = { NULL, 0, 0 };
+	struct tfa_container cnt;
+	struct tfa_desc_ptr *index, *list;
+	struct tfa_device_list dl;
+	struct tfa_profile_list pl;
+	int nindex = ndev + ndev * nprof;
+	uint32_t *prof_offset;
+	uint32_t index_offset;
+	char name[32];
+	int dev, prof, i, n;
+
+	memset(&cnt, 0, sizeof(cnt));
+	memcpy(cnt.id, "PM", 2);
+	cnt.version[0] = TFA_PM_VERSION;
+	cnt.version[1] = '_';
+	cnt.subversion[0] = '0';
+	cnt.subversion[1] = TFA_PM_SUBVERSION;
+	memcpy(cnt.customer, "host", 4);
+	memcpy(cnt.application, "bench", 5);
+	memcpy(cnt.type, "synth", 5);
+	cnt.ndev = (uint16_t)ndev;
+	cnt.nprof = (uint16_t)(ndev * nprof);
+
+	tfa_host_put(&b, &cnt, sizeof(cnt));
+	index_offset = tfa_host_put(&b, NULL,
+		nindex * sizeof(struct tfa_desc_ptr));
+
+	prof_offset = calloc(nprof, sizeof(*prof_offset));
+	list = calloc(max(nregs + 3, nprof + 1), sizeof(*list));
+
+	for (dev = 0; dev < ndev; dev++) {
+		for (prof = 0; prof < nprof; prof++) {
+			n = 0;
+			/* runs of 4 nibble fields in one register, then patches */
+			for (i = 0; i < nregs; i++)
+				list[n++] = (i % 8 < 4)
+					? tfa_host_put_bitfield(&b,
+						0x50 + (i / 8) % 16, (i % 4) * 4,
+						4, (uint16_t)((prof + i) & 0xf))
+					: tfa_host_put_reg(&b, 0x60 + i % 16,
+						(uint16_t)(prof * i));
+			list[n++] = tfa_host_put_msg(&b, prof, msg_size);
+			list[n++] = tfa_host_dsc(0, dsc_default);
+			list[n++] = tfa_host_put_bitfield(&b, 0x50, 0, 16, 0);
+
+			snprintf(name, sizeof(name), "prof%d", prof);
+			memset(&pl, 0, sizeof(pl));
+			pl.length = n;
+			pl.id = TFA_PROFID;
+			pl.name = tfa_host_put_string(&b, name);
+			prof_offset[prof] = tfa_host_put(&b, &pl, sizeof(pl));
+			tfa_host_put(&b, list, n * sizeof(*list));
+
+			index = (struct tfa_desc_ptr *)(b.data + index_offset);
+			index[ndev + dev * nprof + prof] =
+				tfa_host_dsc(prof_offset[prof], dsc_profile);
+		}
+
+		snprintf(name, sizeof(name), "tfa9866_%d", dev);
+		memset(&dl, 0, sizeof(dl));
+		dl.length = (uint8_t)(nprof + 1);
+		dl.dev = (uint8_t)(0x34 + dev);
+		dl.name = tfa_host_put_string(&b, name);
+		list[0] = tfa_host_put_bitfield(&b, 0x51, 0, 1, 1);
+		for (prof = 0; prof < nprof; prof++)
+			list[prof + 1] = tfa_host_dsc(prof_offset[prof],
+				dsc_profile);
+
+		index = (struct tfa_desc_ptr *)(b.data + index_offset);
+		index[dev] = tfa_host_dsc(tfa_host_put(&b, &dl, sizeof(dl)),
+			dsc_device);
+		tfa_host_put(&b, list, (nprof + 1) * sizeof(*list));
+	}
+
+	free(list);
+	free(prof_offset);
+
+	tfa_host_cnt_fix_crc(b.data, b.len);
+	*length = (int)b.len;
+
+	return b.data;
+}
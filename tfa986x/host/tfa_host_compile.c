@@ -0,0 +1,284 @@
+/*
+ * Copyright 2020 GOODIX, All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ */
+
+/*
+ * Container compiler: legacy (PM) container to compiled (v2) container.
+ * The register items the driver writes through tfa_cont_write_item() are
+ * turned into read-modify-write entries, and adjacent entries on the same
+ * register with disjoint masks are merged. Sections holding a mode item
+ * are left to the legacy walk.
+ */
+
+#include "tfa_host.h"
+#include "../inc/tfa9866_genregs.h"
+
+struct tfa_host_regs {
+	struct tfa_cont2_reg *reg;
+	int n;
+	int cap;
+	int merged; /* items folded into a previous entry */
+	int items;
+};
+
+/* sticky flags are write-1-to-clear: every item is a write of its own */
+static int tfa_host_reg_is_w1c(uint8_t address)
+{
+	return address == TFA98XX_STATUS_FLAGS0
+		|| address == TFA98XX_STATUS_FLAGS3;
+}
+
+static void tfa_host_regs_add(struct tfa_host_regs *t, int open,
+	uint8_t address, uint16_t mask, uint16_t value, uint8_t flags)
+{
+	struct tfa_cont2_reg *last = (t->n > open) ? &t->reg[t->n - 1] : NULL;
+
+	t->items++;
+	if (tfa_host_reg_is_w1c(address))
+		flags |= TFA_CONT2_REG_FORCE;
+	else if (last && last->address == address
+		&& !(last->mask & mask)) {
+		last->mask |= mask;
+		last->value = (last->value & ~mask) | (value & mask);
+		last->flags |= flags;
+		t->merged++;
+		return;
+	}
+
+	if (t->n == t->cap) {
+		t->cap = t->cap ? t->cap * 2 : 64;
+		t->reg = realloc(t->reg, t->cap * sizeof(*t->reg));
+	}
+	t->reg[t->n].address = address;
+	t->reg[t->n].flags = flags;
+	t->reg[t->n].mask = mask;
+	t->reg[t->n].value = value & mask;
+	t->n++;
+}
+
+/* one register or bitfield item, as tfa_set_bf()/tfa_run_write_register */
+static void tfa_host_regs_item(struct tfa_host_regs *t, int open,
+	const uint8_t *base, struct tfa_desc_ptr *dsc)
+{
+	const struct tfa_reg_patch *reg;
+	const struct tfa_bitfield *bf;
+	uint16_t msk, v;
+	uint8_t len, pos;
+
+	if (dsc->type == dsc_register) {
+		reg = (const struct tfa_reg_patch *)(base + dsc->offset);
+		tfa_host_regs_add(t, open, reg->address, reg->mask,
+			reg->value, TFA_CONT2_REG_FORCE);
+	} else if (dsc->type == dsc_bit_field) {
+		bf = (const struct tfa_bitfield *)(base + dsc->offset);
+		len = bf->field & 0x0f;
+		pos = (bf->field >> 4) & 0x0f;
+		msk = (uint16_t)(((1 << (len + 1)) - 1) << pos);
+		v = (uint16_t)(bf->value << pos);
+		/* value bits beyond the field are ORed in, as tfa_set_bf */
+		tfa_host_regs_add(t, open, bf->field >> 8, msk | v, v, 0);
+	}
+}
+
+/*
+ * items [from, to) of a list; TFA_CONT2_NONE when a mode item needs
+ * the legacy walk
+ */
+static void tfa_host_regs_section(struct tfa_host_regs *t,
+	const uint8_t *base, struct tfa_desc_ptr *list, int from, int to,
+	uint16_t *first, uint16_t *n)
+{
+	int open = t->n, i;
+
+	for (i = from; i < to; i++)
+		if (list[i].type == dsc_mode) {
+			*first = 0;
+			*n = TFA_CONT2_NONE;
+			return;
+		}
+
+	for (i = from; i < to; i++)
+		tfa_host_regs_item(t, open, base, &list[i]);
+
+	*first = (uint16_t)open;
+	*n = (uint16_t)(t->n - open);
+}
+
+static int tfa_host_is_file_item(int type)
+{
+	switch (type) {
+	case dsc_file:
+	case dsc_patch:
+	case dsc_set_input_select:
+	case dsc_set_output_select:
+	case dsc_set_program_config:
+	case dsc_set_lag_w:
+	case dsc_set_gains:
+	case dsc_set_vbat_factors:
+	case dsc_set_senses_cal:
+	case dsc_set_senses_delay:
+	case dsc_set_mb_drc:
+	case dsc_set_fw_use_case:
+	case dsc_set_vddp_config:
+	case dsc_cmd:
+	case dsc_filter:
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+static void tfa_host_compile_prof(struct tfa_host_regs *t,
+	const uint8_t *base, struct tfa_profile_list *prof,
+	struct tfa_cont2_prof *prof2)
+{
+	int length = prof->length, def, i;
+
+	for (def = 0; def < length; def++)
+		if (prof->list[def].type == dsc_default)
+			break;
+
+	/* as tfa_cont_write_profile(): where the file loop resumes */
+	prof2->resume = 0;
+	for (i = 0; i < def; i++)
+		if (!tfa_host_is_file_item(prof->list[i].type))
+			prof2->resume = (uint16_t)i;
+
+	tfa_host_regs_section(t, base, prof->list, 0, def,
+		&prof2->reg, &prof2->nreg);
+	if (def + 1 < length)
+		tfa_host_regs_section(t, base, prof->list, def + 1, length,
+			&prof2->def, &prof2->ndef);
+	else
+		prof2->def = prof2->ndef = 0;
+}
+
+static size_t tfa_host_align(size_t n)
+{
+	return (n + TFA_CONT2_ALIGN - 1) & ~(size_t)(TFA_CONT2_ALIGN - 1);
+}
+
+uint8_t *tfa_cont_compile(const uint8_t *data, int length, int *out_len,
+	struct tfa_cont_compile_stats *stats)
+{
+	struct tfa_cont_image *img;
+	struct tfa_container *cnt;
+	struct tfa_device_list *dl;
+	struct tfa_profile_list *prof;
+	struct tfa_host_regs regs = { NULL, 0, 0, 0, 0 };
+	struct tfa_cont2_dev dev2[TFACONT_MAXDEVS];
+	struct tfa_cont2_prof *prof2;
+	struct tfa_cont2_header hdr;
+	const uint8_t *base;
+	size_t sizes[TFA_CONT2_NSECT], offset;
+	const void *sect[TFA_CONT2_NSECT];
+	int nprof2 = 0, dev, idx, i, def;
+	uint8_t *out;
+	uint32_t crc;
+
+	/* same structure and CRC checks as the driver */
+	img = tfa_cont_image_create(data, length);
+	if (img == NULL)
+		return NULL;
+	cnt = tfa_cont_image_container(img);
+	if (HDR(cnt->id[0], cnt->id[1]) != params_hdr) {
+		tfa_cont_image_put(img);
+		return NULL; /* already compiled */
+	}
+	base = (const uint8_t *)cnt;
+
+	memset(dev2, 0, sizeof(dev2));
+	prof2 = calloc(cnt->ndev * TFACONT_MAXPROFS + 1, sizeof(*prof2));
+
+	for (dev = 0; dev < cnt->ndev; dev++) {
+		if (cnt->index[dev].type != dsc_device)
+			continue;
+		dl = (struct tfa_device_list *)(base + cnt->index[dev].offset);
+		dev2[dev].list = cnt->index[dev].offset;
+
+		/* as tfa_cont_write_regs_dev() */
+		for (def = 0; def < dl->length; def++)
+			if (dl->list[def].type == dsc_patch
+				|| dl->list[def].type == dsc_file
+				|| dl->list[def].type == dsc_profile)
+				break;
+		dev2[dev].reg = (uint16_t)regs.n;
+		for (i = 0; i < def; i++)
+			tfa_host_regs_item(&regs, dev2[dev].reg, base,
+				&dl->list[i]);
+		dev2[dev].nreg = (uint16_t)(regs.n - dev2[dev].reg);
+
+		dev2[dev].prof = (uint16_t)nprof2;
+		for (idx = 0; idx < dl->length; idx++) {
+			if (dl->list[idx].type != dsc_profile)
+				continue;
+			prof = (struct tfa_profile_list *)
+				(base + dl->list[idx].offset);
+			prof2[nprof2].list = dl->list[idx].offset;
+			tfa_host_compile_prof(&regs, base, prof,
+				&prof2[nprof2]);
+			nprof2++;
+			dev2[dev].nprof++;
+		}
+	}
+
+	if (regs.n >= TFA_CONT2_NONE) {
+		fprintf(stderr, "too many register items: %d\n", regs.n);
+		tfa_cont_image_put(img);
+		free(prof2);
+		free(regs.reg);
+		return NULL;
+	}
+
+	sect[TFA_CONT2_SECT_LEGACY] = cnt;
+	sizes[TFA_CONT2_SECT_LEGACY] = cnt->size;
+	sect[TFA_CONT2_SECT_DEVS] = dev2;
+	sizes[TFA_CONT2_SECT_DEVS] = cnt->ndev * sizeof(dev2[0]);
+	sect[TFA_CONT2_SECT_PROFS] = prof2;
+	sizes[TFA_CONT2_SECT_PROFS] = nprof2 * sizeof(prof2[0]);
+	sect[TFA_CONT2_SECT_REGS] = regs.reg;
+	sizes[TFA_CONT2_SECT_REGS] = regs.n * sizeof(regs.reg[0]);
+
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.id[0] = 'P';
+	hdr.id[1] = 'C';
+	hdr.version[0] = TFA_CONT2_VERSION;
+	hdr.version[1] = '_';
+	hdr.ndev = cnt->ndev;
+
+	offset = tfa_host_align(sizeof(hdr));
+	for (i = 0; i < TFA_CONT2_NSECT; i++) {
+		hdr.sect[i].offset = (uint32_t)offset;
+		hdr.sect[i].size = (uint32_t)sizes[i];
+		offset = tfa_host_align(offset + sizes[i]);
+	}
+	hdr.size = (uint32_t)offset;
+
+	out = calloc(1, offset);
+	for (i = 0; i < TFA_CONT2_NSECT; i++)
+		if (sizes[i])
+			memcpy(out + hdr.sect[i].offset, sect[i], sizes[i]);
+	memcpy(out, &hdr, sizeof(hdr));
+	crc = ~crc32_le(~0u, out + offsetof(struct tfa_cont2_header, ndev),
+		offset - offsetof(struct tfa_cont2_header, ndev));
+	memcpy(out + offsetof(struct tfa_cont2_header, crc), &crc,
+		sizeof(crc));
+
+	if (stats) {
+		stats->reg_items = regs.items;
+		stats->reg_entries = regs.n;
+		stats->profiles = nprof2;
+	}
+
+	*out_len = (int)offset;
+	tfa_cont_image_put(img);
+	free(prof2);
+	free(regs.reg);
+
+	return out;
+}
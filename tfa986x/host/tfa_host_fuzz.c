@@ -0,0 +1,219 @@
+/*
+ * Copyright 2020 GOODIX, All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ */
+
+/*
+ * Fuzz entry for the container parser.
+ * Built with -fsanitize=fuzzer it is a libFuzzer target. Without it,
+ * main() replays the files given on the command line, or mutates the
+ * synthetic container for a number of rounds when none are given.
+ */
+
+#include "tfa_host.h"
+
+/* read what each item points to, as the writers in the driver do */
+static size_t tfa_host_walk_items(struct tfa_container *cnt,
+	struct tfa_desc_ptr *list, int length)
+{
+	uint8_t *base = (uint8_t *)cnt;
+	struct tfa_file_dsc *file;
+	size_t sink = 0;
+	int i;
+
+	for (i = 0; i < length; i++) {
+		switch (list[i].type) {
+		case dsc_register:
+			sink += ((struct tfa_reg_patch *)
+				(base + list[i].offset))->value;
+			break;
+		case dsc_bit_field:
+			sink += ((struct tfa_bitfield *)
+				(base + list[i].offset))->field;
+			break;
+		case dsc_mode:
+			sink += ((struct tfa_mode *)
+				(base + list[i].offset))->value;
+			break;
+		case dsc_string:
+			sink += strlen(tfa_cont_get_string(cnt, &list[i]));
+			break;
+		case dsc_file:
+		case dsc_patch:
+			file = (struct tfa_file_dsc *)(base + list[i].offset);
+			if (file->size)
+				sink += file->data[file->size - 1];
+			break;
+		default:
+			break;
+		}
+	}
+
+	return sink;
+}
+
+static void tfa_host_walk(struct tfa_container *cnt)
+{
+	struct tfa_device_list *dl;
+	struct tfa_profile_list *prof;
+	volatile size_t sink = 0;
+	int dev, idx, nprof[TFACONT_MAXDEVS];
+
+	for (dev = 0; dev < cnt->ndev; dev++) {
+		nprof[dev] = 0;
+		dl = tfa_cont_get_dev_list(cnt, dev);
+		if (dl == NULL)
+			continue;
+		sink += strlen(tfa_cont_device_name(cnt, dev));
+		sink += tfa_host_walk_items(cnt, dl->list, dl->length);
+
+		for (idx = 0; idx < TFACONT_MAXPROFS; idx++) {
+			prof = tfa_cont_get_dev_prof_list(cnt, dev, idx);
+			if (prof == NULL)
+				break;
+			sink += strlen(tfa_cont_profile_name(cnt, dev, idx));
+			sink += tfa_host_walk_items(cnt, prof->list,
+				prof->length);
+		}
+		nprof[dev] = idx;
+	}
+
+	/* and write each profile to stub devices, as a switch would */
+	if (cnt->ndev < 1 || cnt->ndev > MAX_HANDLES
+		|| tfa_host_attach(cnt, cnt->ndev))
+		return;
+	for (dev = 0; dev < cnt->ndev; dev++)
+		for (idx = 0; idx < nprof[dev]; idx++)
+			tfa_cont_write_profile(&tfa_host_devs[dev].tfa,
+				idx, 0);
+	(void)sink;
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+	struct tfa_cont_image *img;
+	uint8_t *buf;
+
+	if (size < sizeof(struct tfa_container) || size > TFA_MAX_CNT_LENGTH)
+		return 0;
+
+	/* a matching CRC lets the input reach the structure checks */
+	buf = malloc(size);
+	memcpy(buf, data, size);
+	if (buf[0] == 'P' && (buf[1] == 'M' || buf[1] == 'C'))
+		tfa_host_cnt_fix_crc(buf, size);
+
+	tfa_load_cnt(buf, (int)size);
+
+	img = tfa_cont_image_create(buf, (int)size);
+	if (img) {
+		tfa_cont_image_publish(tfa_cont_image_get(img));
+		tfa_host_walk(tfa_cont_image_container(img));
+		tfa_cont_image_publish(NULL);
+		tfa_cont_image_put(img);
+	}
+
+	free(buf);
+
+	return 0;
+}
+
+#ifndef TFA_HOST_LIBFUZZER
+static int tfa_host_replay(const char *path)
+{
+	uint8_t *data;
+	long size;
+	FILE *f;
+
+	f = fopen(path, "rb");
+	if (f == NULL) {
+		perror(path);
+		return 1;
+	}
+	fseek(f, 0, SEEK_END);
+	size = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	data = malloc(size > 0 ? size : 1);
+	if (fread(data, 1, size, f) != (size_t)size) {
+		perror(path);
+		fclose(f);
+		free(data);
+		return 1;
+	}
+	fclose(f);
+
+	LLVMFuzzerTestOneInput(data, size);
+	free(data);
+
+	return 0;
+}
+
+/* flip, overwrite or truncate a few bytes of a seed */
+static size_t tfa_host_mutate(uint8_t *buf, const uint8_t *seed,
+	size_t size)
+{
+	int n = 1 + rand() % 8;
+
+	memcpy(buf, seed, size);
+	while (n--) {
+		size_t pos = rand() % size;
+
+		switch (rand() % 4) {
+		case 0:
+			buf[pos] ^= 1 << (rand() % 8);
+			break;
+		case 1:
+			buf[pos] = (uint8_t)rand();
+			break;
+		case 2:
+			buf[pos] = (rand() & 1) ? 0xff : 0x00;
+			break;
+		default:
+			size = pos > sizeof(struct tfa_container)
+				? pos : size;
+			break;
+		}
+	}
+
+	return size;
+}
+
+int main(int argc, char **argv)
+{
+	uint8_t *seed[2], *buf;
+	int rounds = 100000;
+	int i, length[2];
+	size_t size;
+
+	if (argc > 1 && strcmp(argv[1], "-rounds") != 0) {
+		for (i = 1; i < argc; i++)
+			if (tfa_host_replay(argv[i]))
+				return 1;
+		return 0;
+	}
+	if (argc > 2)
+		rounds = atoi(argv[2]);
+
+	/* legacy and compiled forms of the same container */
+	seed[0] = tfa_host_cnt_build(2, 4, 8, 64, &length[0]);
+	seed[1] = tfa_cont_compile(seed[0], length[0], &length[1], NULL);
+	buf = malloc(max(length[0], length[1]));
+	srand(1);
+	for (i = 0; i < rounds; i++) {
+		size = tfa_host_mutate(buf, seed[i & 1], length[i & 1]);
+		LLVMFuzzerTestOneInput(buf, size);
+	}
+	printf("%d mutated containers of %d/%d bytes parsed\n", rounds,
+		length[0], length[1]);
+
+	free(buf);
+	free(seed[1]);
+	free(seed[0]);
+
+	return 0;
+}
+#endif
@@ -0,0 +1,275 @@
+/*
+ * Copyright 2020 GOODIX, All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ */
+
+/*
+ * Userspace stand-ins for the kernel APIs used by the container and
+ * bitfield code (tfa_container.c, tfa_dsp.c, tfa_init.c).
+ * Only for the host build in this directory; never part of the module.
+ */
+
+#ifndef __TFA_HOST_SHIM_H__
+#define __TFA_HOST_SHIM_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <ctype.h>
+
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+typedef int8_t s8;
+typedef int16_t s16;
+typedef int32_t s32;
+typedef int64_t s64;
+typedef int64_t ktime_t;
+typedef unsigned int gfp_t;
+
+#define GFP_KERNEL	0
+#define GFP_ATOMIC	0
+
+#define __rcu
+#define __init
+#define __exit
+#define __user
+#define __iomem
+#define __maybe_unused	__attribute__((unused))
+#define likely(x)	__builtin_expect(!!(x), 1)
+#define unlikely(x)	__builtin_expect(!!(x), 0)
+
+#define EXPORT_SYMBOL(sym)
+#define EXPORT_SYMBOL_GPL(sym)
+
+/* logging: silent unless TFA_HOST_VERBOSE is set in the environment */
+extern int tfa_host_verbose;
+#define tfa_host_log(fmt, ...) do { \
+		if (tfa_host_verbose) \
+			fprintf(stderr, fmt, ##__VA_ARGS__); \
+	} while (0)
+#define pr_err(fmt, ...)	tfa_host_log(fmt, ##__VA_ARGS__)
+#define pr_warn(fmt, ...)	tfa_host_log(fmt, ##__VA_ARGS__)
+#define pr_info(fmt, ...)	tfa_host_log(fmt, ##__VA_ARGS__)
+#define pr_debug(fmt, ...)	tfa_host_log(fmt, ##__VA_ARGS__)
+#define printk(fmt, ...)	tfa_host_log(fmt, ##__VA_ARGS__)
+#define dev_err(dev, fmt, ...)	tfa_host_log(fmt, ##__VA_ARGS__)
+#define dev_info(dev, fmt, ...)	tfa_host_log(fmt, ##__VA_ARGS__)
+#define dev_dbg(dev, fmt, ...)	tfa_host_log(fmt, ##__VA_ARGS__)
+
+#define ARRAY_SIZE(a)	(sizeof(a) / sizeof((a)[0]))
+#define DIV_ROUND_UP(n, d)	(((n) + (d) - 1) / (d))
+#define BIT(nr)		(1UL << (nr))
+#define min(a, b)	((a) < (b) ? (a) : (b))
+#define max(a, b)	((a) > (b) ? (a) : (b))
+#define min_t(t, a, b)	((t)(a) < (t)(b) ? (t)(a) : (t)(b))
+#define max_t(t, a, b)	((t)(a) > (t)(b) ? (t)(a) : (t)(b))
+#define abs(x)		((x) < 0 ? -(x) : (x))
+#define container_of(ptr, type, member) \
+	((type *)((char *)(ptr) - offsetof(type, member)))
+#define do_div(n, base) ({ uint32_t __rem = (n) % (base); \
+		(n) /= (base); __rem; })
+
+/* memory */
+#define kmalloc(size, flags)	malloc(size)
+#define kzalloc(size, flags)	calloc(1, size)
+#define kcalloc(n, size, flags)	calloc(n, size)
+#define kmemdup(p, size, flags)	tfa_host_memdup(p, size)
+#define kfree(p)		free((void *)(p))
+#define vmalloc(size)		malloc(size)
+#define vfree(p)		free(p)
+struct kmem_cache;
+#define kmem_cache_alloc(c, flags)	malloc(4096)
+#define kmem_cache_free(c, p)	free(p)
+static inline void *tfa_host_memdup(const void *p, size_t size)
+{
+	void *q = malloc(size);
+
+	if (q)
+		memcpy(q, p, size);
+	return q;
+}
+
+/* string helpers */
+static inline int kstrtou16(const char *s, unsigned int base, u16 *res)
+{
+	char *end;
+	unsigned long v = strtoul(s, &end, base);
+
+	if (end == s || v > 0xffff)
+		return -EINVAL;
+	*res = (u16)v;
+	return 0;
+}
+
+static inline int kstrtoint(const char *s, unsigned int base, int *res)
+{
+	char *end;
+	long v = strtol(s, &end, base);
+
+	if (end == s)
+		return -EINVAL;
+	*res = (int)v;
+	return 0;
+}
+
+#define scnprintf(buf, size, fmt, ...) ({ \
+		int __n = snprintf(buf, size, fmt, ##__VA_ARGS__); \
+		(size_t)__n < (size_t)(size) ? __n \
+			: (size) > 0 ? (int)(size) - 1 : 0; \
+	})
+
+char *strnchr(const char *s, size_t count, int c);
+char *strnstr(const char *s1, const char *s2, size_t len);
+
+/* time: sleeps do not sleep, the stub backend answers immediately */
+#define msleep(ms)			do { (void)(ms); } while (0)
+#define msleep_interruptible(ms)	({ (void)(ms); 0; })
+#define usleep_range(a, b)		do { (void)(a); (void)(b); } while (0)
+#define udelay(us)			do { (void)(us); } while (0)
+#define mdelay(ms)			do { (void)(ms); } while (0)
+ktime_t ktime_get_boottime(void);
+#define ktime_get()		ktime_get_boottime()
+#define ktime_sub(a, b)		((a) - (b))
+#define ktime_to_ns(t)		(t)
+#define ktime_to_us(t)		((t) / 1000)
+#define ktime_to_ms(t)		((t) / 1000000)
+#define ktime_us_delta(a, b)	(((a) - (b)) / 1000)
+#define ktime_add_ms(t, ms)	((t) + (s64)(ms) * 1000000)
+#define ktime_after(a, b)	((a) > (b))
+#define jiffies			((unsigned long)(ktime_get_boottime() / 1000000))
+#define HZ			1000
+#define msecs_to_jiffies(ms)	(ms)
+#define usecs_to_jiffies(us)	((us) / 1000)
+#define jiffies_to_usecs(j)	((j) * 1000)
+
+/* trace events compile to nothing */
+#define TP_PROTO(args...)	args
+#define TRACE_DEFINE_ENUM(a)
+#define TRACE_EVENT(name, proto, args, tstruct, assign, print) \
+	static inline void trace_##name(proto) {}
+
+/* locking: the host harness is single threaded */
+struct mutex {
+	int locked;
+};
+#define DEFINE_MUTEX(m)		struct mutex m = { 0 }
+#define mutex_init(m)		((m)->locked = 0)
+#define mutex_lock(m)		((m)->locked++)
+#define mutex_unlock(m)		((m)->locked--)
+#define mutex_trylock(m)	((m)->locked++ == 0)
+#define lockdep_is_held(m)	((m)->locked)
+typedef struct { int dummy; } spinlock_t;
+#define DEFINE_SPINLOCK(l)	spinlock_t l = { 0 }
+#define spin_lock_init(l)	do { } while (0)
+#define spin_lock(l)		do { } while (0)
+#define spin_unlock(l)		do { } while (0)
+#define spin_lock_irqsave(l, f)	do { (void)(f); } while (0)
+#define spin_unlock_irqrestore(l, f)	do { (void)(f); } while (0)
+
+/* atomics */
+typedef struct { int counter; } atomic_t;
+#define ATOMIC_INIT(i)		{ (i) }
+#define atomic_set(a, i)	((a)->counter = (i))
+#define atomic_read(a)		((a)->counter)
+#define atomic_inc(a)		((a)->counter++)
+#define atomic_dec(a)		((a)->counter--)
+#define atomic_dec_and_test(a)	(--(a)->counter == 0)
+#define atomic_inc_return(a)	(++(a)->counter)
+#define READ_ONCE(x)		(x)
+#define WRITE_ONCE(x, v)	((x) = (v))
+
+/* RCU: readers and writers are the same thread */
+struct rcu_head {
+	void (*func)(struct rcu_head *head);
+};
+#define rcu_read_lock()		do { } while (0)
+#define rcu_read_unlock()	do { } while (0)
+#define rcu_dereference(p)	(p)
+#define rcu_dereference_protected(p, c)	(p)
+#define rcu_assign_pointer(p, v)	((p) = (v))
+#define synchronize_rcu()	do { } while (0)
+#define rcu_barrier()		do { } while (0)
+static inline void call_rcu(struct rcu_head *head,
+	void (*func)(struct rcu_head *head))
+{
+	func(head);
+}
+
+/* kref */
+struct kref {
+	int refcount;
+};
+static inline void kref_init(struct kref *k)
+{
+	k->refcount = 1;
+}
+static inline void kref_get(struct kref *k)
+{
+	k->refcount++;
+}
+static inline int kref_get_unless_zero(struct kref *k)
+{
+	if (k->refcount == 0)
+		return 0;
+	k->refcount++;
+	return 1;
+}
+static inline int kref_put(struct kref *k, void (*release)(struct kref *k))
+{
+	if (--k->refcount == 0) {
+		release(k);
+		return 1;
+	}
+	return 0;
+}
+
+/* completion and work: work items run synchronously when queued */
+struct completion {
+	unsigned int done;
+};
+#define init_completion(c)	((c)->done = 0)
+#define reinit_completion(c)	((c)->done = 0)
+#define complete(c)		((c)->done++)
+#define complete_all(c)		((c)->done = UINT_MAX / 2)
+#define completion_done(c)	((c)->done != 0)
+#define wait_for_completion(c)	do { } while (0)
+#define wait_for_completion_timeout(c, t)	((c)->done ? 1UL : 0UL)
+
+struct work_struct;
+typedef void (*work_func_t)(struct work_struct *work);
+struct work_struct {
+	work_func_t func;
+};
+struct workqueue_struct {
+	int dummy;
+};
+extern struct workqueue_struct *system_unbound_wq;
+extern struct workqueue_struct *system_wq;
+extern struct workqueue_struct *system_highpri_wq;
+#define INIT_WORK(w, f)		((w)->func = (f))
+#define DECLARE_WORK(n, f)	struct work_struct n = { .func = (f) }
+static inline bool queue_work(struct workqueue_struct *wq,
+	struct work_struct *work)
+{
+	(void)wq;
+	work->func(work);
+	return true;
+}
+#define flush_work(w)		do { } while (0)
+#define cancel_work_sync(w)	false
+
+/* crc32 */
+u32 crc32_le(u32 crc, const unsigned char *p, size_t len);
+
+#endif /* __TFA_HOST_SHIM_H__ */
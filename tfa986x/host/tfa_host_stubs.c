@@ -0,0 +1,235 @@
+/*
+ * Copyright 2020 GOODIX, All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ */
+
+/*
+ * Host-side replacements for the symbols tfa98xx.c provides to the
+ * container and bitfield code: device table, register I/O and DSP
+ * message transport, all backed by an in-memory register file.
+ */
+
+#include <time.h>
+#include "tfa_host.h"
+
+int tfa_host_verbose;
+
+static struct workqueue_struct tfa_host_wq;
+struct workqueue_struct *system_unbound_wq = &tfa_host_wq;
+struct workqueue_struct *system_wq = &tfa_host_wq;
+struct workqueue_struct *system_highpri_wq = &tfa_host_wq;
+
+DEFINE_MUTEX(cnt_lock);
+
+struct tfa_host_dev tfa_host_devs[MAX_HANDLES];
+int tfa_host_ndev;
+
+static void __attribute__((constructor)) tfa_host_init(void)
+{
+	tfa_host_verbose = getenv("TFA_HOST_VERBOSE") != NULL;
+}
+
+ktime_t ktime_get_boottime(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (ktime_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* same semantics as lib/crc32.c: no pre/post inversion */
+u32 crc32_le(u32 crc, const unsigned char *p, size_t len)
+{
+	static u32 table[256];
+	static int ready;
+	size_t i;
+
+	if (!ready) {
+		for (i = 0; i < 256; i++) {
+			u32 c = (u32)i;
+			int k;
+
+			for (k = 0; k < 8; k++)
+				c = (c & 1) ? (c >> 1) ^ 0xedb88320 : c >> 1;
+			table[i] = c;
+		}
+		ready = 1;
+	}
+
+	for (i = 0; i < len; i++)
+		crc = table[(crc ^ p[i]) & 0xff] ^ (crc >> 8);
+
+	return crc;
+}
+
+char *strnchr(const char *s, size_t count, int c)
+{
+	while (count-- && *s) {
+		if (*s == (char)c)
+			return (char *)s;
+		s++;
+	}
+
+	return NULL;
+}
+
+char *strnstr(const char *s1, const char *s2, size_t len)
+{
+	size_t l2 = strlen(s2);
+
+	if (!l2)
+		return (char *)s1;
+	while (len >= l2) {
+		len--;
+		if (!memcmp(s1, s2, l2))
+			return (char *)s1;
+		s1++;
+	}
+
+	return NULL;
+}
+
+struct tfa_device *tfa98xx_get_tfa_device_from_index(int index)
+{
+	if (index < 0)
+		index = 0;
+	if (index >= tfa_host_ndev)
+		return NULL;
+
+	return &tfa_host_devs[index].tfa;
+}
+
+struct tfa_device *tfa98xx_get_tfa_device_from_channel(int channel)
+{
+	int i;
+
+	for (i = 0; i < tfa_host_ndev; i++)
+		if (tfa_host_devs[i].tfa.dev_idx == channel)
+			return &tfa_host_devs[i].tfa;
+
+	return NULL;
+}
+
+int tfa98xx_count_active_stream(int stream_flag)
+{
+	int i, count = 0;
+
+	for (i = 0; i < tfa_host_ndev; i++)
+		if (tfa_host_devs[i].tfa.stream_state & stream_flag)
+			count++;
+
+	return count;
+}
+
+enum tfa98xx_error tfa98xx_write_register16(struct tfa_device *tfa,
+	unsigned char subaddress,
+	unsigned short value)
+{
+	struct tfa_host_dev *dev;
+
+	if (tfa == NULL || tfa->data == NULL)
+		return TFA98XX_ERROR_FAIL;
+
+	dev = (struct tfa_host_dev *)tfa->data;
+	dev->regs[subaddress] = value;
+	dev->reg_writes++;
+
+	return TFA98XX_ERROR_OK;
+}
+
+enum tfa98xx_error tfa98xx_read_register16(struct tfa_device *tfa,
+	unsigned char subaddress,
+	unsigned short *val)
+{
+	struct tfa_host_dev *dev;
+
+	if (tfa == NULL || tfa->data == NULL)
+		return TFA98XX_ERROR_FAIL;
+
+	dev = (struct tfa_host_dev *)tfa->data;
+	*val = dev->regs[subaddress];
+	dev->reg_reads++;
+
+	return TFA98XX_ERROR_OK;
+}
+
+enum tfa_error tfa_convert_error_code(enum tfa98xx_error err)
+{
+	switch (err) {
+	case TFA98XX_ERROR_OK:
+		return tfa_error_ok;
+	case TFA98XX_ERROR_DEVICE:
+		return tfa_error_device;
+	case TFA98XX_ERROR_BAD_PARAMETER:
+		return tfa_error_bad_param;
+	case TFA98XX_ERROR_NO_CLOCK:
+		return tfa_error_noclock;
+	case TFA98XX_ERROR_STATE_TIMED_OUT:
+		return tfa_error_timeout;
+	case TFA98XX_ERROR_DSP_NOT_RUNNING:
+		return tfa_error_dsp;
+	default:
+		return tfa_error_other;
+	}
+}
+
+static int tfa_host_dsp_msg(void *data, int length, const char *buf)
+{
+	struct tfa_device *tfa = (struct tfa_device *)data;
+	struct tfa_host_dev *dev = (struct tfa_host_dev *)tfa->data;
+
+	(void)buf;
+	dev->dsp_msgs++;
+	dev->dsp_bytes += length;
+
+	return TFA98XX_ERROR_OK;
+}
+
+int tfa_host_attach(struct tfa_container *cnt, int ndev)
+{
+	int i;
+
+	if (ndev > MAX_HANDLES || ndev > cnt->ndev)
+		return -EINVAL;
+
+	memset(tfa_host_devs, 0, sizeof(tfa_host_devs));
+	tfa_host_ndev = ndev;
+
+	for (i = 0; i < ndev; i++) {
+		struct tfa_host_dev *dev = &tfa_host_devs[i];
+		struct tfa_device_list *dl = tfa_cont_get_dev_list(cnt, i);
+
+		if (dl == NULL)
+			return -EINVAL;
+
+		dev->tfa.data = dev;
+		dev->tfa.cnt = cnt;
+		/* TFA9866 revision, power down, no stray status */
+		dev->regs[0x03] = 0x1a66;
+		dev->regs[0x00] = 0x0001;
+
+		if (tfa_dev_probe(dl->dev, &dev->tfa))
+			return -ENODEV;
+		dev->tfa.dev_ops.dsp_msg = tfa_host_dsp_msg;
+		dev->tfa.stream_state = BIT_PSTREAM;
+		tfa_dev_set_swprof(&dev->tfa, 0);
+	}
+
+	return 0;
+}
+
+void tfa_host_reset_counters(void)
+{
+	int i;
+
+	for (i = 0; i < tfa_host_ndev; i++) {
+		tfa_host_devs[i].reg_reads = 0;
+		tfa_host_devs[i].reg_writes = 0;
+		tfa_host_devs[i].dsp_msgs = 0;
+		tfa_host_devs[i].dsp_bytes = 0;
+	}
+}
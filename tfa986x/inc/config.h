@@ -10,8 +10,13 @@
 #include <linux/types.h>
 #include <linux/ctype.h>
 #include <linux/delay.h>
+#include <linux/ktime.h>
 #include <linux/slab.h>
 #include <linux/crc32.h>
+#include <linux/completion.h>
+#include <linux/workqueue.h>
+#include <linux/kref.h>
+#include <linux/rcupdate.h>
 #include <linux/ftrace.h>
 #include <sound/pcm.h>
 
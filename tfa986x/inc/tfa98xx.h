@@ -14,6 +14,7 @@
 #include <linux/kernel.h>
 #include <linux/types.h>
 #include <linux/list.h>
+#include <linux/completion.h>
 #include <sound/pcm.h>
 
 #include "tfa_device.h"
@@ -71,6 +72,44 @@ enum tfa98xx_dsp_fw_state {
 	TFA98XX_DSP_FW_RELOADING,
 };
 
+/* state in the start group, for the unmute at stream start */
+enum tfa98xx_sync_state {
+	TFA98XX_SYNC_IDLE,	/* not started */
+	TFA98XX_SYNC_STARTED,	/* started, waiting for the group */
+	TFA98XX_SYNC_FAILED,	/* failed to start, waiting for the group */
+	TFA98XX_SYNC_UNMUTED,	/* unmuted with the group */
+	TFA98XX_SYNC_MUTED,	/* left muted with the group */
+};
+
+/* latency from the hard interrupt to the end of its handling */
+struct tfa98xx_irq_stat {
+	unsigned int count;
+	unsigned int last_us;
+	unsigned int max_us;
+	u64 total_us;
+};
+
+/* health monitor of the device */
+struct tfa98xx_monitor_stat {
+	unsigned int polls;
+	unsigned int events; /* runs brought forward by an interrupt */
+	unsigned int errors; /* runs that found an error */
+	unsigned int last_latency_us; /* from the error to its detection */
+	unsigned int max_latency_us;
+};
+
+/* blackbox samples kept for each device */
+#define TFA98XX_BB_SAMPLES 256
+
+/* one blackbox sample, as read from the blackbox_samples attribute */
+struct tfa98xx_bb_sample {
+	u64 time_ms; /* boot time */
+	s32 maxx; /* um, over the period */
+	s32 maxt; /* degC, over the period */
+	u32 overxmax;
+	u32 overtmax;
+};
+
 struct tfa98xx_firmware {
 	void *base;
 	struct tfa98xx_device *dev;
@@ -97,12 +136,26 @@ struct tfa98xx {
 	struct snd_soc_component *component;
 	struct workqueue_struct *tfa98xx_wq;
 	struct delayed_work init_work;
+	struct mutex init_lock; /* serializes the firmware load */
+	struct completion init_done; /* container load attempt finished */
+	atomic_t init_pending; /* loader plus firmware requests in flight */
+	struct delayed_work prewarm_work;
 	struct delayed_work monitor_work;
-	struct delayed_work interrupt_work;
+	unsigned int monitor_ms; /* current period */
+	ktime_t monitor_last; /* of the last run */
+	ktime_t monitor_event; /* of the interrupt not yet handled, or 0 */
+	struct tfa98xx_monitor_stat monitor_stat;
+	struct tfa98xx_bb_sample bb_ring[TFA98XX_BB_SAMPLES];
+	unsigned int bb_head; /* samples taken, the next slot */
+	struct thermal_zone_device *tz; /* speaker temperature */
+	struct thermal_cooling_device *cdev; /* speaker gain reduction */
+	unsigned long thermal_max_att; /* cooling states */
 	struct delayed_work overlay_work;
 	struct mutex dsp_lock;
 	int dsp_init;
 	int dsp_fw_state;
+	enum tfa98xx_sync_state sync_state;
+	ktime_t unmute_time;
 	int sysclk;
 	int rst_gpio;
 	u16 rev;
@@ -122,9 +175,12 @@ struct tfa98xx {
 	int reset_gpio;
 	int power_gpio;
 	int irq_gpio;
+	ktime_t irq_time; /* of the last hard interrupt */
+	struct tfa98xx_irq_stat irq_stat;
 	enum tfa_reset_polarity reset_polarity;
 	struct list_head list;
 	struct tfa_device *tfa;
+	struct tfa_cont_image *cnt_img; /* container in use, referenced */
 	int vstep;
 	int profile;
 	/* store vstep per profile (single device) */
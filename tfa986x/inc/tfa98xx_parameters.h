@@ -170,9 +170,10 @@ struct tfa_equalizer {
 /*
  * files
  */
-#define HDR(c1, c2) (c2<<8|c1) /* little endian */
+#define HDR(c1, c2) ((uint8_t)(c2)<<8|(uint8_t)(c1)) /* little endian */
 enum tfa_header_type {
 	params_hdr    = HDR('P', 'M'), /* containter file */
+	params2_hdr   = HDR('P', 'C'), /* compiled container file */
 	volstep_hdr   = HDR('V', 'P'),
 	patch_hdr     = HDR('P', 'A'),
 	speaker_hdr   = HDR('S', 'P'),
@@ -552,4 +553,71 @@ struct tfa_container {
 
 #pragma pack(pop)
 
+/*
+ * compiled container file (v2)
+ * - produced offline from a legacy container (host/tfa_cont_compile)
+ * - naturally aligned structs, sections aligned to TFA_CONT2_ALIGN
+ * - the legacy container is embedded as is, for all other lookups
+ * - the CRC covers the bytes following the CRC field, as in legacy
+ */
+#define TFA_CONT2_VERSION '2'
+#define TFA_CONT2_ALIGN 8
+#define TFA_CONT2_NONE 0xffff	/* section not compiled, use legacy */
+
+enum tfa_cont2_section_type {
+	TFA_CONT2_SECT_LEGACY,	/* struct tfa_container, verbatim */
+	TFA_CONT2_SECT_DEVS,	/* struct tfa_cont2_dev[ndev] */
+	TFA_CONT2_SECT_PROFS,	/* struct tfa_cont2_prof[] */
+	TFA_CONT2_SECT_REGS,	/* struct tfa_cont2_reg[] */
+	TFA_CONT2_NSECT
+};
+
+struct tfa_cont2_section {
+	uint32_t offset;	/* from start of file */
+	uint32_t size;	/* in bytes */
+};
+
+struct tfa_cont2_header {
+	char id[2];	/* "PC" */
+	char version[2];	/* "2_" */
+	uint32_t size;	/* file size in bytes */
+	uint32_t crc;	/* 32-bits CRC for following data */
+	uint16_t ndev;	/* nr of device entries */
+	uint16_t reserved;
+	struct tfa_cont2_section sect[TFA_CONT2_NSECT];
+};
+
+/*
+ * pre-merged register write: read-modify-write of mask bits,
+ * skipped when unchanged unless TFA_CONT2_REG_FORCE
+ */
+#define TFA_CONT2_REG_FORCE 0x01	/* register patch, or write-1-to-clear */
+struct tfa_cont2_reg {
+	uint8_t address;
+	uint8_t flags;
+	uint16_t mask;
+	uint16_t value;
+};
+
+/* device: legacy device list, its profiles and device register items */
+struct tfa_cont2_dev {
+	uint32_t list;	/* offset of tfa_device_list in legacy section */
+	uint16_t prof;	/* first profile entry */
+	uint16_t nprof;
+	uint16_t reg;	/* first register entry */
+	uint16_t nreg;	/* items before the first file/patch/profile */
+	uint32_t reserved;
+};
+
+/* profile: legacy profile list and its pre-merged register items */
+struct tfa_cont2_prof {
+	uint32_t list;	/* offset of tfa_profile_list in legacy section */
+	uint16_t reg;	/* first register entry, items before default */
+	uint16_t nreg;	/* or TFA_CONT2_NONE */
+	uint16_t def;	/* first register entry, items after default */
+	uint16_t ndef;	/* or TFA_CONT2_NONE */
+	uint16_t resume;	/* last non-file item before default */
+	uint16_t reserved;
+};
+
 #endif /* TFA98XXPARAMETERS_H_ */
@@ -0,0 +1,200 @@
+/*
+ * Copyright 2020 GOODIX, All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ */
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM tfa98xx
+
+#if !defined(_TFA98XX_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TFA98XX_TRACE_H
+
+#include <linux/tracepoint.h>
+
+TRACE_DEFINE_ENUM(TFA_PHASE_START);
+TRACE_DEFINE_ENUM(TFA_PHASE_REG_INIT);
+TRACE_DEFINE_ENUM(TFA_PHASE_PROF_REGS);
+TRACE_DEFINE_ENUM(TFA_PHASE_FILES);
+TRACE_DEFINE_ENUM(TFA_PHASE_DSP_MSG);
+TRACE_DEFINE_ENUM(TFA_PHASE_INIT_CF);
+TRACE_DEFINE_ENUM(TFA_PHASE_CAL_VALUES);
+TRACE_DEFINE_ENUM(TFA_PHASE_SYNC);
+TRACE_DEFINE_ENUM(TFA_PHASE_UNMUTE);
+
+#define show_tfa_phase(phase) \
+	__print_symbolic(phase, \
+		{ TFA_PHASE_START, "start" }, \
+		{ TFA_PHASE_REG_INIT, "reg_init" }, \
+		{ TFA_PHASE_PROF_REGS, "prof_regs" }, \
+		{ TFA_PHASE_FILES, "files" }, \
+		{ TFA_PHASE_DSP_MSG, "dsp_msg" }, \
+		{ TFA_PHASE_INIT_CF, "init_cf" }, \
+		{ TFA_PHASE_CAL_VALUES, "cal_values" }, \
+		{ TFA_PHASE_SYNC, "sync" }, \
+		{ TFA_PHASE_UNMUTE, "unmute" })
+
+/*
+ * One startup phase of a device has ended.
+ * seq counts the starts of the device, to group the phases of one start.
+ */
+TRACE_EVENT(tfa98xx_phase,
+	TP_PROTO(int dev_idx, int profile, unsigned int seq,
+		int phase, s64 duration_us, int err),
+	TP_ARGS(dev_idx, profile, seq, phase, duration_us, err),
+	TP_STRUCT__entry(
+		__field(int, dev_idx)
+		__field(int, profile)
+		__field(unsigned int, seq)
+		__field(int, phase)
+		__field(s64, duration_us)
+		__field(int, err)
+	),
+	TP_fast_assign(
+		__entry->dev_idx = dev_idx;
+		__entry->profile = profile;
+		__entry->seq = seq;
+		__entry->phase = phase;
+		__entry->duration_us = duration_us;
+		__entry->err = err;
+	),
+	TP_printk("dev=%d profile=%d seq=%u phase=%s duration_us=%lld err=%d",
+		__entry->dev_idx, __entry->profile, __entry->seq,
+		show_tfa_phase(__entry->phase),
+		__entry->duration_us, __entry->err)
+);
+
+TRACE_DEFINE_ENUM(TFA_EVENT_STATE);
+TRACE_DEFINE_ENUM(TFA_EVENT_DSP_MSG);
+TRACE_DEFINE_ENUM(TFA_EVENT_REG_WRITE);
+TRACE_DEFINE_ENUM(TFA_EVENT_IRQ);
+TRACE_DEFINE_ENUM(TFA_EVENT_TSPKR);
+
+#define show_tfa_event(type) \
+	__print_symbolic(type, \
+		{ TFA_EVENT_STATE, "state" }, \
+		{ TFA_EVENT_DSP_MSG, "dsp_msg" }, \
+		{ TFA_EVENT_REG_WRITE, "reg_write" }, \
+		{ TFA_EVENT_IRQ, "irq" }, \
+		{ TFA_EVENT_TSPKR, "tspkr" })
+
+/*
+ * A state of the device has been set; get is the state read back.
+ */
+TRACE_EVENT(tfa98xx_state,
+	TP_PROTO(int dev_idx, int set, int get),
+	TP_ARGS(dev_idx, set, get),
+	TP_STRUCT__entry(
+		__field(int, dev_idx)
+		__field(int, set)
+		__field(int, get)
+	),
+	TP_fast_assign(
+		__entry->dev_idx = dev_idx;
+		__entry->set = set;
+		__entry->get = get;
+	),
+	TP_printk("dev=%d set=0x%02x get=0x%02x",
+		__entry->dev_idx, __entry->set, __entry->get)
+);
+
+/*
+ * A message has been sent to the DSP; cmd is its first 3 bytes.
+ */
+TRACE_EVENT(tfa98xx_dsp_msg,
+	TP_PROTO(int dev_idx, int length, int cmd),
+	TP_ARGS(dev_idx, length, cmd),
+	TP_STRUCT__entry(
+		__field(int, dev_idx)
+		__field(int, length)
+		__field(int, cmd)
+	),
+	TP_fast_assign(
+		__entry->dev_idx = dev_idx;
+		__entry->length = length;
+		__entry->cmd = cmd;
+	),
+	TP_printk("dev=%d length=%d cmd=0x%06x",
+		__entry->dev_idx, __entry->length, __entry->cmd)
+);
+
+TRACE_EVENT(tfa98xx_reg_write,
+	TP_PROTO(int dev_idx, unsigned int reg, unsigned int value),
+	TP_ARGS(dev_idx, reg, value),
+	TP_STRUCT__entry(
+		__field(int, dev_idx)
+		__field(unsigned int, reg)
+		__field(unsigned int, value)
+	),
+	TP_fast_assign(
+		__entry->dev_idx = dev_idx;
+		__entry->reg = reg;
+		__entry->value = value;
+	),
+	TP_printk("dev=%d reg=0x%02x value=0x%04x",
+		__entry->dev_idx, __entry->reg, __entry->value)
+);
+
+/*
+ * Interrupts of the device have been handled.
+ */
+TRACE_EVENT(tfa98xx_irq,
+	TP_PROTO(int dev_idx, unsigned int active),
+	TP_ARGS(dev_idx, active),
+	TP_STRUCT__entry(
+		__field(int, dev_idx)
+		__field(unsigned int, active)
+	),
+	TP_fast_assign(
+		__entry->dev_idx = dev_idx;
+		__entry->active = active;
+	),
+	TP_printk("dev=%d active=0x%04x",
+		__entry->dev_idx, __entry->active)
+);
+
+TRACE_EVENT(tfa98xx_tspkr,
+	TP_PROTO(int dev_idx, int temp),
+	TP_ARGS(dev_idx, temp),
+	TP_STRUCT__entry(
+		__field(int, dev_idx)
+		__field(int, temp)
+	),
+	TP_fast_assign(
+		__entry->dev_idx = dev_idx;
+		__entry->temp = temp;
+	),
+	TP_printk("dev=%d temp=%d", __entry->dev_idx, __entry->temp)
+);
+
+/*
+ * An operation of the device has failed.
+ */
+TRACE_EVENT(tfa98xx_error,
+	TP_PROTO(int dev_idx, int type, int err),
+	TP_ARGS(dev_idx, type, err),
+	TP_STRUCT__entry(
+		__field(int, dev_idx)
+		__field(int, type)
+		__field(int, err)
+	),
+	TP_fast_assign(
+		__entry->dev_idx = dev_idx;
+		__entry->type = type;
+		__entry->err = err;
+	),
+	TP_printk("dev=%d op=%s err=%d", __entry->dev_idx,
+		show_tfa_event(__entry->type), __entry->err)
+);
+
+#endif /* _TFA98XX_TRACE_H */
+
+/* this part must be outside the header guard */
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH inc
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE tfa98xx_trace
+#include <trace/define_trace.h>
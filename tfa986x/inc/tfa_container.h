@@ -30,6 +30,67 @@
  */
 enum tfa_error tfa_load_cnt(void *cnt, int length);
 
+/* validated container with prebuilt indices, published through RCU */
+struct tfa_cont_image;
+
+/*
+ * Copy, check and index a container, off to the side of the active one.
+ * The CRC is computed in the background; a container byte-identical to the
+ * active one returns the active image, already validated.
+ * @param data pointer to the container file data
+ * @param length of the data in bytes
+ * @return image with one reference held, or NULL on error
+ */
+struct tfa_cont_image *tfa_cont_image_prepare(const void *data, int length);
+
+/*
+ * Wait for the background CRC of a prepared image and check it.
+ * @param img the image
+ * @return 0 if valid, -EINVAL on CRC error
+ */
+int tfa_cont_image_validate(struct tfa_cont_image *img);
+
+/*
+ * Copy, validate and index a container, off to the side of the active one.
+ * @param data pointer to the container file data
+ * @param length of the data in bytes
+ * @return image with one reference held, or NULL on error
+ */
+struct tfa_cont_image *tfa_cont_image_create(const void *data, int length);
+
+/*
+ * Make the image the active one, dropping the previous one.
+ * Consumes the caller's reference; NULL retires the active image.
+ * @param img the image to publish
+ */
+void tfa_cont_image_publish(struct tfa_cont_image *img);
+
+/*
+ * Take a reference to the active image.
+ * @return active image or NULL if none is published
+ */
+struct tfa_cont_image *tfa_cont_image_get_active(void);
+
+/*
+ * Take a reference to an image.
+ * @param img the image, may be NULL
+ * @return img
+ */
+struct tfa_cont_image *tfa_cont_image_get(struct tfa_cont_image *img);
+
+/*
+ * Drop a reference to an image.
+ * @param img the image, may be NULL
+ */
+void tfa_cont_image_put(struct tfa_cont_image *img);
+
+/*
+ * Get the container held by an image.
+ * @param img the image
+ * @return container pointer, valid while the reference is held
+ */
+struct tfa_container *tfa_cont_image_container(struct tfa_cont_image *img);
+
 /*
  * Return the descriptor string
  * @param cnt pointer to the container struct
@@ -82,6 +82,8 @@ struct tfa_device_ops {
 	int (*set_bitfield)(struct tfa_device *tfa,
 		uint16_t bitfield, uint16_t value);
 	enum tfa98xx_error (*get_status)(struct tfa_device *tfa);
+	int (*set_fingerprint)(struct tfa_device *tfa, uint16_t value);
+	int (*get_fingerprint)(struct tfa_device *tfa);
 };
 
 /*
@@ -128,6 +130,136 @@ struct tfa98xx_buffer_pool {
 /* MAX_HANDLES * ID_BLACKBOX_MAX */
 #define LOG_BUFFER_SIZE 36
 
+/*
+ * Phases of a device start, timed for the tfa98xx_phase trace event
+ * and the startup summary in debugfs
+ */
+enum tfa_start_phase {
+	TFA_PHASE_START, /* tfa_dev_start as a whole */
+	TFA_PHASE_REG_INIT, /* init and registers under dev */
+	TFA_PHASE_PROF_REGS, /* registers under profile */
+	TFA_PHASE_FILES, /* files under dev and profile */
+	TFA_PHASE_DSP_MSG, /* sending a multi-message */
+	TFA_PHASE_INIT_CF, /* waiting for the DSP in INIT_CF */
+	TFA_PHASE_CAL_VALUES, /* calibration values to the algorithm */
+	TFA_PHASE_SYNC, /* waiting for the other devices to start */
+	TFA_PHASE_UNMUTE,
+	TFA_PHASE_MAX
+};
+
+struct tfa_phase_stat {
+	unsigned int count;
+	unsigned int errors;
+	unsigned int last_us;
+	unsigned int max_us;
+	unsigned int offset_us; /* of the last one, from its start */
+	u64 total_us;
+};
+
+/*
+ * Places that wait for the device, each with its own wait stats
+ */
+enum tfa_wait_site {
+	TFA_WAIT_MANSTATE, /* tfa_wait4manstate */
+	TFA_WAIT_CF_STABLE, /* tfa_cf_powerup */
+	TFA_WAIT_DSP_STABLE, /* going to INIT_CF */
+	TFA_WAIT_MTPB, /* MTP busy, before calibration */
+	TFA_WAIT_MTPEX, /* calibration done */
+	TFA_WAIT_POWERDOWN, /* powerdown before I2C reset */
+	TFA_WAIT_CAL, /* calibration status of the DSP */
+	TFA_WAIT_CAL_IDLE, /* tfa_wait_until_calibration_done */
+	TFA_WAIT_MAX
+};
+
+struct tfa_wait_stat {
+	unsigned int count;
+	unsigned int timeouts;
+	unsigned int early; /* woken by the interrupt */
+	unsigned int polls;
+	unsigned int last_us;
+	unsigned int max_us;
+	u64 total_us;
+};
+
+/*
+ * Events of the device, for the trace events and the event ring
+ */
+enum tfa_event_type {
+	TFA_EVENT_STATE, /* arg0: state set, arg1: state read back */
+	TFA_EVENT_DSP_MSG, /* arg0: length, arg1: command id */
+	TFA_EVENT_REG_WRITE, /* traced only: too many for the ring */
+	TFA_EVENT_IRQ, /* arg0: active interrupts */
+	TFA_EVENT_TSPKR, /* arg0: device, arg1: speaker temperature */
+	TFA_EVENT_ERROR, /* arg0: type of the failed event, arg1: error */
+	TFA_EVENT_MAX
+};
+
+/* the last events of the device, kept for post-mortems */
+#define TFA_EVENT_RING_SIZE	128 /* a power of 2 */
+
+struct tfa_event {
+	u64 time_ns;
+	u16 type;
+	u16 arg0;
+	s32 arg1;
+};
+
+/*
+ * Writers claim a slot with one atomic increment and never wait;
+ * a reader racing with a writer may see one torn entry
+ */
+struct tfa_event_ring {
+	atomic_t head; /* events logged, the next slot */
+	struct tfa_event ev[TFA_EVENT_RING_SIZE];
+};
+
+/* sources of the single IRQ register */
+#define TFA_IRQ_SOURCES	16
+/* profiles with a cached fingerprint, as TFACONT_MAXPROFS */
+#define TFA_FINGERPRINT_PROFS	64
+/* at most one interrupt report a period; the others are counted */
+#define TFA_IRQ_LOG_INTERVAL_MS	1000
+
+struct tfa_irq_stat {
+	unsigned int count;
+	ktime_t first;
+	ktime_t last;
+};
+
+/*
+ * Calibration of one channel from the calibration store,
+ * sent as it is at start instead of reading MTP
+ */
+struct tfa_cal_entry {
+	int re25; /* mOhm */
+	int temp; /* degC, at calibration */
+	u32 stamp; /* when calibrated; 0 if not valid */
+};
+
+/*
+ * Curve of a gain ramp
+ */
+enum tfa_ramp_curve {
+	TFA_RAMP_DB, /* by halves, or 6 dB a step: linear in dB */
+	TFA_RAMP_LINEAR, /* equal steps of gain */
+	TFA_RAMP_EXP, /* distance to the target shrinks by 1/4 a step */
+};
+
+/*
+ * Gain ramp in progress, stepped by the ramp engine
+ */
+struct tfa_ramp {
+	int active;
+	int from;
+	int to;
+	int step;
+	int steps;
+	enum tfa_ramp_curve curve;
+	uint16_t reg; /* register holding AMPGAIN, read once per ramp */
+	int err; /* enum tfa98xx_error */
+	struct completion done;
+};
+
 /*
  * This is the main tfa device context structure, it will carry all information
  * that is needed to handle a single I2C device instance.
@@ -179,6 +311,9 @@ struct tfa_device {
 	int mute_state;
 	int pause_state;
 	int spkgain;
+	int spkgain_att; /* thermal attenuation, in TDMSPKG steps */
+	int spkgain_base; /* TDMSPKG of the profile under the attenuation */
+	int spkgain_out; /* attenuated TDMSPKG last written, or -1 */
 	int inplev;
 	int temp;
 	int spkr_damaged; /* 0: okay, 1: damaged */
@@ -190,11 +325,17 @@ struct tfa_device {
 	int reset_mtpex;
 	int stream_state; /* b0: pstream (Rx), b1: cstream (Tx) */
 	int first_after_boot;
+	int check_fingerprint; /* at first startup after probe */
+	/* fingerprint after a switch to the profile; 0 if not known yet */
+	uint16_t prof_fingerprint[TFA_FINGERPRINT_PROFS];
+	int prewarm_profile; /* configured ahead of the stream, or -1 */
 	int active_handle;
 	int active_count;
 	int swprof;
 	int ampgain;
 	int ramp_steps;
+	enum tfa_ramp_curve ramp_curve;
+	struct tfa_ramp ramp;
 	int individual_msg;
 	int set_device;
 	int set_config;
@@ -214,6 +355,19 @@ struct tfa_device {
 	int ipcid[3];
 	int send_set_logger;
 	int cal_channel;
+	struct tfa_cal_entry cal_store;
+	unsigned int start_seq; /* number of tfa_dev_start */
+	int start_profile;
+	ktime_t start_time;
+	ktime_t phase_begin[TFA_PHASE_MAX];
+	struct tfa_phase_stat phase_stat[TFA_PHASE_MAX];
+	int wait_irq; /* wait_event is kicked by the interrupt */
+	struct completion wait_event;
+	struct tfa_wait_stat wait_stat[TFA_WAIT_MAX];
+	struct tfa_irq_stat irq_stat[TFA_IRQ_SOURCES];
+	ktime_t irq_log_time; /* of the last interrupt report */
+	unsigned int irq_log_missed; /* reports suppressed since */
+	struct tfa_event_ring events;
 };
 
 #define TFA_INCHANNEL(idx) \
@@ -272,6 +426,27 @@ enum tfa_error tfa_dev_start(struct tfa_device *tfa, int profile, int vstep);
 enum tfa_error tfa_dev_switch_profile(struct tfa_device *tfa,
 	int profile, int vstep);
 
+/*
+ * Configure phase of tfa_dev_start only, ahead of the stream: register
+ * init, registers under dev and under profile. The DSP is not started
+ * and the amplifier stays in powerdown. The next start at the same
+ * profile keeps this configuration if it is still in place.
+ *
+ *  @param tfa struct = pointer to context of this device instance
+ *  @param profile the profile the stream will start
+ *  @return tfa_error enum
+ */
+enum tfa_error tfa_dev_prewarm(struct tfa_device *tfa, int profile);
+
+/*
+ * Drop a configuration of tfa_dev_prewarm that no start used,
+ * and make sure the amplifier is powered down.
+ *
+ *  @param tfa struct = pointer to context of this device instance
+ *  @return tfa_error enum
+ */
+enum tfa_error tfa_dev_prewarm_drop(struct tfa_device *tfa);
+
 /*
  * Stop audio for this instance as gracefully as possible.
  * Audio will be muted and the PLL will be shutdown together with any other
@@ -285,6 +460,20 @@ enum tfa_error tfa_dev_switch_profile(struct tfa_device *tfa,
  */
 enum tfa_error tfa_dev_stop(struct tfa_device *tfa);
 
+/*
+ * tfa_dev_stop in phases, to stop several devices in the time of one:
+ * tfa_dev_stop_ramp on each device, then tfa_dev_stop_powerdown on each,
+ * then one wait of TFA_STOP_SETTLE_MS, then tfa_dev_stop_done on each
+ * device that was powered down.
+ *
+ *  @param tfa struct = pointer to context of this device instance
+ *  @return tfa_error enum
+ */
+#define TFA_STOP_SETTLE_MS 10
+enum tfa_error tfa_dev_stop_ramp(struct tfa_device *tfa);
+enum tfa_error tfa_dev_stop_powerdown(struct tfa_device *tfa);
+enum tfa_error tfa_dev_stop_done(struct tfa_device *tfa);
+
 /*
  * This interface allows a device/type independent fine grained control of
  * internal state of the instance.
@@ -371,6 +560,24 @@ void tfa_irq_init(struct tfa_device *tfa);
  * report interrupt status (for single IRQ register)
  */
 int tfa_irq_report(struct tfa_device *tfa);
+/*
+ * report interrupt status already read by the caller
+ * @param tfa the device struct pointer
+ * @param irqstatus value of the interrupt status register
+ * @return 0 on success
+ */
+int tfa_irq_report_status(struct tfa_device *tfa, uint16_t irqstatus);
+/*
+ * @param tfa the device struct pointer
+ * @param irq index of the interrupt source
+ * @return the name of the interrupt source
+ */
+const char *tfa_irq_name(struct tfa_device *tfa, int irq);
+/*
+ * Clear the interrupt counters of the device
+ * @param tfa the device struct pointer
+ */
+void tfa_irq_stat_reset(struct tfa_device *tfa);
 
 enum tfa98xx_error tfa_get_fw_api_version(struct tfa_device *tfa,
 	unsigned char *pfw_version);
@@ -381,5 +588,37 @@ enum tfa98xx_error tfa_get_fw_lib_version(struct tfa_device *tfa,
 #define RAMPDOWN_DEFAULT 5 /* 5 or higher if usleep_range works */
 enum tfa98xx_error tfa_gain_rampdown(struct tfa_device *tfa, int count);
 enum tfa98xx_error tfa_gain_restore(struct tfa_device *tfa, int count);
+/* tfa_gain_rampdown without waiting for the ramp */
+enum tfa98xx_error tfa_gain_rampdown_start(struct tfa_device *tfa,
+	int count);
+
+/*
+ * Start ramping AMPGAIN to a value, in steps of RAMPING_INTERVAL msec.
+ * The ramp engine steps the ramps of all devices together, so that
+ * the ramps of several devices take as long as one.
+ *
+ *  @param tfa struct = pointer to context of this device instance
+ *  @param to the gain at the end of the ramp
+ *  @param steps the number of steps; the gain is set at once if <= 0
+ *  @return tfa98xx_error enum, without waiting for the ramp
+ */
+enum tfa98xx_error tfa_gain_ramp_start(struct tfa_device *tfa,
+	int to, int steps);
+
+/*
+ * Wait until the ramp of this device is done.
+ *
+ *  @param tfa struct = pointer to context of this device instance
+ *  @return tfa98xx_error enum of the ramp
+ */
+enum tfa98xx_error tfa_gain_ramp_wait(struct tfa_device *tfa);
+
+/*
+ * Take this device out of the ramp engine, e.g. when it goes away;
+ * a ramp in progress ends where it is.
+ *
+ *  @param tfa struct = pointer to context of this device instance
+ */
+void tfa_gain_ramp_cancel(struct tfa_device *tfa);
 
 #endif /* __TFA_DEVICE_H__ */
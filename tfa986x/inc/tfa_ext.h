@@ -101,6 +101,20 @@ int tfa98xx_get_blackbox_data_index_channel(int channel,
 
 int tfa98xx_update_spkt_data(int idx);
 int tfa98xx_update_spkt_data_channel(int channel);
+
+struct notifier_block;
+/*
+ * speaker temperature of a channel, read again when the cached one
+ * is older than spkt_cache_ms
+ */
+int tfa98xx_get_spkt_cached(int channel);
+/*
+ * be called with the channel as action, when its speaker temperature
+ * crosses a threshold (spkt_thresholds) or moves by spkt_hysteresis;
+ * while registered, it is also read every spkt_poll_ms during playback
+ */
+int tfa98xx_spkt_register_notifier(struct notifier_block *nb);
+int tfa98xx_spkt_unregister_notifier(struct notifier_block *nb);
 int tfa98xx_write_sknt_control(int idx, int value);
 int tfa98xx_write_sknt_control_channel(int channel, int value);
 int tfa98xx_get_init_state(int dev_idx);
@@ -84,7 +84,7 @@ char* tfa_get_ic_name (struct tfa_device *tfa);
 
 void tfa_handle_damaged_speakers(struct tfa_device *tfa);
 
-void tfa_set_spkgain(struct tfa_device *tfa);
+enum tfa98xx_error tfa_set_spkgain(struct tfa_device *tfa);
 
 void tfa_restore_after_cal(int index, int cal_err);
 enum tfa98xx_error tfa_run_cal(int index, uint16_t *value);
@@ -95,13 +95,94 @@ enum tfa98xx_error tfa_set_cal_data_channel(int channel, uint16_t value);
 enum tfa98xx_error tfa_get_cal_temp(int index, uint16_t *value);
 enum tfa98xx_error tfa_get_cal_temp_channel(int channel, uint16_t *value);
 
+/* calibration in the background */
+enum tfa_cal_job_state {
+	TFA_CAL_JOB_IDLE,
+	TFA_CAL_JOB_RUNNING,
+	TFA_CAL_JOB_DONE,
+};
+
+struct tfa_cal_result {
+	int calibrated; /* the device was part of the job */
+	int err; /* enum tfa98xx_error */
+	uint16_t rdc; /* mOhm */
+	uint16_t temp; /* degC */
+};
+
+struct tfa_cal_job {
+	int state; /* enum tfa_cal_job_state */
+	int index; /* enum cal_channel */
+	int err; /* of tfa_run_cal() */
+	unsigned int duration_ms;
+	struct tfa_cal_result result[MAX_HANDLES];
+};
+
+typedef void (*tfa_cal_job_done_t)(const struct tfa_cal_job *job,
+	void *data);
+
+/*
+ * start calibrating the channels of index (enum cal_channel), all at
+ * once, and collect the results of all devices when it ends
+ * @param index ALL_CH, RCV_CH or SPK_CH
+ * @param done called from the worker with the finished job; may be NULL
+ * @param data passed to done
+ * @return 0 if started, -EBUSY if a job is running, -EINVAL
+ */
+int tfa_cal_job_start(int index, tfa_cal_job_done_t done, void *data);
+
+/*
+ * @param job a copy of the last job
+ * @return its state (enum tfa_cal_job_state)
+ */
+int tfa_cal_job_get(struct tfa_cal_job *job);
+
+/* wait until the running job, if any, has ended */
+void tfa_cal_job_flush(void);
+
 #define TFA_LOG_MAX_COUNT	4
 #define TFA_LOG2_MAX_COUNT	7
 int tfa_set_blackbox(int enable);
 enum tfa98xx_error tfa_configure_log(int enable);
 enum tfa98xx_error tfa_configure_log2(int enable);
-enum tfa98xx_error tfa_update_log(void);
-enum tfa98xx_error tfa_update_log2(void);
+
+/* one read of the data logger for a device, over the last interval */
+struct tfa_log_sample {
+	int valid; /* the device was active and read */
+	int maxx; /* um */
+	int maxt; /* degC */
+	int overxmax;
+	int overtmax;
+};
+
+/*
+ * read the data logger (v1 or v2) of all devices, and return what was read
+ * @param sample MAX_HANDLES entries, by device index; may be NULL
+ */
+enum tfa98xx_error tfa_update_log_sample(struct tfa_log_sample *sample);
+enum tfa98xx_error tfa_update_log2_sample(struct tfa_log_sample *sample);
+
+/* telemetry of all devices; each part is read on its own */
+#define TFA_TELEMETRY_TSPKR	0x1 /* speaker temperature */
+#define TFA_TELEMETRY_LOG	0x2 /* data logger */
+struct tfa_telemetry {
+	ktime_t time_tspkr; /* when read; 0 if never */
+	ktime_t time_log;
+	int err_tspkr;
+	int err_log;
+	int spkt[MAX_HANDLES]; /* degC; 0xffff if not read */
+	struct tfa_log_sample log[MAX_HANDLES]; /* data logger interval */
+};
+
+/*
+ * read parts of the telemetry of all devices, one request each;
+ * the data logger read updates the blackbox aggregates
+ * @param tfa the device to read the speaker temperature through
+ * @param what TFA_TELEMETRY_* parts to read; the others are kept
+ * @param telemetry the result, each part stamped with its read time
+ * @return the first error of the reads
+ */
+enum tfa98xx_error tfa_read_telemetry(struct tfa_device *tfa, int what,
+	struct tfa_telemetry *telemetry);
 
 int tfa_get_power_state(int index);
 
@@ -58,6 +58,7 @@ extern "C" {
 #define TFA98XX_DRC_LENGTH              381	/* 127 words */
 
 #define TFA_TDMSPKG_IN_BYPASS	14
+#define TFA_TDMSPKG_MAX	0x1f
 
 /* not used in current driver */
 /*
@@ -526,6 +527,12 @@ int tfa_read_reg(struct tfa_device *tfa,
 
 enum tfa98xx_error tfa_run_mute(struct tfa_device *tfa);
 enum tfa98xx_error tfa_run_unmute(struct tfa_device *tfa);
+/*
+ * tfa_run_mute in two halves, to mute several devices together:
+ * start the ramp down on each device, then wait for it and mute each
+ */
+enum tfa98xx_error tfa_run_mute_ramp(struct tfa_device *tfa);
+enum tfa98xx_error tfa_run_mute_wait(struct tfa_device *tfa);
 
 /*
  * run post-calibration process
@@ -668,6 +675,71 @@ int tfa_is_cold(struct tfa_device *tfa);
 
 int tfa_is_cold_amp(struct tfa_device *tfa);
 
+/*
+ * Check the configuration fingerprint kept in the device
+ * @param tfa the device struct pointer
+ * @return 1 if the device still holds the configuration written
+ *         from the active container, 0 otherwise
+ */
+int tfa_dev_match_fingerprint(struct tfa_device *tfa);
+
+/*
+ * Save the fingerprint of the configuration in the device
+ * @param tfa the device struct pointer
+ * @param valid 0 to clear it, before the configuration is rewritten
+ */
+void tfa_dev_save_fingerprint(struct tfa_device *tfa, int valid);
+
+/*
+ * Save the fingerprint after a switch to a profile, computed at the
+ * first switch to it and then kept per profile
+ * @param tfa the device struct pointer
+ * @param profile the profile written
+ */
+void tfa_dev_save_prof_fingerprint(struct tfa_device *tfa, int profile);
+
+/*
+ * Mark the beginning of a startup phase of the device
+ * @param tfa the device struct pointer
+ * @param phase enum tfa_start_phase
+ */
+void tfa_phase_begin(struct tfa_device *tfa, int phase);
+
+/*
+ * Mark the end of a startup phase, to trace it and add it to the stats
+ * @param tfa the device struct pointer
+ * @param phase enum tfa_start_phase; ignored if it has not begun
+ * @param err result of the phase
+ */
+void tfa_phase_end(struct tfa_device *tfa, int phase, int err);
+
+/*
+ * Log an event of the device to its event ring and trace it
+ * @param tfa the device struct pointer
+ * @param type enum tfa_event_type
+ * @param arg0 first argument, as per the type
+ * @param arg1 second argument, as per the type
+ */
+void tfa_event_log(struct tfa_device *tfa, int type, int arg0, int arg1);
+
+/*
+ * @param type enum tfa_event_type
+ * @return the name of the event type
+ */
+const char *tfa_event_name(int type);
+
+/*
+ * Clear the startup phase stats of the device
+ * @param tfa the device struct pointer
+ */
+void tfa_phase_reset(struct tfa_device *tfa);
+
+/*
+ * @param phase enum tfa_start_phase
+ * @return the name of the phase
+ */
+const char *tfa_phase_name(int phase);
+
 enum tfa_status_type {
 	TFA_SET_DEVICE = 0,
 	TFA_SET_CONFIG = 1,
@@ -683,6 +755,9 @@ int tfa_get_pga_gain(struct tfa_device *tfa);
 int tfa_set_pga_gain(struct tfa_device *tfa, uint16_t value);
 
 int tfa_reset_sticky_bits(struct tfa_device *tfa);
+/* as tfa_reset_sticky_bits, with the flags already read by the caller */
+int tfa_clear_sticky_bits(struct tfa_device *tfa,
+	uint16_t status0, uint16_t status3);
 
 /*
  * Status of used for monitoring
@@ -693,15 +768,48 @@ enum tfa98xx_error tfaxx_status(struct tfa_device *tfa);
 
 /*
  * wait for a certain manstate to become active,
- * until a certain loop count is reached
+ * until a certain time has passed
  * @param tfa the device struct pointer
  * @param bf manstate bitfield
  * @param wait_value manstate to wait for
- * @param loop amount of wait cycles
- * @return int
+ * @param timeout_ms time to wait at most
+ * @return 0, or -ETIME on timeout
  */
 int tfa_wait4manstate(struct tfa_device *tfa,
-	uint16_t bf, uint16_t wait_value, int loop);
+	uint16_t bf, uint16_t wait_value, int timeout_ms);
+
+/*
+ * Poll a condition of the device with a growing interval, which ends
+ * early when the device interrupt (or a DSP event) kicks the wait
+ * @param tfa the device struct pointer
+ * @param site enum tfa_wait_site, to account the wait to
+ * @param done returns >0 when the wait is over, <0 to abort it
+ * @param data passed to done
+ * @param timeout_ms time to wait at most
+ * @return 0 when done, -ETIME on timeout, or the error from done
+ */
+int tfa_wait_for(struct tfa_device *tfa, int site,
+	int (*done)(struct tfa_device *tfa, void *data), void *data,
+	int timeout_ms);
+
+/*
+ * Wake up a wait of the device to poll at once, from the interrupt
+ * or from a DSP event
+ * @param tfa the device struct pointer
+ */
+void tfa_wait_kick(struct tfa_device *tfa);
+
+/*
+ * @param site enum tfa_wait_site
+ * @return the name of the wait site
+ */
+const char *tfa_wait_site_name(int site);
+
+/*
+ * Clear the wait stats of the device
+ * @param tfa the device struct pointer
+ */
+void tfa_wait_reset(struct tfa_device *tfa);
 
 /*
  * function overload for flag_mtp_busy
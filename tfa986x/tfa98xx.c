@@ -23,6 +23,9 @@
 #include <linux/sysfs.h>
 #include <linux/firmware.h>
 #include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/notifier.h>
+#include <linux/thermal.h>
 #include <linux/version.h>
 #include "inc/dbgprint.h"
 #include "inc/config.h"
@@ -56,6 +59,7 @@
 #define I2C_RETRY_DELAY 5 /* ms */
 #define TFA_RESET_DELAY 5 /* ms */
 #define VDD_DEFER_LATENCY 10 /* ms */
+#define TFA98XX_INIT_TIMEOUT 5000 /* ms */
 
 #include <linux/power_supply.h>
 #define REF_TEMP_DEVICE_NAME "battery"
@@ -81,6 +85,8 @@ SNDRV_PCM_FMTBIT_S24_LE | SNDRV_PCM_FMTBIT_S32_LE)
 static struct kmem_cache *tfa98xx_cache;
 /* Mutex protected data */
 static DEFINE_MUTEX(tfa98xx_mutex);
+/* changes of the device list, under tfa98xx_mutex; enough to walk it */
+static DEFINE_MUTEX(tfa98xx_list_lock);
 static DEFINE_MUTEX(probe_lock);
 static DEFINE_MUTEX(overlay_lock);
 DEFINE_MUTEX(cnt_lock);
@@ -89,17 +95,38 @@ static LIST_HEAD(tfa98xx_device_list);
 static int tfa98xx_device_count;
 static int tfa_probed_device_cnt = 0;
 static struct tfa98xx *tfa98xx_head_device;
-static int tfa98xx_sync_count;
-static int tfa98xx_monitor_count;
-#define MONITOR_COUNT_MAX 5
+
+/*
+ * Start group: the devices started for a stream are unmuted together,
+ * by the last one to start or at the timeout, whichever comes first.
+ * Protected by tfa98xx_mutex.
+ */
+#define TFA98XX_SYNC_TIMEOUT 1000 /* ms */
+struct tfa98xx_start_group {
+	bool released; /* unmuted; a late device unmutes at once */
+	unsigned int timeouts;
+	s64 last_skew_us; /* from the first to the last unmute */
+	s64 max_skew_us;
+};
+static struct tfa98xx_start_group tfa98xx_group;
+static void tfa98xx_group_timeout(struct work_struct *work);
+static DECLARE_DELAYED_WORK(tfa98xx_group_work, tfa98xx_group_timeout);
+/*
+ * Health monitor: polls at the shortest period after start or an error,
+ * doubling the period while healthy; an interrupt runs it at once.
+ */
+#define TFA98XX_MONITOR_MIN_MS 250
+#define TFA98XX_MONITOR_MAX_MS 16000
+static void tfa98xx_monitor_start(struct tfa98xx *tfa98xx);
 static int tfa98xx_cnt_reload;
+/* container prepared by a probing device, until its CRC is checked */
+static struct tfa_cont_image *tfa98xx_cnt_pending;
 static int (*tfa_i2c_err_callback)(int addr, int err, int rw, int cnt);
 
 static LIST_HEAD(profile_list); /* list of user selectable profiles */
 static int tfa98xx_mixer_profiles; /* number of user selectable profiles */
 static int tfa98xx_mixer_profile; /* current mixer profile */
 static struct snd_kcontrol_new *tfa98xx_controls;
-static struct tfa_container *tfa98xx_container;
 
 static int buf_pool_size[POOL_MAX_INDEX] = {
 	64 * 1024,
@@ -142,6 +169,45 @@ static int pcm_no_constraint;
 module_param(pcm_no_constraint, int, 0444);
 MODULE_PARM_DESC(pcm_no_constraint, "do not use constraints for PCM parameters\n");
 
+static int prewarm;
+module_param(prewarm, int, 0644);
+MODULE_PARM_DESC(prewarm, "configure the amplifier at hw_params, ahead of unmute\n");
+
+static int ramp_curve;
+module_param(ramp_curve, int, 0444);
+MODULE_PARM_DESC(ramp_curve, "gain ramp curve: 0=6 dB a step, 1=linear, 2=exponential\n");
+
+static int telemetry_max_age_ms = 200;
+module_param(telemetry_max_age_ms, int, 0644);
+MODULE_PARM_DESC(telemetry_max_age_ms, "readers take the last telemetry read up to this age, in ms\n");
+
+static int blackbox_period_ms;
+module_param(blackbox_period_ms, int, 0644);
+MODULE_PARM_DESC(blackbox_period_ms, "blackbox sampling period while playing, in ms (0: off)\n");
+
+#define TFA98XX_SPKT_THRESHOLDS	4
+
+static int spkt_cache_ms = 1000;
+module_param(spkt_cache_ms, int, 0644);
+MODULE_PARM_DESC(spkt_cache_ms, "speaker temperature cache lifetime, in ms\n");
+
+static int spkt_poll_ms = 1000;
+module_param(spkt_poll_ms, int, 0644);
+MODULE_PARM_DESC(spkt_poll_ms, "speaker temperature refresh period while playing, with a notifier registered, in ms (0: off)\n");
+
+static int spkt_hysteresis = 2;
+module_param(spkt_hysteresis, int, 0644);
+MODULE_PARM_DESC(spkt_hysteresis, "speaker temperature hysteresis of notifications, in degC\n");
+
+static int spkt_thresholds[TFA98XX_SPKT_THRESHOLDS];
+static int spkt_threshold_count;
+module_param_array(spkt_thresholds, int, &spkt_threshold_count, 0644);
+MODULE_PARM_DESC(spkt_thresholds, "speaker temperatures to notify when crossed, ascending, in degC (none: notify every change by the hysteresis)\n");
+
+static char *cal_name = "tfa98xx_cal.bin";
+module_param(cal_name, charp, 0644);
+MODULE_PARM_DESC(cal_name, "calibration store file, for cal-store = \"firmware\"\n");
+
 static void tfa98xx_dsp_init(struct tfa98xx *tfa98xx);
 
 static void tfa98xx_interrupt_enable(struct tfa98xx *tfa98xx, bool enable);
@@ -151,6 +217,7 @@ static int get_profile_id_for_sr(int id, unsigned int rate);
 
 static int _tfa98xx_mute(struct tfa98xx *tfa98xx, int mute, int stream);
 static int _tfa98xx_stop(struct tfa98xx *tfa98xx);
+static void tfa98xx_stop_all(struct tfa98xx **stop, int count);
 
 static void tfa98xx_check_calibration(struct tfa98xx *tfa98xx);
 static int tfa98xx_run_calibration(struct tfa98xx *tfa98xx);
@@ -159,6 +226,7 @@ static void tfa98xx_set_dsp_configured(struct tfa98xx *tfa98xx);
 
 static void tfa98xx_container_loaded
 	(const struct firmware *cont, void *context);
+static int tfa98xx_load_container(struct tfa98xx *tfa98xx);
 
 struct tfa98xx_rate {
 	unsigned int rate;
@@ -225,6 +293,39 @@ static enum tfa_error tfa98xx_write_re25(struct tfa_device *tfa, int value)
 	return err;
 }
 
+/*
+ * Switch the device to the active container image, if a new one has been
+ * published since it was configured. Called with dsp_lock held, before
+ * a start, so a reload never disturbs a running stream.
+ */
+static void tfa98xx_adopt_container(struct tfa98xx *tfa98xx)
+{
+	struct tfa_cont_image *img = tfa_cont_image_get_active();
+
+	if (img == NULL)
+		return;
+
+	if (img == tfa98xx->cnt_img) {
+		tfa_cont_image_put(img);
+		return;
+	}
+
+	tfa_cont_image_put(tfa98xx->cnt_img);
+	tfa98xx->cnt_img = img;
+	tfa98xx->tfa->cnt = tfa_cont_image_container(img);
+
+	if (tfa98xx->profile >= tfa_cnt_get_dev_nprof(tfa98xx->tfa)) {
+		tfa98xx->profile = 0;
+		tfa98xx->vstep = 0;
+	}
+
+	/* write the full configuration from the new container */
+	tfa98xx->tfa->first_after_boot = 1;
+
+	pr_info("%s: dev %d switched to reloaded container\n",
+		__func__, tfa98xx->tfa->dev_idx);
+}
+
 /* Wrapper for tfa start */
 static enum tfa_error
 tfa98xx_tfa_start(struct tfa98xx *tfa98xx, int next_profile, int vstep)
@@ -694,9 +795,7 @@ static ssize_t tfa98xx_dbgfs_dsp_state_set(struct file *file,
 		sizeof(mon_start_cmd) - 1)) {
 		pr_info("[0x%x] Manual start of monitor thread...\n",
 			tfa98xx->i2c->addr);
-		tfa98xx_monitor_count = -1;
-		queue_delayed_work(tfa98xx->tfa98xx_wq,
-			&tfa98xx->monitor_work, HZ);
+		tfa98xx_monitor_start(tfa98xx);
 	} else if (!strncmp(buf, mon_stop_cmd,
 		sizeof(mon_stop_cmd) - 1)) {
 		pr_info("[0x%x] Manual stop of monitor thread...\n",
@@ -1277,6 +1376,260 @@ static ssize_t tfa98xx_dbgfs_show_cal_read(struct file *file,
 		count, ppos, out_buf, sizeof(out_buf));
 }
 
+/*
+ * Statistics files: a read shows the stats, any write clears them.
+ * TFA98XX_DEBUGFS_STAT(name) makes tfa98xx_dbgfs_<name>_fops out of
+ * tfa98xx_dbgfs_<name>_show() and tfa98xx_dbgfs_<name>_reset().
+ */
+static ssize_t tfa98xx_dbgfs_stat_write(struct file *file, size_t count,
+	void (*reset)(struct tfa98xx *tfa98xx))
+{
+	struct seq_file *m = file->private_data;
+	struct tfa98xx *tfa98xx = i2c_get_clientdata(m->private);
+
+	if (tfa98xx->tfa == NULL)
+		return -ENODEV;
+
+	mutex_lock(&tfa98xx->dsp_lock);
+	reset(tfa98xx);
+	mutex_unlock(&tfa98xx->dsp_lock);
+
+	return count;
+}
+
+#define TFA98XX_DEBUGFS_STAT(__name)	\
+static int tfa98xx_dbgfs_##__name##_open(struct inode *inode,\
+	struct file *file)\
+{\
+	return single_open(file, tfa98xx_dbgfs_##__name##_show,\
+		inode->i_private);\
+} \
+static ssize_t tfa98xx_dbgfs_##__name##_write(struct file *file,\
+	const char __user *user_buf, size_t count, loff_t *ppos)\
+{\
+	return tfa98xx_dbgfs_stat_write(file, count,\
+		tfa98xx_dbgfs_##__name##_reset);\
+} \
+static const struct file_operations tfa98xx_dbgfs_##__name##_fops = {\
+	.owner = THIS_MODULE,\
+	.open = tfa98xx_dbgfs_##__name##_open,\
+	.read = seq_read,\
+	.write = tfa98xx_dbgfs_##__name##_write,\
+	.llseek = seq_lseek,\
+	.release = single_release,\
+}
+
+static int tfa98xx_dbgfs_startup_show(struct seq_file *m, void *unused)
+{
+	struct tfa98xx *tfa98xx = i2c_get_clientdata(m->private);
+	struct tfa_device *tfa = tfa98xx->tfa;
+	struct tfa_phase_stat *stat;
+	int i;
+
+	if (tfa == NULL)
+		return -ENODEV;
+
+	seq_printf(m, "dev %d, start %u, profile %d [%s]\n",
+		tfa->dev_idx, tfa->start_seq, tfa->start_profile,
+		tfa_cont_profile_name(tfa->cnt, tfa->dev_idx,
+		tfa->start_profile));
+	seq_printf(m,
+		"sync %d, unmute skew %lld us (max %lld us), %u timeouts\n",
+		tfa98xx->sync_state, tfa98xx_group.last_skew_us,
+		tfa98xx_group.max_skew_us, tfa98xx_group.timeouts);
+	seq_printf(m, "%-12s %8s %8s %10s %10s %10s %10s\n", "phase",
+		"count", "errors", "at_us", "last_us", "max_us", "avg_us");
+	for (i = 0; i < TFA_PHASE_MAX; i++) {
+		stat = &tfa->phase_stat[i];
+		seq_printf(m, "%-12s %8u %8u %10u %10u %10u %10llu\n",
+			tfa_phase_name(i), stat->count, stat->errors,
+			stat->offset_us, stat->last_us, stat->max_us,
+			stat->count ? div_u64(stat->total_us, stat->count)
+			: 0);
+	}
+
+	return 0;
+}
+
+static void tfa98xx_dbgfs_startup_reset(struct tfa98xx *tfa98xx)
+{
+	tfa_phase_reset(tfa98xx->tfa);
+}
+
+TFA98XX_DEBUGFS_STAT(startup);
+
+static int tfa98xx_dbgfs_waits_show(struct seq_file *m, void *unused)
+{
+	struct tfa98xx *tfa98xx = i2c_get_clientdata(m->private);
+	struct tfa_device *tfa = tfa98xx->tfa;
+	struct tfa_wait_stat *stat;
+	int i;
+
+	if (tfa == NULL)
+		return -ENODEV;
+
+	seq_printf(m, "%-12s %8s %8s %8s %8s %10s %10s %10s\n", "site",
+		"count", "timeouts", "early", "polls", "last_us", "max_us",
+		"avg_us");
+	for (i = 0; i < TFA_WAIT_MAX; i++) {
+		stat = &tfa->wait_stat[i];
+		seq_printf(m, "%-12s %8u %8u %8u %8u %10u %10u %10llu\n",
+			tfa_wait_site_name(i), stat->count, stat->timeouts,
+			stat->early, stat->polls, stat->last_us, stat->max_us,
+			stat->count ? div_u64(stat->total_us, stat->count)
+			: 0);
+	}
+
+	return 0;
+}
+
+static void tfa98xx_dbgfs_waits_reset(struct tfa98xx *tfa98xx)
+{
+	tfa_wait_reset(tfa98xx->tfa);
+}
+
+TFA98XX_DEBUGFS_STAT(waits);
+
+static int tfa98xx_dbgfs_monitor_show(struct seq_file *m, void *unused)
+{
+	struct tfa98xx *tfa98xx = i2c_get_clientdata(m->private);
+	struct tfa98xx_monitor_stat *stat = &tfa98xx->monitor_stat;
+
+	seq_printf(m,
+		"%8s %8s %8s %10s %14s %14s\n%8u %8u %8u %10u %14u %14u\n",
+		"polls", "events", "errors", "period_ms",
+		"last_latency_us", "max_latency_us",
+		stat->polls, stat->events, stat->errors,
+		delayed_work_pending(&tfa98xx->monitor_work)
+		? tfa98xx->monitor_ms : 0,
+		stat->last_latency_us, stat->max_latency_us);
+
+	return 0;
+}
+
+static void tfa98xx_dbgfs_monitor_reset(struct tfa98xx *tfa98xx)
+{
+	memset(&tfa98xx->monitor_stat, 0, sizeof(tfa98xx->monitor_stat));
+}
+
+TFA98XX_DEBUGFS_STAT(monitor);
+
+static ssize_t tfa98xx_dbgfs_events_read(struct file *file,
+	char __user *user_buf, size_t count, loff_t *ppos)
+{
+	struct i2c_client *i2c = file->private_data;
+	struct tfa98xx *tfa98xx = i2c_get_clientdata(i2c);
+	struct tfa_device *tfa = tfa98xx->tfa;
+	struct tfa_event ev;
+	unsigned int head, slot;
+	char arg0[12];
+	char *buf;
+	int pos;
+	ssize_t ret;
+
+	if (tfa == NULL)
+		return -ENODEV;
+
+	buf = kmalloc(PAGE_SIZE * 2, GFP_KERNEL);
+	if (buf == NULL)
+		return -ENOMEM;
+
+	/* oldest first; the ring is not stopped while it is read */
+	head = (unsigned int)atomic_read(&tfa->events.head);
+	slot = head > TFA_EVENT_RING_SIZE ? head - TFA_EVENT_RING_SIZE : 0;
+	pos = scnprintf(buf, PAGE_SIZE * 2, "%16s %-10s %10s %10s\n",
+		"time_us", "event", "arg0", "arg1");
+	for (; slot != head; slot++) {
+		ev = tfa->events.ev[slot & (TFA_EVENT_RING_SIZE - 1)];
+		/* arg0 of an error is the type of the failed event */
+		if (ev.type == TFA_EVENT_ERROR)
+			snprintf(arg0, sizeof(arg0), "%s",
+				tfa_event_name(ev.arg0));
+		else
+			snprintf(arg0, sizeof(arg0), "0x%x", ev.arg0);
+		pos += scnprintf(buf + pos, PAGE_SIZE * 2 - pos,
+			"%16llu %-10s %10s %10d\n",
+			div_u64(ev.time_ns, NSEC_PER_USEC),
+			tfa_event_name(ev.type), arg0, ev.arg1);
+	}
+
+	ret = simple_read_from_buffer(user_buf, count, ppos, buf, pos);
+	kfree(buf);
+
+	return ret;
+}
+
+/* the interrupt counters of the device, one source a line */
+static int tfa98xx_irq_stat_print(struct tfa_device *tfa,
+	char *buf, int size)
+{
+	struct tfa_irq_stat *stat;
+	int irq, pos;
+
+	pos = scnprintf(buf, size, "%-10s %8s %12s %12s\n",
+		"source", "count", "first_ms", "last_ms");
+	for (irq = 0; irq < tfa->irq_max && irq < TFA_IRQ_SOURCES; irq++) {
+		stat = &tfa->irq_stat[irq];
+		pos += scnprintf(buf + pos, size - pos,
+			"%-10s %8u %12lld %12lld\n",
+			tfa_irq_name(tfa, irq), stat->count,
+			stat->count ? ktime_to_ms(stat->first) : 0,
+			stat->count ? ktime_to_ms(stat->last) : 0);
+	}
+	pos += scnprintf(buf + pos, size - pos, "suppressed %u\n",
+		tfa->irq_log_missed);
+
+	return pos;
+}
+
+static int tfa98xx_dbgfs_irq_counts_show(struct seq_file *m, void *unused)
+{
+	struct tfa98xx *tfa98xx = i2c_get_clientdata(m->private);
+	char *buf;
+	int pos;
+
+	if (tfa98xx->tfa == NULL)
+		return -ENODEV;
+
+	buf = kmalloc(PAGE_SIZE, GFP_KERNEL);
+	if (buf == NULL)
+		return -ENOMEM;
+
+	/* shared with the irq_counts sysfs attribute */
+	pos = tfa98xx_irq_stat_print(tfa98xx->tfa, buf, PAGE_SIZE);
+	seq_write(m, buf, pos);
+	kfree(buf);
+
+	return 0;
+}
+
+static void tfa98xx_dbgfs_irq_counts_reset(struct tfa98xx *tfa98xx)
+{
+	tfa_irq_stat_reset(tfa98xx->tfa);
+}
+
+TFA98XX_DEBUGFS_STAT(irq_counts);
+
+static int tfa98xx_dbgfs_irq_show(struct seq_file *m, void *unused)
+{
+	struct tfa98xx *tfa98xx = i2c_get_clientdata(m->private);
+	struct tfa98xx_irq_stat *stat = &tfa98xx->irq_stat;
+
+	seq_printf(m, "%8s %10s %10s %10s\n%8u %10u %10u %10llu\n",
+		"count", "last_us", "max_us", "avg_us",
+		stat->count, stat->last_us, stat->max_us,
+		stat->count ? div_u64(stat->total_us, stat->count) : 0);
+
+	return 0;
+}
+
+static void tfa98xx_dbgfs_irq_reset(struct tfa98xx *tfa98xx)
+{
+	memset(&tfa98xx->irq_stat, 0, sizeof(tfa98xx->irq_stat));
+}
+
+TFA98XX_DEBUGFS_STAT(irq);
+
 /* Direct registers access - provide register address in hex */
 #define TFA98XX_DEBUGFS_REG_SET(__reg)	\
 static int tfa98xx_dbgfs_reg_##__reg##_set(void *data, u64 val)\
@@ -1415,6 +1768,13 @@ static const struct file_operations tfa98xx_dbgfs_show_cal_fops = {
 	.llseek = default_llseek,
 };
 
+static const struct file_operations tfa98xx_dbgfs_events_fops = {
+	.owner = THIS_MODULE,
+	.open = simple_open,
+	.read = tfa98xx_dbgfs_events_read,
+	.llseek = default_llseek,
+};
+
 #if !defined(TFA_PLATFORM_QUALCOMM)
 static const struct file_operations tfa98xx_dbgfs_memtrack_fops = {
 	.open = simple_open,
@@ -1452,6 +1812,18 @@ static void tfa98xx_debug_init(struct tfa98xx *tfa98xx, struct i2c_client *i2c)
 		i2c, &tfa98xx_dbgfs_rpc_fops);
 	debugfs_create_file("dsp", 0644, tfa98xx->dbg_dir,
 		i2c, &tfa98xx_dbgfs_dsp_fops);
+	debugfs_create_file("startup", 0644, tfa98xx->dbg_dir,
+		i2c, &tfa98xx_dbgfs_startup_fops);
+	debugfs_create_file("waits", 0644, tfa98xx->dbg_dir,
+		i2c, &tfa98xx_dbgfs_waits_fops);
+	debugfs_create_file("irq", 0644, tfa98xx->dbg_dir,
+		i2c, &tfa98xx_dbgfs_irq_fops);
+	debugfs_create_file("irq_counts", 0644, tfa98xx->dbg_dir,
+		i2c, &tfa98xx_dbgfs_irq_counts_fops);
+	debugfs_create_file("monitor", 0644, tfa98xx->dbg_dir,
+		i2c, &tfa98xx_dbgfs_monitor_fops);
+	debugfs_create_file("events", 0444, tfa98xx->dbg_dir,
+		i2c, &tfa98xx_dbgfs_events_fops);
 #if !defined(TFA_PLATFORM_QUALCOMM)
 	debugfs_create_file("memtrack", 0644, tfa98xx->dbg_dir,
 		i2c, &tfa98xx_dbgfs_memtrack_fops);
@@ -1542,6 +1914,8 @@ static int tfa98xx_run_calibration(struct tfa98xx *tfa98xx0)
 	u16 temp_val = DEFAULT_REF_TEMP; /* default */
 	int temp_calflag = 0;
 	int ramp_steps;
+	struct tfa98xx *stop[MAX_HANDLES];
+	int nstop;
 
 	if (tfa98xx0 == NULL || tfa98xx0->tfa == NULL)
 		return 0;
@@ -1608,19 +1982,29 @@ static int tfa98xx_run_calibration(struct tfa98xx *tfa98xx0)
 		/* force to mute amplifier to flush buffer */
 		ramp_steps = tfa->ramp_steps;
 		tfa->ramp_steps = RAMPDOWN_SHORT;
-		tfa_run_mute(tfa);
+		tfa_run_mute_ramp(tfa);
 		tfa->ramp_steps = ramp_steps;
 	}
 
+	/* the ramps of all devices run together */
+	for (idx = 0; idx < ndev; idx++) {
+		tfa = tfa98xx_get_tfa_device_from_index(idx);
+		if (tfa != NULL)
+			tfa_run_mute_wait(tfa);
+	}
+
 	/* wait before restarting for calibration */
 	msleep_interruptible(10);
 
+	nstop = 0;
 	list_for_each_entry(tfa98xx, &tfa98xx_device_list, list) {
 		pr_info("%s: dev %d - stopping devices\n",
 			__func__, tfa98xx->tfa->dev_idx);
+		stop[nstop++] = tfa98xx;
+	}
+	tfa98xx_stop_all(stop, nstop);
 
-		_tfa98xx_stop(tfa98xx);
-
+	list_for_each_entry(tfa98xx, &tfa98xx_device_list, list) {
 		mutex_lock(&tfa98xx->dsp_lock);
 
 		tfa98xx->calibrate_done = 0;
@@ -1693,40 +2077,147 @@ static int tfa98xx_run_calibration(struct tfa98xx *tfa98xx0)
 	return 0;
 }
 
-enum tfa98xx_error tfa98xx_read_reference_temp(short *value)
+/*
+ * Reference temperature: the power supply named by "nxp,ref-temp-psy-name"
+ * (REF_TEMP_DEVICE_NAME by default) is looked up once and kept, and
+ * its temperature is cached, read again when the supply notifies a
+ * change. It is shared by all devices, which have to name the same one.
+ */
+struct tfa98xx_ref_temp {
+	const char *name;
+	int named; /* by the device tree */
+	struct power_supply *psy;
+	int looked_up; /* the first lookup has been done */
+	int err; /* enum tfa98xx_error of the last read */
+	short temp; /* degC */
+};
+
+static DEFINE_MUTEX(tfa98xx_ref_temp_lock);
+static struct tfa98xx_ref_temp tfa98xx_ref_temp = {
+	.name = REF_TEMP_DEVICE_NAME,
+	.err = TFA98XX_ERROR_FAIL,
+	.temp = DEFAULT_REF_TEMP,
+};
+
+/* read the temperature of the supply again; tfa98xx_ref_temp_lock held */
+static void tfa98xx_ref_temp_update(void)
 {
-	struct power_supply *psy = NULL;
+	struct tfa98xx_ref_temp *ref = &tfa98xx_ref_temp;
 	union power_supply_propval prop_read = {0};
-	int ret = 0;
-
-	*value = DEFAULT_REF_TEMP; /* Re25C, default */
+	short temp;
+	int ret;
 
-	/* get power supply of "battery" */
-	/* value is preserved with default when error happens */
-	psy = power_supply_get_by_name(REF_TEMP_DEVICE_NAME);
-	if (!psy) {
-		pr_err("%s: failed to get power supply\n", __func__);
-		return TFA98XX_ERROR_FAIL;
+	ref->looked_up = 1;
+	if (ref->psy == NULL) {
+		ref->psy = power_supply_get_by_name(ref->name);
+		if (ref->psy == NULL) {
+			pr_err("%s: failed to get power supply %s\n",
+				__func__, ref->name);
+			ref->err = TFA98XX_ERROR_FAIL;
+			return;
+		}
 	}
 
-	ret = power_supply_get_property(psy,
+	ret = power_supply_get_property(ref->psy,
 		POWER_SUPPLY_PROP_TEMP, &prop_read);
 	if (ret) {
 		pr_err("%s: failed to get temp property\n", __func__);
-		if (psy)
-			power_supply_put(psy);
-		return TFA98XX_ERROR_FAIL;
+		ref->err = TFA98XX_ERROR_FAIL;
+		return;
 	}
 
-	*value = (short)(prop_read.intval / 10); /* in degC */
-	pr_info("%s: read temp (%d) from %s\n",
-		__func__, *value, REF_TEMP_DEVICE_NAME);
-	if (*value < 0 || *value > MAX_REF_TEMP) /* abnormal temp */
-		*value = DEFAULT_REF_TEMP; /* Re25C, default */
-	if (psy)
-		power_supply_put(psy);
+	temp = (short)(prop_read.intval / 10); /* in degC */
+	if (temp < 0 || temp > MAX_REF_TEMP) /* abnormal temp */
+		temp = DEFAULT_REF_TEMP; /* Re25C, default */
+	if (temp != ref->temp || ref->err != TFA98XX_ERROR_OK)
+		pr_info("%s: read temp (%d) from %s\n",
+			__func__, temp, ref->name);
+	ref->temp = temp;
+	ref->err = TFA98XX_ERROR_OK;
+}
 
-	return TFA98XX_ERROR_OK;
+static void tfa98xx_ref_temp_work_fn(struct work_struct *work)
+{
+	mutex_lock(&tfa98xx_ref_temp_lock);
+	tfa98xx_ref_temp_update();
+	mutex_unlock(&tfa98xx_ref_temp_lock);
+}
+
+static DECLARE_WORK(tfa98xx_ref_temp_work, tfa98xx_ref_temp_work_fn);
+
+/* called in atomic context: the supply is read from the work */
+static int tfa98xx_ref_temp_notify(struct notifier_block *nb,
+	unsigned long event, void *data)
+{
+	struct power_supply *psy = data;
+
+	if (event != PSY_EVENT_PROP_CHANGED || psy == NULL
+		|| psy->desc == NULL || psy->desc->name == NULL
+		|| strcmp(psy->desc->name, READ_ONCE(tfa98xx_ref_temp.name)))
+		return NOTIFY_DONE;
+
+	schedule_work(&tfa98xx_ref_temp_work);
+
+	return NOTIFY_OK;
+}
+
+static struct notifier_block tfa98xx_ref_temp_nb = {
+	.notifier_call = tfa98xx_ref_temp_notify,
+};
+
+static int tfa98xx_ref_temp_set_name(const char *name)
+{
+	int ret = 0;
+
+	mutex_lock(&tfa98xx_ref_temp_lock);
+	if (tfa98xx_ref_temp.named && strcmp(name, tfa98xx_ref_temp.name)) {
+		ret = -EINVAL;
+	} else if (strcmp(name, tfa98xx_ref_temp.name)) {
+		if (tfa98xx_ref_temp.psy)
+			power_supply_put(tfa98xx_ref_temp.psy);
+		tfa98xx_ref_temp.psy = NULL;
+		tfa98xx_ref_temp.looked_up = 0;
+		tfa98xx_ref_temp.err = TFA98XX_ERROR_FAIL;
+		tfa98xx_ref_temp.temp = DEFAULT_REF_TEMP;
+		WRITE_ONCE(tfa98xx_ref_temp.name, name);
+		schedule_work(&tfa98xx_ref_temp_work);
+	}
+	tfa98xx_ref_temp.named = 1;
+	mutex_unlock(&tfa98xx_ref_temp_lock);
+
+	return ret;
+}
+
+static void tfa98xx_ref_temp_exit(void)
+{
+	power_supply_unreg_notifier(&tfa98xx_ref_temp_nb);
+	cancel_work_sync(&tfa98xx_ref_temp_work);
+
+	mutex_lock(&tfa98xx_ref_temp_lock);
+	if (tfa98xx_ref_temp.psy)
+		power_supply_put(tfa98xx_ref_temp.psy);
+	tfa98xx_ref_temp.psy = NULL;
+	mutex_unlock(&tfa98xx_ref_temp_lock);
+}
+
+enum tfa98xx_error tfa98xx_read_reference_temp(short *value)
+{
+	enum tfa98xx_error err;
+
+	mutex_lock(&tfa98xx_ref_temp_lock);
+	/* look up once; later changes come from the notifier */
+	if (!tfa98xx_ref_temp.looked_up)
+		tfa98xx_ref_temp_update();
+	/* value is preserved with default when error happens */
+	*value = (tfa98xx_ref_temp.err == TFA98XX_ERROR_OK)
+		? tfa98xx_ref_temp.temp : DEFAULT_REF_TEMP;
+	err = tfa98xx_ref_temp.err;
+	mutex_unlock(&tfa98xx_ref_temp_lock);
+
+	pr_debug("%s: temp (%d) from %s, err %d\n",
+		__func__, *value, tfa98xx_ref_temp.name, err);
+
+	return err;
 }
 EXPORT_SYMBOL(tfa98xx_read_reference_temp);
 
@@ -2266,6 +2757,8 @@ static int tfa98xx_set_device_ctl(struct snd_kcontrol *kcontrol,
 	enum tfa_error err;
 	int dev;
 	int request;
+	struct tfa98xx *stop[MAX_HANDLES];
+	int nstop = 0;
 
 	mutex_lock(&tfa98xx_mutex);
 	list_for_each_entry(tfa98xx, &tfa98xx_device_list, list) {
@@ -2306,7 +2799,7 @@ static int tfa98xx_set_device_ctl(struct snd_kcontrol *kcontrol,
 			pr_info("%s: [%d] deactivate channel\n",
 				__func__, dev);
 			cancel_delayed_work_sync(&tfa98xx->monitor_work);
-			_tfa98xx_stop(tfa98xx);
+			stop[nstop++] = tfa98xx;
 			break;
 		case 1: /* activate immediately */
 			if (tfa->pause_state == 0) {
@@ -2344,6 +2837,8 @@ static int tfa98xx_set_device_ctl(struct snd_kcontrol *kcontrol,
 		}
 	}
 
+	tfa98xx_stop_all(stop, nstop);
+
 	/* reset counter */
 	tfa = tfa98xx_get_tfa_device_from_index(-1);
 	tfa_set_status_flag(tfa, TFA_SET_DEVICE, -1);
@@ -2384,6 +2879,8 @@ static int tfa98xx_set_stop_ctl(struct snd_kcontrol *kcontrol,
 	struct snd_ctl_elem_value *ucontrol)
 {
 	struct tfa98xx *tfa98xx;
+	struct tfa98xx *stop[MAX_HANDLES];
+	int nstop = 0;
 
 	mutex_lock(&tfa98xx_mutex);
 	list_for_each_entry(tfa98xx, &tfa98xx_device_list, list) {
@@ -2396,11 +2893,12 @@ static int tfa98xx_set_stop_ctl(struct snd_kcontrol *kcontrol,
 
 		if ((ucontrol->value.integer.value[i] != 0) && ready) {
 			cancel_delayed_work_sync(&tfa98xx->monitor_work);
-			_tfa98xx_stop(tfa98xx);
+			stop[nstop++] = tfa98xx;
 		}
 
 		ucontrol->value.integer.value[i] = 0;
 	}
+	tfa98xx_stop_all(stop, nstop);
 	mutex_unlock(&tfa98xx_mutex);
 
 	return 1;
@@ -2446,6 +2944,8 @@ static int tfa98xx_set_mute_ctl(struct snd_kcontrol *kcontrol,
 	int dev;
 	int request;
 	int cur_mute_state[MAX_HANDLES] = {0};
+	struct tfa98xx *mute[MAX_HANDLES];
+	int nmute = 0, i;
 
 	mutex_lock(&tfa98xx_mutex);
 	list_for_each_entry(tfa98xx, &tfa98xx_device_list, list) {
@@ -2501,8 +3001,9 @@ static int tfa98xx_set_mute_ctl(struct snd_kcontrol *kcontrol,
 			pr_info("%s: [%d] mute channel\n",
 				__func__, dev);
 			mutex_lock(&tfa98xx->dsp_lock);
-			tfa_run_mute(tfa);
+			tfa_run_mute_ramp(tfa);
 			mutex_unlock(&tfa98xx->dsp_lock);
+			mute[nmute++] = tfa98xx;
 			break;
 		default:
 			pr_info("%s: [%d] wrong request\n",
@@ -2510,6 +3011,13 @@ static int tfa98xx_set_mute_ctl(struct snd_kcontrol *kcontrol,
 			break;
 		}
 	}
+
+	/* the ramps of all devices run together */
+	for (i = 0; i < nmute; i++) {
+		mutex_lock(&mute[i]->dsp_lock);
+		tfa_run_mute_wait(mute[i]->tfa);
+		mutex_unlock(&mute[i]->dsp_lock);
+	}
 	mutex_unlock(&tfa98xx_mutex);
 
 	return 1;
@@ -2556,6 +3064,8 @@ static int tfa98xx_set_pause_ctl(struct snd_kcontrol *kcontrol,
 	int dev;
 	int request;
 	int cur_pause_state[MAX_HANDLES] = {0};
+	struct tfa98xx *stop[MAX_HANDLES];
+	int nstop = 0;
 
 	mutex_lock(&tfa98xx_mutex);
 	list_for_each_entry(tfa98xx, &tfa98xx_device_list, list) {
@@ -2625,7 +3135,7 @@ static int tfa98xx_set_pause_ctl(struct snd_kcontrol *kcontrol,
 			pr_info("%s: [%d] pause channel\n",
 				__func__, dev);
 			cancel_delayed_work_sync(&tfa98xx->monitor_work);
-			_tfa98xx_stop(tfa98xx);
+			stop[nstop++] = tfa98xx;
 			break;
 		default:
 			pr_info("%s: [%d] wrong request\n",
@@ -2634,6 +3144,8 @@ static int tfa98xx_set_pause_ctl(struct snd_kcontrol *kcontrol,
 		}
 	}
 
+	tfa98xx_stop_all(stop, nstop);
+
 	/* reset counter */
 	tfa = tfa98xx_get_tfa_device_from_index(-1);
 	tfa_set_status_flag(tfa, TFA_SET_DEVICE, -1);
@@ -2669,7 +3181,9 @@ static int tfa98xx_get_spkgain(struct snd_kcontrol *kcontrol,
 		if (tfa == NULL)
 			continue;
 
-		spkgain = TFAxx_GET_BF(tfa, TDMSPKG);
+		/* the mixer setting, without thermal attenuation */
+		spkgain = (tfa->spkgain != -1)
+			? tfa->spkgain : TFAxx_GET_BF(tfa, TDMSPKG);
 		pr_info("%s: [%d] read current speaker gain %d\n",
 			__func__, tfa->dev_idx, spkgain);
 		ucontrol->value.integer.value[tfa->dev_idx] = spkgain;
@@ -2700,7 +3214,7 @@ static int tfa98xx_set_spkgain(struct snd_kcontrol *kcontrol,
 		pr_info("%s: [%d] set spekaer gain %d (currently, %d)\n",
 			__func__, dev, tfa->spkgain, cur_spkgain);
 
-		err = TFAxx_SET_BF(tfa, TDMSPKG, tfa->spkgain);
+		err = tfa_set_spkgain(tfa);
 		if (err)
 			pr_err("%s: [%d] failed to set speaker gain\n",
 				__func__, dev);
@@ -2846,64 +3360,65 @@ static int tfa98xx_set_cnt_reload(struct snd_kcontrol *kcontrol,
 	struct snd_ctl_elem_value *ucontrol)
 {
 	struct tfa98xx *tfa98xx;
-	int tries, ret;
+	struct tfa_cont_image *img;
+	const struct firmware *cont;
+	int ret;
 
 	if (ucontrol != NULL)
 		if (ucontrol->value.integer.value[0] == 0)
 			return 1; /* do nothing */
 
-	/* free previously loaded one */
-	mutex_lock(&cnt_lock);
-	kfree(tfa98xx_container);
-	tfa98xx_container = NULL;
-	mutex_unlock(&cnt_lock);
+	if (tfa98xx_head_device == NULL)
+		return -ENODEV;
 
-	list_for_each_entry(tfa98xx, &tfa98xx_device_list, list) {
-		mutex_lock(&probe_lock);
-		if (tfa98xx->dsp_fw_state == TFA98XX_DSP_FW_OK) {
-			pr_info("%s: Reload continer file (previously %d) - dev %d\n",
-				__func__, tfa98xx_cnt_reload,
-				tfa98xx->tfa->dev_idx);
-			tfa98xx->dsp_fw_state = TFA98XX_DSP_FW_RELOADING;
-		} else {
-			tfa98xx->dsp_fw_state = TFA98XX_DSP_FW_PENDING;
-		}
-		mutex_unlock(&probe_lock);
+	ret = request_firmware(&cont, fw_name, tfa98xx_head_device->dev);
+	if (ret) {
+		pr_err("%s: Failed to read %s\n", __func__, fw_name);
+		return ret;
+	}
 
-		tries = 0;
+	/* validate and index off to the side; current one stays in use */
+	img = tfa_cont_image_create(cont->data, cont->size);
+	release_firmware(cont);
+	if (img == NULL) {
+		pr_err("%s: Cannot load container file, keep current one\n",
+			__func__);
+		return -EINVAL;
+	}
 
-		do {
-#if KERNEL_VERSION(5, 15, 0) <= LINUX_VERSION_CODE
-			ret = request_firmware_nowait(THIS_MODULE,
-				FW_ACTION_UEVENT,
-				fw_name, tfa98xx->dev, GFP_KERNEL,
-				tfa98xx, tfa98xx_container_loaded);
-#else
-			ret = request_firmware_nowait(THIS_MODULE,
-				FW_ACTION_HOTPLUG,
-				fw_name, tfa98xx->dev, GFP_KERNEL,
-				tfa98xx, tfa98xx_container_loaded);
-#endif
-			/* wait until driver completes loading */
-			msleep_interruptible(20);
-			if (tfa98xx->dsp_fw_state == TFA98XX_DSP_FW_OK)
-				break;
+	if (img == tfa98xx_head_device->cnt_img) {
+		/* byte-identical file: nothing to revalidate or rewrite */
+		pr_info("%s: container file unchanged\n", __func__);
+		tfa_cont_image_put(img);
+		return 1;
+	}
+
+	tfa_cont_image_publish(img);
+
+	mutex_lock(&probe_lock);
+	tfa98xx_cnt_reload++; /* increase reload counter */
+	pr_info("%s: Reloaded container file (%d)\n",
+		__func__, tfa98xx_cnt_reload);
+	mutex_unlock(&probe_lock);
 
-			msleep_interruptible(80);
-			tries++;
-		} while (tries < TFA98XX_LOADFW_NTRIES
-			&& tfa98xx->dsp_fw_state != TFA98XX_DSP_FW_OK);
+	list_for_each_entry(tfa98xx, &tfa98xx_device_list, list) {
+		if (tfa98xx->dsp_fw_state != TFA98XX_DSP_FW_OK) {
+			/* not probed yet: go through the full load */
+			tfa98xx_load_container(tfa98xx);
+			continue;
+		}
 
-		if ((ret != 0)
-			|| (tfa98xx->dsp_fw_state != TFA98XX_DSP_FW_OK))
-			/* skip preloading if it's not loaded yet */
+		/* running streams pick up the new container at next start */
+		if (tfa98xx->pstream != 0) {
+			pr_info("%s: dev %d - apply at next stream start\n",
+				__func__, tfa98xx->tfa->dev_idx);
 			continue;
+		}
 
 		/* Preload settings using internal clock on TFA2 */
 		if (tfa98xx->tfa->tfa_family == 2) {
 			mutex_lock(&tfa98xx->dsp_lock);
-			/* reload by force */
-			tfa98xx->tfa->first_after_boot = 1;
+			tfa98xx_adopt_container(tfa98xx);
 			tfa98xx_set_stream_state(tfa98xx->tfa, 0);
 			ret = tfa98xx_tfa_start(tfa98xx,
 				tfa98xx->profile, tfa98xx->vstep);
@@ -3512,91 +4027,79 @@ static void tfa98xx_interrupt_enable(struct tfa98xx *tfa98xx, bool enable)
 }
 
 /* Firmware management */
-static void tfa98xx_container_loaded
-	(const struct firmware *cont, void *context)
+
+/*
+ * Shared phase of the firmware load, with probe_lock held: pick the
+ * container image for the device. The devices probed in parallel share
+ * the one the first of them prepared, while its CRC is still running.
+ * @return referenced image, or NULL if the file is not a valid container
+ */
+static struct tfa_cont_image *tfa98xx_container_share
+	(const struct firmware *cont)
 {
 	struct tfa_container *container;
-	struct tfa98xx *tfa98xx = context;
-	enum tfa_error tfa_err;
-	int container_size;
-	int ret;
-	unsigned int value;
-
-	mutex_lock(&probe_lock);
+	struct tfa_cont_image *img;
 
-	if (tfa98xx->dsp_fw_state == TFA98XX_DSP_FW_OK) {
-		pr_info("%s: Already loaded\n", __func__);
-		if (cont)
-			release_firmware(cont);
-		mutex_unlock(&probe_lock);
-		return;
+	img = tfa_cont_image_get_active();
+	if (img == NULL && tfa98xx_cnt_pending != NULL)
+		img = tfa_cont_image_get(tfa98xx_cnt_pending);
+	if (img != NULL) {
+		pr_debug("container file already loaded...\n");
+		release_firmware(cont);
+		return img;
 	}
 
-	if (tfa98xx->dsp_fw_state != TFA98XX_DSP_FW_RELOADING)
-		tfa98xx->dsp_fw_state = TFA98XX_DSP_FW_FAIL;
+	/* check and index this one */
+	img = tfa_cont_image_prepare(cont->data, cont->size);
+	release_firmware(cont);
+	if (img == NULL)
+		return NULL;
 
-	if (!cont) {
-		pr_err("Failed to read %s\n", fw_name);
-		tfa98xx->dsp_fw_state = TFA98XX_DSP_FW_FAIL;
-		mutex_unlock(&probe_lock);
-		return;
-	}
+	tfa98xx_cnt_pending = tfa_cont_image_get(img);
 
-	pr_debug("loaded %s - size: %zu\n", fw_name, cont->size);
-
-	mutex_lock(&cnt_lock);
-	if (tfa98xx_container == NULL) {
-		container = kzalloc(cont->size, GFP_KERNEL);
-		if (container == NULL) {
-			mutex_unlock(&cnt_lock);
-			release_firmware(cont);
-			pr_err("Error allocating memory\n");
-			tfa98xx->dsp_fw_state = TFA98XX_DSP_FW_FAIL;
-			mutex_unlock(&probe_lock);
-			return;
-		}
+	container = tfa_cont_image_container(img);
+	pr_debug("%.2s%.2s\n", container->version,
+		container->subversion);
+	pr_debug("%.8s\n", container->customer);
+	pr_debug("%.8s\n", container->application);
+	pr_debug("%.8s\n", container->type);
+	pr_debug("%d ndev\n", container->ndev);
+	pr_debug("%d nprof\n", container->nprof);
 
-		container_size = cont->size;
-		memcpy(container, cont->data, container_size);
-		release_firmware(cont);
+	return img;
+}
 
-		pr_debug("%.2s%.2s\n", container->version,
-			container->subversion);
-		pr_debug("%.8s\n", container->customer);
-		pr_debug("%.8s\n", container->application);
-		pr_debug("%.8s\n", container->type);
-		pr_debug("%d ndev\n", container->ndev);
-		pr_debug("%d nprof\n", container->nprof);
-
-		tfa_err = tfa_load_cnt(container, container_size);
-		if (tfa_err != tfa_error_ok) {
-			mutex_unlock(&cnt_lock);
-			kfree(container);
-			dev_err(tfa98xx->dev, "Cannot load container file, aborting\n");
-			tfa98xx->dsp_fw_state = TFA98XX_DSP_FW_FAIL;
-			mutex_unlock(&probe_lock);
-			return;
-		}
+/*
+ * Publish a pending container once its CRC is checked, or drop it.
+ * Called with probe_lock held.
+ */
+static void tfa98xx_container_settle(struct tfa_cont_image *img, int valid)
+{
+	if (img != tfa98xx_cnt_pending)
+		return;
 
-		tfa98xx_container = container;
-	} else {
-		pr_debug("container file already loaded...\n");
-		container = tfa98xx_container;
-		release_firmware(cont);
-	}
-	mutex_unlock(&cnt_lock);
+	if (valid)
+		tfa_cont_image_publish(tfa98xx_cnt_pending);
+	else
+		tfa_cont_image_put(tfa98xx_cnt_pending);
+	tfa98xx_cnt_pending = NULL;
+}
 
-	tfa98xx->tfa->cnt = container;
+/*
+ * Hardware phase of the firmware load, with the device's dsp_lock held:
+ * probe the amplifier and read its calibration state. Only this device
+ * is accessed, so amplifiers go through it in parallel.
+ * @return 0 on success, -EINVAL if the container fails its CRC,
+ *         -ENODEV if the device cannot be probed
+ */
+static int tfa98xx_container_probe(struct tfa98xx *tfa98xx,
+	struct tfa_cont_image *img)
+{
+	int ret;
+	int value;
 
-	if (tfa98xx->dsp_fw_state == TFA98XX_DSP_FW_RELOADING) {
-		if (tfa98xx == tfa98xx_head_device)
-			tfa98xx_cnt_reload++; /* increase reload counter */
-		pr_info("%s: Reloaded (%d) - dev %d\n",
-			__func__, tfa98xx_cnt_reload, tfa98xx->tfa->dev_idx);
-		tfa98xx->dsp_fw_state = TFA98XX_DSP_FW_OK;
-		mutex_unlock(&probe_lock);
-		return;
-	}
+	/* structure is checked; CRC completes while the device is probed */
+	tfa98xx->tfa->cnt = tfa_cont_image_container(img);
 
 	/*
 	 * i2c transaction limited to 64k
@@ -3607,12 +4110,22 @@ static void tfa98xx_container_loaded
 	/* DSP messages via i2c/ipc */
 	tfa98xx->tfa->has_msg = 0;
 
-	if (tfa_dev_probe(tfa98xx->i2c->addr, tfa98xx->tfa) != 0) {
+	ret = tfa_dev_probe(tfa98xx->i2c->addr, tfa98xx->tfa);
+
+	if (tfa_cont_image_validate(img)) {
+		dev_err(tfa98xx->dev, "Cannot load container file, aborting\n");
+		tfa98xx->tfa->cnt = NULL;
+		return -EINVAL;
+	}
+
+	tfa_cont_image_put(tfa98xx->cnt_img);
+	tfa98xx->cnt_img = tfa_cont_image_get(img);
+
+	if (ret != 0) {
 		dev_err(tfa98xx->dev,
 			"Failed to probe TFA98xx @ 0x%.2x\n",
 			tfa98xx->i2c->addr);
-		mutex_unlock(&probe_lock);
-		return;
+		return -ENODEV;
 	}
 
 /* TEMPORARY, until TFA device is probed before tfa_ext is called */
@@ -3635,8 +4148,7 @@ static void tfa98xx_container_loaded
 	}
 
 	/* Enable debug traces */
-	//tfa98xx->tfa->verbose = trace_level & 1;
-	tfa98xx->tfa->verbose = 1; // force to set 1 during the evaluation period
+	tfa98xx->tfa->verbose = trace_level & 1;
 
 	/* prefix is the application name from the cnt */
 	tfa_cont_get_app_name(tfa98xx->tfa, tfa98xx->fw.name);
@@ -3657,30 +4169,27 @@ static void tfa98xx_container_loaded
 
 	pr_debug("Firmware init complete\n");
 
-	/* allocate buffer_pool */
-	if (tfa98xx == tfa98xx_head_device) {
-		int index = 0;
-
-		pr_info("Allocate buffer_pool\n");
-		for (index = 0; index < POOL_MAX_INDEX; index++)
-			tfa_buffer_pool(tfa98xx->tfa, index,
-				buf_pool_size[index], POOL_ALLOC);
-	}
-
-	if (no_start != 0) {
-		mutex_unlock(&probe_lock);
-		return;
-	}
+	return 0;
+}
 
-	/* Only controls for main device */
-	/* for the first device */
-	if (tfa98xx == tfa98xx_head_device)
-		tfa98xx_create_controls(tfa98xx);
+/*
+ * Hardware phase of the firmware load, with the device's dsp_lock held:
+ * reset a warm amplifier and preload its settings.
+ */
+static void tfa98xx_container_preload(struct tfa98xx *tfa98xx)
+{
+	int ret;
 
 	if (tfa_is_cold(tfa98xx->tfa) == 0) {
-		pr_debug("Warning: device 0x%.2x is still warm\n",
-			tfa98xx->i2c->addr);
-		tfa_reset(tfa98xx->tfa);
+		if (tfa_dev_match_fingerprint(tfa98xx->tfa)) {
+			/* left configured by a previous load: keep it */
+			pr_info("%s: device 0x%.2x is warm and configured\n",
+				__func__, tfa98xx->i2c->addr);
+		} else {
+			pr_debug("Warning: device 0x%.2x is still warm\n",
+				tfa98xx->i2c->addr);
+			tfa_reset(tfa98xx->tfa);
+		}
 	}
 
 	if (tfa98xx->tfa->revid == 0x1a66) {
@@ -3693,7 +4202,6 @@ static void tfa98xx_container_loaded
 
 	/* Preload settings using internal clock on TFA2 */
 	if (tfa98xx->tfa->tfa_family == 2) {
-		mutex_lock(&tfa98xx->dsp_lock);
 		tfa98xx_set_stream_state(tfa98xx->tfa, 0);
 		ret = tfa98xx_tfa_start(tfa98xx,
 			tfa98xx->profile, tfa98xx->vstep);
@@ -3709,72 +4217,721 @@ static void tfa98xx_container_loaded
 		pr_info("%s: dev %d - resp_addr 0x%x, inchannel %d\n",
 			__func__, tfa98xx->tfa->dev_idx,
 			tfa98xx->tfa->resp_address, tfa98xx->tfa->inchannel);
+	}
+
+	if (!tfa98xx->calibrate_done) {
+		/* set MTP_EX and MTP_RE25 by force */
+		tfa98xx->set_mtp_cal = true;
+		tfa98xx->cal_data = 6000; /* hard-coded */
+	}
+
+	tfa98xx_interrupt_enable(tfa98xx, true);
+}
+
+/*
+ * Drop one reference on the container load of a device: the loader holds
+ * one until it stops retrying, each firmware request one until its
+ * callback returns. The load is settled when the last one goes.
+ */
+static void tfa98xx_init_put(struct tfa98xx *tfa98xx)
+{
+	if (atomic_dec_and_test(&tfa98xx->init_pending))
+		complete_all(&tfa98xx->init_done);
+}
+
+static void tfa98xx_container_loaded
+	(const struct firmware *cont, void *context)
+{
+	struct tfa_cont_image *img;
+	struct tfa98xx *tfa98xx = context;
+	int ret;
+
+	/* repeated requests for this device wait; other devices go on */
+	mutex_lock(&tfa98xx->init_lock);
+
+	if (tfa98xx->dsp_fw_state == TFA98XX_DSP_FW_OK) {
+		pr_info("%s: Already loaded\n", __func__);
+		if (cont)
+			release_firmware(cont);
+		goto tfa98xx_container_loaded_exit;
+	}
+
+	tfa98xx->dsp_fw_state = TFA98XX_DSP_FW_FAIL;
+
+	if (!cont) {
+		pr_err("Failed to read %s\n", fw_name);
+		goto tfa98xx_container_loaded_exit;
+	}
+
+	pr_debug("loaded %s - size: %zu\n", fw_name, cont->size);
+
+	mutex_lock(&probe_lock);
+	img = tfa98xx_container_share(cont);
+	mutex_unlock(&probe_lock);
+	if (img == NULL) {
+		dev_err(tfa98xx->dev, "Cannot load container file, aborting\n");
+		goto tfa98xx_container_loaded_exit;
+	}
+
+	mutex_lock(&tfa98xx->dsp_lock);
+	ret = tfa98xx_container_probe(tfa98xx, img);
+	mutex_unlock(&tfa98xx->dsp_lock);
+
+	mutex_lock(&probe_lock);
+	tfa98xx_container_settle(img, ret != -EINVAL);
+	tfa_cont_image_put(img);
+
+	if (ret != 0) {
+		mutex_unlock(&probe_lock);
+		goto tfa98xx_container_loaded_exit;
+	}
+
+	/* allocate buffer_pool */
+	if (tfa98xx == tfa98xx_head_device) {
+		int index = 0;
+
+		pr_info("Allocate buffer_pool\n");
+		for (index = 0; index < POOL_MAX_INDEX; index++)
+			tfa_buffer_pool(tfa98xx->tfa, index,
+				buf_pool_size[index], POOL_ALLOC);
+	}
+
+	/* Only controls for main device */
+	/* for the first device */
+	if (no_start == 0 && tfa98xx == tfa98xx_head_device)
+		tfa98xx_create_controls(tfa98xx);
+	mutex_unlock(&probe_lock);
+
+	if (no_start == 0) {
+		mutex_lock(&tfa98xx->dsp_lock);
+		tfa98xx_container_preload(tfa98xx);
 		mutex_unlock(&tfa98xx->dsp_lock);
 	}
 
-	if (!tfa98xx->calibrate_done) {
-		/* set MTP_EX and MTP_RE25 by force */
-		tfa98xx->set_mtp_cal = true;
-		tfa98xx->cal_data = 6000; /* hard-coded */
-	}
+tfa98xx_container_loaded_exit:
+	mutex_unlock(&tfa98xx->init_lock);
+	tfa98xx_init_put(tfa98xx);
+}
+
+static int tfa98xx_load_container(struct tfa98xx *tfa98xx)
+{
+	int tries = 0, ret;
+
+	mutex_lock(&probe_lock);
+	tfa98xx->dsp_fw_state = TFA98XX_DSP_FW_PENDING;
+	mutex_unlock(&probe_lock);
+
+	do {
+		/* released by the callback, which may run before the return */
+		atomic_inc(&tfa98xx->init_pending);
+#if KERNEL_VERSION(5, 15, 0) <= LINUX_VERSION_CODE
+		ret = request_firmware_nowait(THIS_MODULE,
+			FW_ACTION_UEVENT,
+			fw_name, tfa98xx->dev, GFP_KERNEL,
+			tfa98xx, tfa98xx_container_loaded);
+#else
+		ret = request_firmware_nowait(THIS_MODULE,
+			FW_ACTION_HOTPLUG,
+			fw_name, tfa98xx->dev, GFP_KERNEL,
+			tfa98xx, tfa98xx_container_loaded);	
+#endif
+		if (ret)
+			tfa98xx_init_put(tfa98xx);
+
+		/* wait until driver completes loading */
+		msleep_interruptible(20);
+		if (tfa98xx->dsp_fw_state == TFA98XX_DSP_FW_OK)
+			break;
+
+		msleep_interruptible(80);
+		tries++;
+	} while (tries < TFA98XX_LOADFW_NTRIES
+		&& tfa98xx->dsp_fw_state != TFA98XX_DSP_FW_OK);
+
+	if (ret == 0 && tfa98xx->dsp_fw_state == TFA98XX_DSP_FW_OK) {
+		tfa98xx->probe_state |= TFA98XX_PROBE_STATE_CNT_LOAD_SUCCESS;
+	} else {
+		pr_err("%s: CNT load failed %d\n", __func__, ret);
+	}
+
+	return ret;
+}
+
+/*
+ * Container load and preload of one device, off the component probe,
+ * so that the amplifiers of a card are brought up in parallel.
+ */
+static void tfa98xx_init_work(struct work_struct *work)
+{
+	struct tfa98xx *tfa98xx
+		= container_of(work, struct tfa98xx, init_work.work);
+	int ret;
+
+	ret = tfa98xx_load_container(tfa98xx);
+	pr_debug("Container loading requested: %d\n", ret);
+
+	/* done retrying; the last callback still running settles the load */
+	tfa98xx_init_put(tfa98xx);
+}
+
+/*
+ * Pre-warm at hw_params: the configure phase of the start, without a
+ * stream, while the host sets up its path. The amplifier stays in
+ * powerdown; the start at unmute finds the configuration in place and
+ * skips to the DSP.
+ */
+static void tfa98xx_prewarm_work(struct work_struct *work)
+{
+	struct tfa98xx *tfa98xx
+		= container_of(work, struct tfa98xx, prewarm_work.work);
+	struct tfa_device *tfa = tfa98xx->tfa;
+	enum tfa_error ret;
+
+	mutex_lock(&tfa98xx->dsp_lock);
+	if (tfa98xx->dsp_fw_state != TFA98XX_DSP_FW_OK
+		|| tfa98xx->dsp_init == TFA98XX_DSP_INIT_DONE
+		|| tfa98xx_count_active_stream(BIT_PSTREAM) > 0
+		|| tfa98xx_count_active_stream(BIT_CSTREAM) > 0) {
+		mutex_unlock(&tfa98xx->dsp_lock);
+		return;
+	}
+
+	tfa98xx_adopt_container(tfa98xx);
+
+	pr_info("%s: dev %d, profile %d, rate %d\n", __func__,
+		tfa->dev_idx, tfa98xx->profile, tfa98xx->rate);
+
+	ret = tfa_dev_prewarm(tfa, tfa98xx->profile);
+	if (ret != tfa_error_ok)
+		pr_err("%s: dev %d, error %d\n", __func__, tfa->dev_idx, ret);
+
+	mutex_unlock(&tfa98xx->dsp_lock);
+}
+
+/* a start must not overlap with the pre-warm of any device */
+static void tfa98xx_prewarm_flush(void)
+{
+	struct tfa98xx *tfa98xx;
+
+	mutex_lock(&tfa98xx_mutex);
+	list_for_each_entry(tfa98xx, &tfa98xx_device_list, list)
+		if (tfa98xx->component != NULL)
+			flush_delayed_work(&tfa98xx->prewarm_work);
+	mutex_unlock(&tfa98xx_mutex);
+}
+
+/* no unmute came for the pre-warm: drop it and power down */
+static void tfa98xx_prewarm_cancel(struct tfa98xx *tfa98xx)
+{
+	cancel_delayed_work_sync(&tfa98xx->prewarm_work);
+
+	mutex_lock(&tfa98xx->dsp_lock);
+	if (tfa98xx->dsp_init != TFA98XX_DSP_INIT_DONE
+		&& tfa98xx_count_active_stream(BIT_PSTREAM) == 0
+		&& tfa98xx_count_active_stream(BIT_CSTREAM) == 0)
+		tfa_dev_prewarm_drop(tfa98xx->tfa);
+	mutex_unlock(&tfa98xx->dsp_lock);
+}
+
+/*
+ * Telemetry: speaker temperature and data logger of all devices are
+ * kept in one snapshot. Readers share each part while it is younger
+ * than telemetry_max_age_ms; a part is only read when one asks for it.
+ * Blackbox sampler: the data logger is read periodically while playing
+ * and at the last mute, and each device keeps the last
+ * TFA98XX_BB_SAMPLES of these readings with their time.
+ */
+#define TFA98XX_BB_MAGIC 0x53424254 /* "TBBS" */
+#define TFA98XX_BB_VERSION 1
+
+/* header of the blackbox_samples attribute; samples follow, oldest first */
+struct tfa98xx_bb_hdr {
+	u32 magic;
+	u16 version;
+	u16 sample_size;
+	u32 count;
+	u32 period_ms;
+};
+
+/* one telemetry read at a time, the snapshot and the sample rings */
+static DEFINE_MUTEX(tfa98xx_bb_lock);
+static struct tfa_telemetry tfa98xx_telemetry;
+static void tfa98xx_bb_work_fn(struct work_struct *work);
+static DECLARE_DELAYED_WORK(tfa98xx_bb_work, tfa98xx_bb_work_fn);
+
+/* keep a data logger reading of each device; tfa98xx_bb_lock held */
+/* tfa98xx_mutex held, for the device list */
+static void tfa98xx_bb_store(const struct tfa_log_sample *sample)
+{
+	struct tfa98xx *tfa98xx;
+	struct tfa98xx_bb_sample *bb;
+	u64 now;
+	int idx;
+
+	now = ktime_to_ms(ktime_get_boottime());
+	list_for_each_entry(tfa98xx, &tfa98xx_device_list, list) {
+		if (tfa98xx->tfa == NULL)
+			continue;
+		idx = tfa98xx->tfa->dev_idx;
+		if (idx < 0 || idx >= MAX_HANDLES || !sample[idx].valid)
+			continue;
+
+		bb = &tfa98xx->bb_ring[tfa98xx->bb_head++
+			% TFA98XX_BB_SAMPLES];
+		bb->time_ms = now;
+		bb->maxx = sample[idx].maxx;
+		bb->maxt = sample[idx].maxt;
+		bb->overxmax = sample[idx].overxmax;
+		bb->overtmax = sample[idx].overtmax;
+	}
+}
+
+static bool tfa98xx_telemetry_stale(ktime_t time, int max_age_ms)
+{
+	return time == 0 || max_age_ms <= 0
+		|| ktime_after(ktime_get(), ktime_add_ms(time, max_age_ms));
+}
+
+/*
+ * parts of the telemetry of all devices, read again when older than
+ * max_age_ms
+ * @param tfa the device to read through
+ * @param what TFA_TELEMETRY_* parts the caller uses
+ * @param max_age_ms 0 to read in any case
+ * @param telemetry a copy of the snapshot; may be NULL
+ */
+static void tfa98xx_telemetry_get(struct tfa_device *tfa, int what,
+	int max_age_ms, struct tfa_telemetry *telemetry)
+{
+	struct tfa_telemetry *snap = &tfa98xx_telemetry;
+	int stale = 0;
+
+	mutex_lock(&tfa98xx_bb_lock);
+	if ((what & TFA_TELEMETRY_TSPKR)
+		&& tfa98xx_telemetry_stale(snap->time_tspkr, max_age_ms))
+		stale |= TFA_TELEMETRY_TSPKR;
+	if ((what & TFA_TELEMETRY_LOG)
+		&& tfa98xx_telemetry_stale(snap->time_log, max_age_ms))
+		stale |= TFA_TELEMETRY_LOG;
+	if (stale) {
+		tfa_read_telemetry(tfa, stale, snap);
+		if (stale & TFA_TELEMETRY_LOG)
+			tfa98xx_bb_store(snap->log);
+	}
+	if (telemetry)
+		*telemetry = *snap;
+	mutex_unlock(&tfa98xx_bb_lock);
+}
+
+/* tfa98xx_mutex held, see tfa98xx_bb_store */
+static void tfa98xx_bb_collect(void)
+{
+	struct tfa_device *tfa0 = tfa98xx_get_tfa_device_from_index(-1);
+
+	if (tfa0 != NULL)
+		tfa98xx_telemetry_get(tfa0, TFA_TELEMETRY_LOG, 0, NULL);
+}
+
+static void tfa98xx_bb_work_fn(struct work_struct *work)
+{
+	int period = READ_ONCE(blackbox_period_ms);
+	struct tfa_device *tfa0;
+	struct tfa98xx *tfa98xx;
+
+	/* restarted at the next unmute */
+	if (period <= 0 || tfa98xx_count_active_stream(BIT_PSTREAM) == 0)
+		return;
+
+	/* the request goes through the head device */
+	tfa0 = tfa98xx_get_tfa_device_from_index(-1);
+	if (tfa0 == NULL || tfa0->data == NULL)
+		return;
+	tfa98xx = (struct tfa98xx *)tfa0->data;
+
+	mutex_lock(&tfa98xx_mutex);
+	mutex_lock(&tfa98xx->dsp_lock);
+	tfa98xx_bb_collect();
+	mutex_unlock(&tfa98xx->dsp_lock);
+	mutex_unlock(&tfa98xx_mutex);
+
+	queue_delayed_work(system_power_efficient_wq, &tfa98xx_bb_work,
+		msecs_to_jiffies(period));
+}
+
+static void tfa98xx_bb_start(void)
+{
+	int period = READ_ONCE(blackbox_period_ms);
+
+	if (period <= 0)
+		return;
+
+	mod_delayed_work(system_power_efficient_wq, &tfa98xx_bb_work,
+		msecs_to_jiffies(period));
+}
+
+/*
+ * Speaker temperature cache: readers take the last reading of each
+ * channel while it is younger than spkt_cache_ms, and the listeners
+ * are notified when a channel crosses one of spkt_thresholds. While
+ * playing, one worker refreshes it every spkt_poll_ms, so that pollers
+ * wake up without reading. It does not run without a registered
+ * notifier, and skips the refresh when a reader has just made one.
+ */
+struct tfa98xx_spkt_cache {
+	ktime_t time; /* of the last refresh; 0 if never */
+	int value[MAX_CHANNELS];
+	int level[MAX_CHANNELS]; /* thresholds reached */
+	int notified[MAX_CHANNELS]; /* value at the last notification */
+};
+
+static DEFINE_MUTEX(tfa98xx_spkt_lock);
+static struct tfa98xx_spkt_cache tfa98xx_spkt;
+static BLOCKING_NOTIFIER_HEAD(tfa98xx_spkt_notifier);
+static atomic_t tfa98xx_spkt_listeners = ATOMIC_INIT(0);
+static void tfa98xx_spkt_work_fn(struct work_struct *work);
+static DECLARE_DELAYED_WORK(tfa98xx_spkt_work, tfa98xx_spkt_work_fn);
+
+/* thresholds reached by value: up at a threshold, down below it - hyst */
+static int tfa98xx_spkt_level(int level, int value, int hyst)
+{
+	int count = min_t(int, READ_ONCE(spkt_threshold_count),
+		TFA98XX_SPKT_THRESHOLDS);
+
+	level = min(level, count);
+	while (level < count && value >= spkt_thresholds[level])
+		level++;
+	while (level > 0 && value < spkt_thresholds[level - 1] - hyst)
+		level--;
+
+	return level;
+}
+
+/* read all channels again; tfa98xx_spkt_lock held */
+static unsigned int tfa98xx_spkt_refresh(void)
+{
+	struct tfa98xx_spkt_cache *cache = &tfa98xx_spkt;
+	int hyst = max(READ_ONCE(spkt_hysteresis), 0);
+	unsigned int changed = 0;
+	int channel, value, level;
+
+	for (channel = 0; channel < MAX_CHANNELS; channel++) {
+		value = tfa98xx_update_spkt_data_channel(channel);
+		if (cache->time == 0)
+			cache->notified[channel] = value;
+		cache->value[channel] = value;
+
+		if (READ_ONCE(spkt_threshold_count) > 0) {
+			level = tfa98xx_spkt_level(cache->level[channel],
+				value, hyst);
+			if (level == cache->level[channel])
+				continue;
+			cache->level[channel] = level;
+		} else if (abs(value - cache->notified[channel])
+			< max(hyst, 1)) {
+			continue;
+		}
+		cache->notified[channel] = value;
+		changed |= BIT(channel);
+	}
+	cache->time = ktime_get();
+
+	return changed;
+}
+
+static void tfa98xx_spkt_notify(unsigned int changed)
+{
+	int channel;
+
+	for (channel = 0; channel < MAX_CHANNELS; channel++)
+		if (changed & BIT(channel))
+			blocking_notifier_call_chain(&tfa98xx_spkt_notifier,
+				channel, NULL);
+}
+
+int tfa98xx_get_spkt_cached(int channel)
+{
+	int period = READ_ONCE(spkt_cache_ms);
+	unsigned int changed = 0;
+	int value;
+
+	if (channel < 0 || channel >= MAX_CHANNELS)
+		return DEFAULT_REF_TEMP;
+
+	mutex_lock(&tfa98xx_spkt_lock);
+	if (tfa98xx_spkt.time == 0 || period <= 0
+		|| ktime_after(ktime_get(),
+		ktime_add_ms(tfa98xx_spkt.time, period)))
+		changed = tfa98xx_spkt_refresh();
+	value = tfa98xx_spkt.value[channel];
+	mutex_unlock(&tfa98xx_spkt_lock);
+
+	tfa98xx_spkt_notify(changed);
+
+	return value;
+}
+EXPORT_SYMBOL(tfa98xx_get_spkt_cached);
+
+int tfa98xx_spkt_register_notifier(struct notifier_block *nb)
+{
+	int ret;
+
+	ret = blocking_notifier_chain_register(&tfa98xx_spkt_notifier, nb);
+	if (!ret)
+		atomic_inc(&tfa98xx_spkt_listeners);
+
+	return ret;
+}
+EXPORT_SYMBOL(tfa98xx_spkt_register_notifier);
+
+int tfa98xx_spkt_unregister_notifier(struct notifier_block *nb)
+{
+	int ret;
+
+	ret = blocking_notifier_chain_unregister(&tfa98xx_spkt_notifier,
+		nb);
+	if (!ret)
+		atomic_dec(&tfa98xx_spkt_listeners);
+
+	return ret;
+}
+EXPORT_SYMBOL(tfa98xx_spkt_unregister_notifier);
+
+static void tfa98xx_spkt_work_fn(struct work_struct *work)
+{
+	int period = READ_ONCE(spkt_poll_ms);
+	int playing = tfa98xx_count_active_stream(BIT_PSTREAM);
+	unsigned int changed = 0;
+
+	mutex_lock(&tfa98xx_spkt_lock);
+	if (tfa98xx_spkt.time == 0 || period <= 0
+		|| ktime_after(ktime_get(),
+		ktime_add_ms(tfa98xx_spkt.time, period / 2)))
+		changed = tfa98xx_spkt_refresh();
+	mutex_unlock(&tfa98xx_spkt_lock);
+
+	tfa98xx_spkt_notify(changed);
+
+	/* the refresh after the stream has stopped is the last one */
+	if (period <= 0 || playing == 0
+		|| atomic_read(&tfa98xx_spkt_listeners) == 0)
+		return;
+
+	queue_delayed_work(system_power_efficient_wq, &tfa98xx_spkt_work,
+		msecs_to_jiffies(period));
+}
+
+/* restarted at each unmute; nothing to refresh for without a listener */
+static void tfa98xx_spkt_start(void)
+{
+	int period = READ_ONCE(spkt_poll_ms);
+
+	if (period <= 0 || atomic_read(&tfa98xx_spkt_listeners) == 0)
+		return;
+
+	mod_delayed_work(system_power_efficient_wq, &tfa98xx_spkt_work,
+		msecs_to_jiffies(period));
+}
+
+/*
+ * Thermal: each device is a sensor of the thermal zone that refers to
+ * its node, reading the cached speaker temperature of its channel, and
+ * a cooling device attenuating its speaker gain (TDMSPKG) by one step
+ * per state, up to "thermal-max-attenuation" steps.
+ */
+#define TFA98XX_THERMAL_MAX_ATT	8
+
+static int tfa98xx_tz_temp(struct tfa98xx *tfa98xx, int *temp)
+{
+	if (tfa98xx->tfa == NULL)
+		return -ENODEV;
+
+	*temp = tfa98xx_get_spkt_cached(tfa98xx->tfa->inchannel) * 1000;
+
+	return 0;
+}
+
+#if KERNEL_VERSION(6, 1, 0) <= LINUX_VERSION_CODE
+static int tfa98xx_tz_get_temp(struct thermal_zone_device *tz, int *temp)
+{
+#if KERNEL_VERSION(6, 4, 0) <= LINUX_VERSION_CODE
+	return tfa98xx_tz_temp(thermal_zone_device_priv(tz), temp);
+#else
+	return tfa98xx_tz_temp(tz->devdata, temp);
+#endif
+}
+
+static const struct thermal_zone_device_ops tfa98xx_tz_ops = {
+	.get_temp = tfa98xx_tz_get_temp,
+};
+#else
+static int tfa98xx_tz_get_temp(void *data, int *temp)
+{
+	return tfa98xx_tz_temp(data, temp);
+}
+
+static const struct thermal_zone_of_device_ops tfa98xx_tz_ops = {
+	.get_temp = tfa98xx_tz_get_temp,
+};
+#endif
+
+static int tfa98xx_cdev_get_max_state(struct thermal_cooling_device *cdev,
+	unsigned long *state)
+{
+	struct tfa98xx *tfa98xx = cdev->devdata;
+
+	*state = tfa98xx->thermal_max_att;
+
+	return 0;
+}
+
+static int tfa98xx_cdev_get_cur_state(struct thermal_cooling_device *cdev,
+	unsigned long *state)
+{
+	struct tfa98xx *tfa98xx = cdev->devdata;
+
+	mutex_lock(&tfa98xx_mutex);
+	*state = (tfa98xx->tfa != NULL) ? tfa98xx->tfa->spkgain_att : 0;
+	mutex_unlock(&tfa98xx_mutex);
 
-	tfa98xx_interrupt_enable(tfa98xx, true);
+	return 0;
+}
 
-	mutex_unlock(&probe_lock);
+static int tfa98xx_cdev_set_cur_state(struct thermal_cooling_device *cdev,
+	unsigned long state)
+{
+	struct tfa98xx *tfa98xx = cdev->devdata;
+	struct tfa_device *tfa;
+	int ret = 0;
+
+	if (state > tfa98xx->thermal_max_att)
+		return -EINVAL;
+
+	mutex_lock(&tfa98xx_mutex);
+	tfa = tfa98xx->tfa;
+	if (tfa == NULL || (unsigned long)tfa->spkgain_att == state)
+		goto out;
+
+	/* without a mixer setting, the gain of the profile is attenuated */
+	pr_info("%s: [%d] thermal attenuation %d -> %lu\n",
+		__func__, tfa->dev_idx, tfa->spkgain_att, state);
+	tfa->spkgain_att = state;
+	if (tfa_set_spkgain(tfa) != TFA98XX_ERROR_OK)
+		ret = -EIO;
+
+out:
+	mutex_unlock(&tfa98xx_mutex);
+
+	return ret;
 }
 
-static int tfa98xx_load_container(struct tfa98xx *tfa98xx)
+static const struct thermal_cooling_device_ops tfa98xx_cdev_ops = {
+	.get_max_state = tfa98xx_cdev_get_max_state,
+	.get_cur_state = tfa98xx_cdev_get_cur_state,
+	.set_cur_state = tfa98xx_cdev_set_cur_state,
+};
+
+static void tfa98xx_thermal_init(struct tfa98xx *tfa98xx,
+	struct device *dev, struct device_node *np)
 {
-	int tries = 0, ret;
+	struct thermal_zone_device *tz;
+	struct thermal_cooling_device *cdev;
+	u32 value;
 
-	mutex_lock(&probe_lock);
-	tfa98xx->dsp_fw_state = TFA98XX_DSP_FW_PENDING;
-	mutex_unlock(&probe_lock);
+	/* trip points come with the thermal zone in device tree */
+#if KERNEL_VERSION(6, 1, 0) <= LINUX_VERSION_CODE
+	tz = thermal_of_zone_register(np, 0, tfa98xx, &tfa98xx_tz_ops);
+#else
+	tz = thermal_zone_of_sensor_register(dev, 0, tfa98xx,
+		&tfa98xx_tz_ops);
+#endif
+	if (IS_ERR(tz))
+		dev_dbg(dev, "no thermal zone for the speaker (%ld)\n",
+			PTR_ERR(tz));
+	else
+		tfa98xx->tz = tz;
 
-	do {
-#if KERNEL_VERSION(5, 15, 0) <= LINUX_VERSION_CODE
-		ret = request_firmware_nowait(THIS_MODULE,
-			FW_ACTION_UEVENT,
-			fw_name, tfa98xx->dev, GFP_KERNEL,
-			tfa98xx, tfa98xx_container_loaded);
+	if (of_property_read_u32(np, "thermal-max-attenuation", &value) < 0)
+		value = TFA98XX_THERMAL_MAX_ATT;
+	tfa98xx->thermal_max_att = min_t(u32, value, TFA_TDMSPKG_MAX);
+	if (tfa98xx->thermal_max_att == 0)
+		return;
+
+	cdev = thermal_of_cooling_device_register(np, "tfa98xx_spkgain",
+		tfa98xx, &tfa98xx_cdev_ops);
+	if (IS_ERR(cdev))
+		dev_info(dev, "error registering cooling device (%ld)\n",
+			PTR_ERR(cdev));
+	else
+		tfa98xx->cdev = cdev;
+}
+
+static void tfa98xx_thermal_exit(struct tfa98xx *tfa98xx,
+	struct device *dev)
+{
+	if (tfa98xx->cdev)
+		thermal_cooling_device_unregister(tfa98xx->cdev);
+	tfa98xx->cdev = NULL;
+
+	if (tfa98xx->tz)
+#if KERNEL_VERSION(6, 1, 0) <= LINUX_VERSION_CODE
+		thermal_of_zone_unregister(tfa98xx->tz);
 #else
-		ret = request_firmware_nowait(THIS_MODULE,
-			FW_ACTION_HOTPLUG,
-			fw_name, tfa98xx->dev, GFP_KERNEL,
-			tfa98xx, tfa98xx_container_loaded);	
+		thermal_zone_of_sensor_unregister(dev, tfa98xx->tz);
 #endif
-		/* wait until driver completes loading */
-		msleep_interruptible(20);
-		if (tfa98xx->dsp_fw_state == TFA98XX_DSP_FW_OK)
-			break;
+	tfa98xx->tz = NULL;
+}
 
-		msleep_interruptible(80);
-		tries++;
-	} while (tries < TFA98XX_LOADFW_NTRIES
-		&& tfa98xx->dsp_fw_state != TFA98XX_DSP_FW_OK);
+/* (re)start the monitor at its shortest period */
+static void tfa98xx_monitor_start(struct tfa98xx *tfa98xx)
+{
+	if (tfa98xx->tfa98xx_wq == NULL)
+		return;
 
-	if (ret == 0 && tfa98xx->dsp_fw_state == TFA98XX_DSP_FW_OK) {
-		tfa98xx->probe_state |= TFA98XX_PROBE_STATE_CNT_LOAD_SUCCESS;
-	} else {
-		pr_err("%s: CNT load failed %d\n", __func__, ret);
-	}
+	tfa98xx->monitor_ms = TFA98XX_MONITOR_MIN_MS;
+	tfa98xx->monitor_last = ktime_get();
+	mod_delayed_work(tfa98xx->tfa98xx_wq, &tfa98xx->monitor_work,
+		msecs_to_jiffies(TFA98XX_MONITOR_MIN_MS));
+}
 
-	return ret;
+/* an interrupt reported an error: check the device at once */
+static void tfa98xx_monitor_kick(struct tfa98xx *tfa98xx)
+{
+	if (tfa98xx->tfa98xx_wq == NULL || tfa98xx->pstream == 0)
+		return;
+
+	if (tfa98xx->monitor_event == 0)
+		tfa98xx->monitor_event = ktime_get();
+	mod_delayed_work(tfa98xx->tfa98xx_wq, &tfa98xx->monitor_work, 0);
 }
 
 static void tfa98xx_monitor(struct work_struct *work)
 {
 	struct tfa98xx *tfa98xx;
+	struct tfa98xx_monitor_stat *stat;
 	enum tfa98xx_error error = TFA98XX_ERROR_OK;
 	int handle = -1, is_active = 0;
-	unsigned int val;
+	unsigned int val, latency;
+	ktime_t now, event;
+	bool failed;
 	int ret;
 
 	mutex_lock(&probe_lock);
 
 	tfa98xx = container_of(work, struct tfa98xx, monitor_work.work);
+	stat = &tfa98xx->monitor_stat;
+
+	event = tfa98xx->monitor_event;
+	tfa98xx->monitor_event = 0;
+
+	/* suspended while no stream is active */
+	if (tfa98xx->pstream == 0) {
+		pr_debug("%s: [%d] no stream: suspended\n", __func__,
+			tfa98xx->tfa->dev_idx);
+		mutex_unlock(&probe_lock);
+		return;
+	}
 
-	pr_info("%s: [%d] - profile = %d: %s\n", __func__,
+	pr_debug("%s: [%d] - profile = %d: %s\n", __func__,
 		tfa98xx->tfa->dev_idx, tfa98xx->profile,
 		_tfa_cont_profile_name(tfa98xx, tfa98xx->profile));
 
@@ -3784,17 +4941,23 @@ static void tfa98xx_monitor(struct work_struct *work)
 	is_active = tfa_is_active_device(tfa98xx->tfa);
 	if (is_active) {
 		handle = tfa98xx->tfa->dev_idx;
-		pr_info("%s: profile = %d, active handle [%s]: 0x%x\n",
+		pr_debug("%s: profile = %d, active handle [%s]: 0x%x\n",
 			__func__, tfa98xx->profile,
 			tfa_cont_device_name(tfa98xx->tfa->cnt, handle),
 			tfa98xx->tfa->active_handle);
 	} else {
-		goto tfa_monitor_exit;
+		/* nothing to watch until the next start */
+		mutex_unlock(&probe_lock);
+		return;
 	}
 
+	stat->polls++;
+	if (event)
+		stat->events++;
+
 	mutex_lock(&tfa98xx->dsp_lock);
 	if (tfa98xx->overlay_bf != 0xffff)
-		pr_info("%s: dev %d - current value at 0x%04x: 0x%04x\n",
+		pr_debug("%s: dev %d - current value at 0x%04x: 0x%04x\n",
 			__func__, tfa98xx->tfa->dev_idx,
 			tfa98xx->overlay_bf,
 			tfa_get_bf(tfa98xx->tfa,
@@ -3819,62 +4982,223 @@ static void tfa98xx_monitor(struct work_struct *work)
 	}
 
 	/* for debugging */
-	mutex_lock(&tfa98xx->dsp_lock);
-	ret = regmap_read(tfa98xx->regmap, TFA98XX_SYS_CONTROL0, &val);
-	if (!ret)
-		pr_debug("[%d] SYS_CONTROL0: 0x%04x\n", handle, val);
-	ret = regmap_read(tfa98xx->regmap, TFA98XX_SYS_CONTROL1, &val);
-	if (!ret)
-		pr_debug("[%d] SYS_CONTROL1: 0x%04x\n", handle, val);
-	ret = regmap_read(tfa98xx->regmap, TFA98XX_SYS_CONTROL2, &val);
-	if (!ret)
-		pr_debug("[%d] SYS_CONTROL2: 0x%04x\n", handle, val);
-	ret = regmap_read(tfa98xx->regmap, TFA98XX_CLOCK_CONTROL, &val);
-	if (!ret)
-		pr_debug("[%d] CLOCK_CONTROL: 0x%04x\n", handle, val);
-	ret = regmap_read(tfa98xx->regmap, TFA98XX_STATUS_FLAGS0, &val);
-	if (!ret)
-		pr_debug("[%d] STATUS_FLAG0: 0x%04x\n", handle, val);
-	ret = regmap_read(tfa98xx->regmap, TFA98XX_STATUS_FLAGS1, &val);
-	if (!ret)
-		pr_debug("[%d] STATUS_FLAG1: 0x%04x\n", handle, val);
-	ret = regmap_read(tfa98xx->regmap, TFA98XX_STATUS_FLAGS2, &val);
-	if (!ret)
-		pr_debug("[%d] STATUS_FLAG2: 0x%04x\n", handle, val);
-	ret = regmap_read(tfa98xx->regmap, TFA98XX_STATUS_FLAGS3, &val);
-	if (!ret)
-		pr_debug("[%d] STATUS_FLAG3: 0x%04x\n", handle, val);
-	ret = regmap_read(tfa98xx->regmap, TFA98XX_TDM_CONFIG0, &val);
-	if (!ret)
-		pr_debug("[%d] TDM_CONFIG0: 0x%04x\n", handle, val);
-	mutex_unlock(&tfa98xx->dsp_lock);
+	if (tfa98xx->tfa->verbose) {
+		mutex_lock(&tfa98xx->dsp_lock);
+		ret = regmap_read(tfa98xx->regmap, TFA98XX_SYS_CONTROL0, &val);
+		if (!ret)
+			pr_debug("[%d] SYS_CONTROL0: 0x%04x\n", handle, val);
+		ret = regmap_read(tfa98xx->regmap, TFA98XX_SYS_CONTROL1, &val);
+		if (!ret)
+			pr_debug("[%d] SYS_CONTROL1: 0x%04x\n", handle, val);
+		ret = regmap_read(tfa98xx->regmap, TFA98XX_SYS_CONTROL2, &val);
+		if (!ret)
+			pr_debug("[%d] SYS_CONTROL2: 0x%04x\n", handle, val);
+		ret = regmap_read(tfa98xx->regmap, TFA98XX_CLOCK_CONTROL, &val);
+		if (!ret)
+			pr_debug("[%d] CLOCK_CONTROL: 0x%04x\n", handle, val);
+		ret = regmap_read(tfa98xx->regmap, TFA98XX_STATUS_FLAGS0, &val);
+		if (!ret)
+			pr_debug("[%d] STATUS_FLAG0: 0x%04x\n", handle, val);
+		ret = regmap_read(tfa98xx->regmap, TFA98XX_STATUS_FLAGS1, &val);
+		if (!ret)
+			pr_debug("[%d] STATUS_FLAG1: 0x%04x\n", handle, val);
+		ret = regmap_read(tfa98xx->regmap, TFA98XX_STATUS_FLAGS2, &val);
+		if (!ret)
+			pr_debug("[%d] STATUS_FLAG2: 0x%04x\n", handle, val);
+		ret = regmap_read(tfa98xx->regmap, TFA98XX_STATUS_FLAGS3, &val);
+		if (!ret)
+			pr_debug("[%d] STATUS_FLAG3: 0x%04x\n", handle, val);
+		ret = regmap_read(tfa98xx->regmap, TFA98XX_TDM_CONFIG0, &val);
+		if (!ret)
+			pr_debug("[%d] TDM_CONFIG0: 0x%04x\n", handle, val);
+		mutex_unlock(&tfa98xx->dsp_lock);
+	}
+
+	/* an interrupt counts as an error, even if it has cleared since */
+	failed = (error != TFA98XX_ERROR_OK) || event != 0;
+	now = ktime_get();
+	if (failed) {
+		/* from the interrupt, or at worst from the previous poll */
+		latency = (unsigned int)ktime_us_delta(now,
+			event ? event : tfa98xx->monitor_last);
+		stat->errors++;
+		stat->last_latency_us = latency;
+		stat->max_latency_us = max(stat->max_latency_us, latency);
+		tfa98xx->monitor_ms = TFA98XX_MONITOR_MIN_MS;
+	} else {
+		tfa98xx->monitor_ms = min(tfa98xx->monitor_ms * 2,
+			(unsigned int)TFA98XX_MONITOR_MAX_MS);
+	}
+	tfa98xx->monitor_last = now;
 
-tfa_monitor_exit:
-	pr_info("%s: exit\n", __func__);
+	pr_debug("%s: [%d] error %d, next in %u ms\n", __func__,
+		handle, error, tfa98xx->monitor_ms);
 
 	mutex_unlock(&probe_lock);
 
-#if 0 // in case verbose is 1, it does not need to monitor several times
-	if (!tfa98xx->tfa->verbose)
-		return;
+	/* an interrupt may have queued it already: keep the earlier one */
+	queue_delayed_work(tfa98xx->tfa98xx_wq, &tfa98xx->monitor_work,
+		msecs_to_jiffies(tfa98xx->monitor_ms));
+}
 
-	if (tfa98xx_monitor_count != -1)
-		if (++tfa98xx_monitor_count > MONITOR_COUNT_MAX)
-			return;
+/* unmute the started devices of the group; tfa98xx_mutex held */
+static void tfa98xx_group_release(void)
+{
+	struct tfa98xx *tfa98xx;
+	struct tfa_device *ntfa;
+	ktime_t first = 0, last = 0;
+	int unmuted = 0;
+	s64 skew;
 
-	/* reschedule */
-	queue_delayed_work(tfa98xx->tfa98xx_wq,
-		&tfa98xx->monitor_work, 5 * HZ);
-#endif
+	list_for_each_entry(tfa98xx, &tfa98xx_device_list, list) {
+		ntfa = tfa98xx->tfa;
+
+		mutex_lock(&tfa98xx->dsp_lock);
+		if (tfa98xx->sync_state == TFA98XX_SYNC_STARTED)
+			tfa_phase_end(ntfa, TFA_PHASE_SYNC, 0);
+		if (tfa98xx->sync_state == TFA98XX_SYNC_FAILED) {
+			tfa_phase_end(ntfa, TFA_PHASE_SYNC, 1);
+			tfa98xx->dsp_init = TFA98XX_DSP_INIT_FAIL;
+		}
+		tfa98xx_set_dsp_configured(tfa98xx);
+		tfa_set_spkgain(ntfa); // need to setgain for all tfa devices
+		mutex_unlock(&tfa98xx->dsp_lock);
+	}
+
+	/* nothing else in between, to keep the skew small */
+	list_for_each_entry(tfa98xx, &tfa98xx_device_list, list) {
+		if (tfa98xx->sync_state != TFA98XX_SYNC_STARTED
+			|| !tfa_is_active_device(tfa98xx->tfa))
+			continue;
+
+		mutex_lock(&tfa98xx->dsp_lock);
+		tfa98xx->unmute_time = ktime_get();
+		tfa_dev_set_state(tfa98xx->tfa, TFA_STATE_UNMUTE, 0);
+		mutex_unlock(&tfa98xx->dsp_lock);
+
+		if (unmuted++ == 0)
+			first = tfa98xx->unmute_time;
+		last = tfa98xx->unmute_time;
+	}
+
+	list_for_each_entry(tfa98xx, &tfa98xx_device_list, list) {
+		ntfa = tfa98xx->tfa;
+
+		if (tfa98xx->sync_state != TFA98XX_SYNC_STARTED
+			&& tfa98xx->sync_state != TFA98XX_SYNC_FAILED)
+			continue;
+
+		if (!tfa_is_active_device(ntfa)) {
+			tfa98xx->sync_state = TFA98XX_SYNC_MUTED;
+			continue;
+		}
+
+		pr_info("%s: profile = %d, active handle [%s]: 0x%x\n",
+			__func__, tfa98xx->profile,
+			tfa_cont_device_name(ntfa->cnt,
+			ntfa->dev_idx),
+			ntfa->active_handle);
+
+		if (tfa98xx->sync_state == TFA98XX_SYNC_FAILED) {
+			tfa98xx->sync_state = TFA98XX_SYNC_MUTED;
+			tfa_handle_damaged_speakers(ntfa);
+			continue;
+		}
+
+		pr_info("%s: UNMUTE dev %d\n", __func__, ntfa->dev_idx);
+		tfa98xx->sync_state = TFA98XX_SYNC_UNMUTED;
+
+		mutex_lock(&tfa98xx->dsp_lock);
+		if (ntfa->blackbox_enable) {
+			ntfa->interrupt_enable[0]
+				|= TFA_BF_MSK(TFA9866_BF_IENOCLK);
+			tfa_irq_init(ntfa);
+		}
+
+		/*
+		 * start monitor thread to check IC status bit
+		 * periodically, and re-init IC to recover if
+		 * needed.
+		 */
+		tfa98xx_monitor_start(tfa98xx);
+		tfa98xx_bb_start();
+		tfa98xx_spkt_start();
+		mutex_unlock(&tfa98xx->dsp_lock);
+		sec_audio_debug_get_amp_status(ntfa->dev_idx);
+	}
+
+	if (unmuted > 1) {
+		skew = ktime_us_delta(last, first);
+		tfa98xx_group.last_skew_us = skew;
+		if (skew > tfa98xx_group.max_skew_us)
+			tfa98xx_group.max_skew_us = skew;
+		pr_info("%s: %d devices unmuted, skew %lld us\n",
+			__func__, unmuted, skew);
+	}
+}
+
+static void tfa98xx_group_timeout(struct work_struct *work)
+{
+	mutex_lock(&tfa98xx_mutex);
+	if (!tfa98xx_group.released) {
+		pr_err("%s: not all devices started in %d ms\n",
+			__func__, TFA98XX_SYNC_TIMEOUT);
+		tfa98xx_group.timeouts++;
+		tfa98xx_group.released = true;
+		tfa98xx_group_release();
+	}
+	mutex_unlock(&tfa98xx_mutex);
+}
+
+/* a started device joins the group, and the last one unmutes all */
+static void tfa98xx_group_join(struct tfa98xx *tfa98xx, bool failed)
+{
+	struct tfa98xx *ntfa98xx;
+	int expected, joined = 0;
+
+	if (tfa98xx->tfa->active_count == -1)
+		tfa_set_active_handle(tfa98xx->tfa, tfa98xx->profile);
+
+	mutex_lock(&tfa98xx_mutex);
+	expected = tfa98xx->tfa->active_count;
+	tfa98xx->sync_state = failed
+		? TFA98XX_SYNC_FAILED : TFA98XX_SYNC_STARTED;
+
+	list_for_each_entry(ntfa98xx, &tfa98xx_device_list, list)
+		if (ntfa98xx->sync_state != TFA98XX_SYNC_IDLE)
+			joined++;
+
+	if (tfa98xx_group.released || joined >= expected) {
+		cancel_delayed_work(&tfa98xx_group_work);
+		tfa98xx_group.released = true;
+		tfa98xx_group_release();
+	} else if (joined == 1) {
+		/* one slow device must not hold the others muted */
+		queue_delayed_work(system_unbound_wq, &tfa98xx_group_work,
+			msecs_to_jiffies(TFA98XX_SYNC_TIMEOUT));
+	}
+	mutex_unlock(&tfa98xx_mutex);
+}
+
+/* at stream stop: the next start makes a new group */
+static void tfa98xx_group_reset(void)
+{
+	struct tfa98xx *tfa98xx;
+
+	cancel_delayed_work_sync(&tfa98xx_group_work);
+
+	mutex_lock(&tfa98xx_mutex);
+	tfa98xx_group.released = false;
+	list_for_each_entry(tfa98xx, &tfa98xx_device_list, list)
+		tfa98xx->sync_state = TFA98XX_SYNC_IDLE;
+	mutex_unlock(&tfa98xx_mutex);
 }
 
 static void tfa98xx_dsp_init(struct tfa98xx *tfa98xx)
 {
 	int ret;
-	static bool failed;
+	bool failed = false;
 	bool sync = false;
-	bool do_sync;
-	int active_device_count;
 
 	if (tfa98xx->dsp_fw_state != TFA98XX_DSP_FW_OK) {
 		pr_debug("Skipping tfa_dev_start (no FW: %d)\n",
@@ -3889,30 +5213,30 @@ static void tfa98xx_dsp_init(struct tfa98xx *tfa98xx)
 
 	pr_info("%s: ...\n", __func__);
 
-	mutex_lock(&tfa98xx_mutex);
-	active_device_count = tfa98xx_device_count;
-	mutex_unlock(&tfa98xx_mutex);
+	if (prewarm)
+		tfa98xx_prewarm_flush();
 
 	mutex_lock(&tfa98xx->dsp_lock);
 	tfa98xx->dsp_init = TFA98XX_DSP_INIT_PENDING;
 
+	/* apply a reloaded container at stream start */
+	tfa98xx_adopt_container(tfa98xx);
+
 	/* directly try to start DSP */
 	ret = tfa98xx_tfa_start(tfa98xx,
 		tfa98xx->profile, tfa98xx->vstep);
 	if (ret == TFA98XX_ERROR_NOT_SUPPORTED) {
 		tfa98xx->dsp_fw_state = TFA98XX_DSP_FW_FAIL;
 		dev_err(tfa98xx->dev, "Failed in starting device\n");
-		failed = true;
 	} else if (ret != TFA98XX_ERROR_OK) {
 		dev_err(tfa98xx->dev,
 			"Failed in starting device (err %d; count %d)\n",
 			ret, tfa98xx->init_count);
 		failed = true;
-		sync = true; /* unmute by force, even if it fails */
+		sync = true; /* release the group, even if it fails */
 		tfa98xx->init_count = 0;
 	} else {
 		sync = true;
-		failed = false;
 
 		/* Subsystem ready, tfa init complete */
 		tfa98xx->dsp_init = TFA98XX_DSP_INIT_DONE;
@@ -3922,137 +5246,15 @@ static void tfa98xx_dsp_init(struct tfa98xx *tfa98xx)
 		tfa98xx->init_count = 0;
 	}
 
+	if (sync)
+		tfa_phase_begin(tfa98xx->tfa, TFA_PHASE_SYNC);
 	mutex_unlock(&tfa98xx->dsp_lock);
 
 	if (!sync)
 		return;
 
-	if (tfa98xx->tfa->active_count == -1)
-		tfa_set_active_handle(tfa98xx->tfa, tfa98xx->profile);
-
-	/* check if all devices have started */
-	mutex_lock(&tfa98xx_mutex);
-	active_device_count = tfa98xx->tfa->active_count;
-	if (tfa98xx_sync_count < active_device_count)
-		tfa98xx_sync_count++;
-
-	do_sync = (tfa98xx_sync_count >= active_device_count);
-
 	/* when all devices have started then unmute */
-	if (do_sync) {
-		tfa98xx_sync_count = 0;
-
-		list_for_each_entry(tfa98xx,
-			&tfa98xx_device_list, list) {
-			struct tfa_device *ntfa = tfa98xx->tfa;
-
-			mutex_lock(&tfa98xx->dsp_lock);
-			if (failed)
-				tfa98xx->dsp_init
-					= TFA98XX_DSP_INIT_FAIL;
-			tfa98xx_set_dsp_configured(tfa98xx);
-			tfa_set_spkgain(ntfa); // need to setgain for all tfa devices
-			mutex_unlock(&tfa98xx->dsp_lock);
-
-			if (!tfa_is_active_device(ntfa))
-				continue;
-
-			pr_info("%s: profile = %d, active handle [%s]: 0x%x\n",
-				__func__, tfa98xx->profile,
-				tfa_cont_device_name(ntfa->cnt,
-				ntfa->dev_idx),
-				ntfa->active_handle);
-
-			if (failed) {
-				tfa_handle_damaged_speakers(ntfa);
-				continue;
-			}
-
-			mutex_lock(&tfa98xx->dsp_lock);
-			pr_info("%s: UNMUTE dev %d\n",
-				__func__, ntfa->dev_idx);
-			tfa_dev_set_state(ntfa,
-				TFA_STATE_UNMUTE, 0);
-
-			if (ntfa->blackbox_enable) {
-				ntfa->interrupt_enable[0]
-					|= TFA_BF_MSK(TFA9866_BF_IENOCLK);
-				tfa_irq_init(ntfa);
-			}
-
-			/*
-			 * start monitor thread to check IC status bit
-			 * periodically, and re-init IC to recover if
-			 * needed.
-			 */
-			tfa98xx_monitor_count = 0;
-			queue_delayed_work(tfa98xx->tfa98xx_wq,
-				&tfa98xx->monitor_work,
-				1 * HZ);
-			mutex_unlock(&tfa98xx->dsp_lock);
-			sec_audio_debug_get_amp_status(ntfa->dev_idx);
-		}
-
-		failed = false;
-	}
-	mutex_unlock(&tfa98xx_mutex);
-}
-
-static void tfa98xx_interrupt(struct work_struct *work)
-{
-	struct tfa98xx *tfa98xx0
-		= container_of(work, struct tfa98xx, interrupt_work.work);
-	struct tfa98xx *tfa98xx;
-	struct tfa_device *tfa;
-	int irq_gpio;
-	int value0 = 0, value3 = 0;
-	int dev_cnt = 0;
-
-#if defined(TFA_STEREO_NODE)
-	dev_cnt = 2;
-#else
-	dev_cnt = 1;
-#endif
-
-	if (tfa98xx0 == NULL || tfa98xx0->tfa == NULL) {
-		pr_info("%s: skip as tfa98xx is not ready\n", __func__);
-		return;
-	}
-
-	irq_gpio = tfa98xx0->irq_gpio;
-	pr_info("%s: triggered: dev %d\n",
-		__func__, tfa98xx0->tfa->dev_idx);
-
-	if (tfa_probed_device_cnt < dev_cnt) {
-		pr_info("%s: probed_device_cnt is %d\n",
-			__func__, tfa_probed_device_cnt);
-	}
-
-	list_for_each_entry(tfa98xx, &tfa98xx_device_list, list) {
-		if (tfa98xx->tfa == NULL) {
-			pr_debug("[0x%x] device is not available\n",
-				tfa98xx->i2c->addr);
-			continue;
-		}
-		if (irq_gpio != tfa98xx->irq_gpio) /* IRQ not shared */
-			continue;
-
-		tfa = tfa98xx->tfa;
-		value0 = TFAxx_READ_REG(tfa, VDDS);
-		value3 = TFAxx_READ_REG(tfa, BODNOK);
-		pr_info("%s: [%d] status_flags: 0x%04x, 0x%04x\n",
-			__func__, tfa->dev_idx, value0, value3);
-
-		/* Remove sticky bit by writing flags */
-		tfa_reset_sticky_bits(tfa);
-
-		mutex_lock(&tfa98xx->dsp_lock);
-		tfa_irq_report(tfa);
-		mutex_unlock(&tfa98xx->dsp_lock);
-	}
-
-	/* unmask interrupts masked in IRQ handler */
-	tfa_irq_unmask(tfa98xx0->tfa);
+	tfa98xx_group_join(tfa98xx, failed);
 }
 
 static void tfa98xx_overlay(struct work_struct *work)
@@ -4108,6 +5310,12 @@ static int tfa98xx_startup(struct snd_pcm_substream *substream,
 
 	cdev = component->dev;
 
+	/* the device may still be loading its container */
+	if (tfa98xx->tfa != NULL
+		&& wait_for_completion_killable_timeout(&tfa98xx->init_done,
+		msecs_to_jiffies(TFA98XX_INIT_TIMEOUT)) <= 0)
+		dev_warn(cdev, "container not loaded yet\n");
+
 	/*
 	 * Support CODEC to CODEC links,
 	 * these are called with a NULL runtime pointer.
@@ -4264,6 +5472,27 @@ static int tfa98xx_hw_params(struct snd_pcm_substream *substream,
 	/* update to new rate */
 	tfa98xx->rate = rate;
 
+	/* configure the amplifier while the host sets up its path */
+	if (prewarm && substream->stream == SNDRV_PCM_STREAM_PLAYBACK
+		&& tfa98xx->dsp_fw_state == TFA98XX_DSP_FW_OK)
+		queue_delayed_work(system_unbound_wq,
+			&tfa98xx->prewarm_work, 0);
+
+	return 0;
+}
+
+static int tfa98xx_hw_free(struct snd_pcm_substream *substream,
+	struct snd_soc_dai *dai)
+{
+	struct snd_soc_component *component = dai->component;
+	struct tfa98xx *tfa98xx
+		= snd_soc_component_get_drvdata(component);
+
+	/* also when prewarm was cleared since hw_params */
+	if (substream->stream == SNDRV_PCM_STREAM_PLAYBACK
+		&& tfa98xx->tfa != NULL)
+		tfa98xx_prewarm_cancel(tfa98xx);
+
 	return 0;
 }
 
@@ -4311,9 +5540,9 @@ static int _tfa98xx_mute(struct tfa98xx *tfa98xx, int mute, int stream)
 			tfa98xx->cstream = 0;
 		}
 
+		/* also held for the blackbox logging, which walks the list */
 		mutex_lock(&tfa98xx_mutex);
 		active_device_count = tfa98xx_device_count;
-		mutex_unlock(&tfa98xx_mutex);
 
 		mutex_lock(&tfa98xx->dsp_lock);
 		pr_info("mute:%d dev[%d] stream %d [pstream %d, cstream %d]\n", mute,
@@ -4333,11 +5562,7 @@ static int _tfa98xx_mute(struct tfa98xx *tfa98xx, int mute, int stream)
 				 */
 #if !defined(TFA_PLATFORM_QUALCOMM)
 				pr_info("%s: get blackbox logging\n", __func__);
-#if defined(TFA_SUPPORT_NEW_DATALOGGER)
-				tfa_update_log2();
-#else
-				tfa_update_log();
-#endif
+				tfa98xx_bb_collect();
 #endif
 			}
 		tfa98xx->tfa->unset_log = 0;
@@ -4346,6 +5571,7 @@ static int _tfa98xx_mute(struct tfa98xx *tfa98xx, int mute, int stream)
 			(tfa98xx->pstream & BIT_PSTREAM)
 			|((tfa98xx->cstream<<1) & BIT_CSTREAM));
 		mutex_unlock(&tfa98xx->dsp_lock);
+		mutex_unlock(&tfa98xx_mutex);
 
 		/* case: either p/cstream is off
 		 * if (!(tfa98xx->pstream == 0 || tfa98xx->cstream == 0)) {
@@ -4361,9 +5587,7 @@ static int _tfa98xx_mute(struct tfa98xx *tfa98xx, int mute, int stream)
 			return 0;
 		}
 
-		mutex_lock(&tfa98xx_mutex);
-		tfa98xx_sync_count = 0;
-		mutex_unlock(&tfa98xx_mutex);
+		tfa98xx_group_reset();
 
 		cancel_delayed_work_sync(&tfa98xx->monitor_work);
 
@@ -4419,21 +5643,66 @@ static int _tfa98xx_mute(struct tfa98xx *tfa98xx, int mute, int stream)
 	return 0;
 }
 
-static int _tfa98xx_stop(struct tfa98xx *tfa98xx)
+static int _tfa98xx_stop(struct tfa98xx *tfa98xx)
+{
+	tfa98xx_stop_all(&tfa98xx, 1);
+
+	return 0;
+}
+
+/*
+ * Stop devices in phases, each phase on all of them before the next:
+ * ramp down, mute and power down, one settle wait, then finish.
+ * Stopping several devices then takes as long as stopping one.
+ */
+static void tfa98xx_stop_all(struct tfa98xx **stop, int count)
 {
-	if (tfa98xx->dsp_fw_state != TFA98XX_DSP_FW_OK)
-		return 0;
+	enum tfa_error err[MAX_HANDLES];
+	struct tfa98xx *tfa98xx;
+	bool settle = false;
+	int i;
 
-	cancel_delayed_work(&tfa98xx->overlay_work);
+	for (i = 0; i < count; i++) {
+		tfa98xx = stop[i];
+		err[i] = tfa_error_other; /* not stopped */
+		if (tfa98xx->dsp_fw_state != TFA98XX_DSP_FW_OK)
+			continue;
 
-	mutex_lock(&tfa98xx->dsp_lock);
-	tfa_dev_stop(tfa98xx->tfa);
-	tfa98xx->dsp_init = TFA98XX_DSP_INIT_STOPPED;
-	tfa98xx_set_dsp_configured(tfa98xx);
-	mutex_unlock(&tfa98xx->dsp_lock);
-	sec_audio_debug_get_amp_status(tfa98xx->tfa->dev_idx);
+		cancel_delayed_work(&tfa98xx->overlay_work);
 
-	return 0;
+		mutex_lock(&tfa98xx->dsp_lock);
+		err[i] = tfa_dev_stop_ramp(tfa98xx->tfa);
+		mutex_unlock(&tfa98xx->dsp_lock);
+	}
+
+	for (i = 0; i < count; i++) {
+		tfa98xx = stop[i];
+		if (err[i] != tfa_error_ok)
+			continue;
+
+		mutex_lock(&tfa98xx->dsp_lock);
+		err[i] = tfa_dev_stop_powerdown(tfa98xx->tfa);
+		mutex_unlock(&tfa98xx->dsp_lock);
+		if (err[i] == tfa_error_ok)
+			settle = true;
+	}
+
+	if (settle)
+		msleep_interruptible(TFA_STOP_SETTLE_MS);
+
+	for (i = 0; i < count; i++) {
+		tfa98xx = stop[i];
+		if (tfa98xx->dsp_fw_state != TFA98XX_DSP_FW_OK)
+			continue;
+
+		mutex_lock(&tfa98xx->dsp_lock);
+		if (err[i] == tfa_error_ok)
+			tfa_dev_stop_done(tfa98xx->tfa);
+		tfa98xx->dsp_init = TFA98XX_DSP_INIT_STOPPED;
+		tfa98xx_set_dsp_configured(tfa98xx);
+		mutex_unlock(&tfa98xx->dsp_lock);
+		sec_audio_debug_get_amp_status(tfa98xx->tfa->dev_idx);
+	}
 }
 
 static const struct snd_soc_dai_ops tfa98xx_dai_ops = {
@@ -4442,6 +5711,7 @@ static const struct snd_soc_dai_ops tfa98xx_dai_ops = {
 	.set_sysclk = tfa98xx_set_dai_sysclk,
 	.set_tdm_slot = tfa98xx_set_tdm_slot,
 	.hw_params = tfa98xx_hw_params,
+	.hw_free = tfa98xx_hw_free,
 	.mute_stream = tfa98xx_mute,
 };
 
@@ -4497,21 +5767,21 @@ static int tfa98xx_probe(struct snd_soc_component *component)
 	if (!tfa98xx->tfa98xx_wq)
 		return -ENOMEM;
 
+	INIT_DELAYED_WORK(&tfa98xx->init_work, tfa98xx_init_work);
+	INIT_DELAYED_WORK(&tfa98xx->prewarm_work, tfa98xx_prewarm_work);
 	INIT_DELAYED_WORK(&tfa98xx->monitor_work, tfa98xx_monitor);
-	INIT_DELAYED_WORK(&tfa98xx->interrupt_work, tfa98xx_interrupt);
 	INIT_DELAYED_WORK(&tfa98xx->overlay_work, tfa98xx_overlay);
 
 	tfa98xx->component = component;
 
 	snd_soc_component_init_regmap(component, tfa98xx->regmap);
 
-	ret = tfa98xx_load_container(tfa98xx);
-	pr_debug("Container loading requested: %d\n", ret);
+	/* load the container and preload the device in the background */
+	queue_delayed_work(system_unbound_wq, &tfa98xx->init_work, 0);
 
 	tfa98xx_add_widgets(tfa98xx);
 
-	dev_info(cdev, "tfa98xx codec registered (%s)\n",
-		tfa98xx->fw.name);
+	dev_info(cdev, "tfa98xx codec registered\n");
 
 	tfa_probed_device_cnt++;
 
@@ -4527,10 +5797,12 @@ static void tfa98xx_remove(struct snd_soc_component *component)
 	if (tfa98xx == NULL || tfa98xx->tfa == NULL)
 		return;
 
+	cancel_delayed_work_sync(&tfa98xx->init_work);
+	cancel_delayed_work_sync(&tfa98xx->prewarm_work);
+
 	tfa98xx_interrupt_enable(tfa98xx, false);
 
 	cancel_delayed_work_sync(&tfa98xx->overlay_work);
-	cancel_delayed_work_sync(&tfa98xx->interrupt_work);
 	cancel_delayed_work_sync(&tfa98xx->monitor_work);
 
 	if (tfa98xx->tfa98xx_wq)
@@ -4584,22 +5856,94 @@ static const struct regmap_config tfa98xx_regmap = {
 	.cache_type = REGCACHE_NONE,
 };
 
+/* hard interrupt: no bus access here, only take the time */
+static irqreturn_t tfa98xx_irq_hard(int irq, void *data)
+{
+	struct tfa98xx *tfa98xx = data;
+
+	tfa98xx->irq_time = ktime_get();
+
+	return IRQ_WAKE_THREAD;
+}
+
 static void tfa98xx_irq_tfa2(struct tfa98xx *tfa98xx)
 {
-	/*
-	 * mask interrupts
-	 * will be unmasked after handling interrupts in workqueue
-	 */
-	tfa_irq_mask(tfa98xx->tfa);
-	queue_delayed_work(tfa98xx->tfa98xx_wq, &tfa98xx->interrupt_work, 0);
+	struct tfa_device *tfa = tfa98xx->tfa;
+	u16 status[TFA98XX_STATUS_FLAGS3 - TFA98XX_STATUS_FLAGS0 + 1];
+	unsigned int irqstatus;
+	int ret;
+
+	/* unmasked again once the status has been handled */
+	tfa_irq_mask(tfa);
+
+	/* all status flags in one transfer */
+	ret = regmap_bulk_read(tfa98xx->regmap, TFA98XX_STATUS_FLAGS0,
+		status, ARRAY_SIZE(status));
+	if (ret == 0)
+		ret = regmap_read(tfa98xx->regmap,
+			TFA98XX_INTERRUPT_OUT_REG, &irqstatus);
+	if (ret < 0) {
+		dev_err(tfa98xx->dev, "%s: status read failed: %d\n",
+			__func__, ret);
+		goto unmask;
+	}
+	pr_debug("%s: [%d] status_flags: 0x%04x, 0x%04x\n",
+		__func__, tfa->dev_idx, status[0], status[3]);
+
+	/* Remove sticky bit by writing flags */
+	tfa_clear_sticky_bits(tfa, status[0], status[3]);
+
+	mutex_lock(&tfa98xx->dsp_lock);
+	tfa_irq_report_status(tfa, (uint16_t)irqstatus);
+	mutex_unlock(&tfa98xx->dsp_lock);
+
+	/* the monitor checks the device at once for these */
+	if (irqstatus & tfa->interrupt_enable[0]
+		& (BIT(tfa9866_irq_stnoclk) | BIT(tfa9866_irq_stocpr)))
+		tfa98xx_monitor_kick(tfa98xx);
+
+unmask:
+	tfa_irq_unmask(tfa);
 }
 
 static irqreturn_t tfa98xx_irq(int irq, void *data)
 {
 	struct tfa98xx *tfa98xx = data;
+	struct tfa98xx *ntfa98xx;
+	struct tfa98xx_irq_stat *stat = &tfa98xx->irq_stat;
+	unsigned int latency;
 
-	if (tfa98xx->tfa->tfa_family == 2)
-		tfa98xx_irq_tfa2(tfa98xx);
+	/* a state change: wake up the waits, this device's at once */
+	tfa_wait_kick(tfa98xx->tfa);
+
+	/*
+	 * devices on the line may still be probing or going away; not
+	 * tfa98xx_mutex, which start and control paths hold for long
+	 */
+	mutex_lock(&tfa98xx_list_lock);
+
+	list_for_each_entry(ntfa98xx, &tfa98xx_device_list, list)
+		if (ntfa98xx != tfa98xx
+			&& ntfa98xx->irq_gpio == tfa98xx->irq_gpio)
+			tfa_wait_kick(ntfa98xx->tfa);
+
+	/* handle the status of each device on the line in place */
+	list_for_each_entry(ntfa98xx, &tfa98xx_device_list, list) {
+		if (ntfa98xx->irq_gpio != tfa98xx->irq_gpio)
+			continue;
+		if (ntfa98xx->tfa == NULL || ntfa98xx->tfa->tfa_family != 2)
+			continue;
+		tfa98xx_irq_tfa2(ntfa98xx);
+	}
+
+	mutex_unlock(&tfa98xx_list_lock);
+
+	latency = (unsigned int)ktime_us_delta(ktime_get(),
+		tfa98xx->irq_time);
+	stat->count++;
+	stat->last_us = latency;
+	stat->max_us = max(stat->max_us, latency);
+	stat->total_us += latency;
 
 	return IRQ_HANDLED;
 }
@@ -4623,6 +5967,7 @@ static int tfa98xx_ext_reset(struct tfa98xx *tfa98xx)
 static int tfa98xx_parse_dt(struct device *dev,
 	struct tfa98xx *tfa98xx, struct device_node *np)
 {
+	const char *name;
 	u32 value;
 	int ret;
 
@@ -4644,6 +5989,14 @@ static int tfa98xx_parse_dt(struct device *dev,
 
 	dev_info(dev, "reset-polarity:%d\n", tfa98xx->reset_polarity);
 
+	if (!of_property_read_string(np, "nxp,ref-temp-psy-name", &name)) {
+		if (tfa98xx_ref_temp_set_name(name))
+			dev_err(dev, "ref-temp-psy-name %s ignored, %s in use\n",
+				name, tfa98xx_ref_temp.name);
+		else
+			dev_info(dev, "ref-temp-psy-name:%s\n", name);
+	}
+
 	return 0;
 }
 
@@ -4731,6 +6084,234 @@ static int tfa98xx_parse_inchannel_dt(struct device *dev,
 }
 #endif
 
+/*
+ * Calibration store: Re25 and temperature of each amplifier, kept out of
+ * MTP and loaded once, so that a stream start sends them as they are.
+ * The blob is a header, the records and a CRC32 of both, little endian.
+ * Protected by tfa98xx_mutex.
+ */
+#define TFA_CAL_STORE_MAGIC	0x4c414354 /* "TCAL" */
+#define TFA_CAL_STORE_VERSION	1
+
+struct tfa_cal_store_hdr {
+	__le32 magic;
+	__le16 version;
+	__le16 count;
+} __packed;
+
+struct tfa_cal_store_rec {
+	u8 addr; /* I2C address of the amplifier */
+	u8 reserved[3];
+	__le32 re25; /* mOhm */
+	__le32 temp; /* degC */
+	__le32 stamp; /* when calibrated; 0 if not valid */
+} __packed;
+
+/* where the store comes from, selected with cal-store in DT */
+struct tfa98xx_cal_backend {
+	const char *name;
+	int (*load)(struct tfa98xx *tfa98xx); /* at probe; NULL if pushed */
+};
+
+static struct tfa_cal_store_rec tfa98xx_cal_recs[MAX_HANDLES];
+static int tfa98xx_cal_count = -1; /* not loaded yet */
+
+static int tfa98xx_cal_store_parse(const u8 *data, size_t size)
+{
+	const struct tfa_cal_store_hdr *hdr = (const void *)data;
+	size_t len;
+	__le32 crc;
+	int count;
+
+	if (size < sizeof(*hdr) + sizeof(crc)
+		|| le32_to_cpu(hdr->magic) != TFA_CAL_STORE_MAGIC
+		|| le16_to_cpu(hdr->version) != TFA_CAL_STORE_VERSION)
+		return -EINVAL;
+
+	count = le16_to_cpu(hdr->count);
+	len = sizeof(*hdr) + count * sizeof(struct tfa_cal_store_rec);
+	if (count > MAX_HANDLES || size != len + sizeof(crc))
+		return -EINVAL;
+
+	memcpy(&crc, data + len, sizeof(crc));
+	if (le32_to_cpu(crc) != ~crc32_le(~0u, data, len))
+		return -EBADMSG;
+
+	memcpy(tfa98xx_cal_recs, data + sizeof(*hdr),
+		count * sizeof(struct tfa_cal_store_rec));
+	tfa98xx_cal_count = count;
+
+	return 0;
+}
+
+/* take the record of the amplifier, or invalidate the one it has */
+static void tfa98xx_cal_store_apply(struct tfa98xx *tfa98xx)
+{
+	struct tfa_device *tfa = tfa98xx->tfa;
+	struct tfa_cal_entry entry = {0};
+	int i, re25;
+
+	for (i = 0; i < tfa98xx_cal_count; i++) {
+		if (tfa98xx_cal_recs[i].addr != tfa98xx->i2c->addr)
+			continue;
+
+		re25 = le32_to_cpu(tfa98xx_cal_recs[i].re25);
+		if (re25 <= tfa->lower_limit_cal
+			|| re25 >= tfa->upper_limit_cal) {
+			dev_err(tfa98xx->dev,
+				"stored calibration out of range: %d\n", re25);
+			break;
+		}
+		entry.re25 = re25;
+		entry.temp = le32_to_cpu(tfa98xx_cal_recs[i].temp);
+		entry.stamp = le32_to_cpu(tfa98xx_cal_recs[i].stamp);
+		break;
+	}
+
+	mutex_lock(&tfa98xx->dsp_lock);
+	tfa->cal_store = entry;
+	if (entry.stamp) {
+		tfa->mohm[0] = entry.re25;
+		tfa->temp = entry.temp;
+		tfa->mtpex = 1;
+	}
+	mutex_unlock(&tfa98xx->dsp_lock);
+
+	dev_info(tfa98xx->dev, "[0x%x] stored cal : %d (%s)\n",
+		tfa98xx->i2c->addr, entry.re25,
+		entry.stamp ? "valid" : "not valid");
+}
+
+static int tfa98xx_cal_store_fw_load(struct tfa98xx *tfa98xx)
+{
+	const struct firmware *fw;
+	int ret;
+
+	ret = request_firmware_direct(&fw, cal_name, tfa98xx->dev);
+	if (ret)
+		return ret;
+
+	ret = tfa98xx_cal_store_parse(fw->data, fw->size);
+	release_firmware(fw);
+
+	return ret;
+}
+
+static const struct tfa98xx_cal_backend tfa98xx_cal_backends[] = {
+	{ "firmware", tfa98xx_cal_store_fw_load },
+	{ "sysfs", NULL }, /* written to cal_store */
+};
+
+static void tfa98xx_cal_store_init(struct tfa98xx *tfa98xx,
+	struct device_node *np)
+{
+	const struct tfa98xx_cal_backend *backend = NULL;
+	const char *name;
+	int i, ret;
+
+	if (of_property_read_string(np, "cal-store", &name))
+		return;
+
+	for (i = 0; i < ARRAY_SIZE(tfa98xx_cal_backends); i++)
+		if (!strcmp(name, tfa98xx_cal_backends[i].name))
+			backend = &tfa98xx_cal_backends[i];
+	if (backend == NULL) {
+		dev_err(tfa98xx->dev, "unknown cal-store: %s\n", name);
+		return;
+	}
+
+	mutex_lock(&tfa98xx_mutex);
+	if (tfa98xx_cal_count < 0 && backend->load) {
+		/* once, by the first device to probe */
+		ret = backend->load(tfa98xx);
+		if (ret) {
+			dev_err(tfa98xx->dev,
+				"cannot load calibration store (%s): %d\n",
+				name, ret);
+			tfa98xx_cal_count = 0;
+		}
+	}
+	tfa98xx_cal_store_apply(tfa98xx);
+	mutex_unlock(&tfa98xx_mutex);
+}
+
+#if KERNEL_VERSION(6, 17, 0) <= LINUX_VERSION_CODE
+static ssize_t tfa98xx_bb_samples_read(struct file *filp, struct kobject *kobj,
+	const struct bin_attribute *bin_attr,
+	char *buf, loff_t off, size_t count)
+#else
+static ssize_t tfa98xx_bb_samples_read(struct file *filp, struct kobject *kobj,
+	struct bin_attribute *bin_attr,
+	char *buf, loff_t off, size_t count)
+#endif
+{
+	struct device *dev = container_of(kobj, struct device, kobj);
+	struct tfa98xx *tfa98xx = dev_get_drvdata(dev);
+	struct tfa98xx_bb_hdr *hdr;
+	struct tfa98xx_bb_sample *samples;
+	unsigned int n, first, i;
+	size_t size;
+	ssize_t ret;
+
+	size = sizeof(*hdr) + sizeof(*samples) * TFA98XX_BB_SAMPLES;
+	hdr = kzalloc(size, GFP_KERNEL);
+	if (hdr == NULL)
+		return -ENOMEM;
+	samples = (struct tfa98xx_bb_sample *)(hdr + 1);
+
+	/* a snapshot of the ring, oldest first */
+	mutex_lock(&tfa98xx_bb_lock);
+	n = min_t(unsigned int, tfa98xx->bb_head, TFA98XX_BB_SAMPLES);
+	first = tfa98xx->bb_head - n;
+	for (i = 0; i < n; i++)
+		samples[i] = tfa98xx->bb_ring[(first + i)
+			% TFA98XX_BB_SAMPLES];
+	mutex_unlock(&tfa98xx_bb_lock);
+
+	hdr->magic = TFA98XX_BB_MAGIC;
+	hdr->version = TFA98XX_BB_VERSION;
+	hdr->sample_size = sizeof(*samples);
+	hdr->count = n;
+	hdr->period_ms = max(READ_ONCE(blackbox_period_ms), 0);
+	size = sizeof(*hdr) + sizeof(*samples) * n;
+
+	ret = memory_read_from_buffer(buf, count, &off, hdr, size);
+	kfree(hdr);
+
+	return ret;
+}
+
+#if KERNEL_VERSION(6, 17, 0) <= LINUX_VERSION_CODE
+static ssize_t tfa98xx_cal_store_write(struct file *filp, struct kobject *kobj,
+	const struct bin_attribute *bin_attr,
+	char *buf, loff_t off, size_t count)
+#else
+static ssize_t tfa98xx_cal_store_write(struct file *filp, struct kobject *kobj,
+	struct bin_attribute *bin_attr,
+	char *buf, loff_t off, size_t count)
+#endif
+{
+	struct tfa98xx *tfa98xx;
+	int ret;
+
+	if (off != 0) /* in one write */
+		return -EINVAL;
+
+	mutex_lock(&tfa98xx_mutex);
+	ret = tfa98xx_cal_store_parse(buf, count);
+	if (ret == 0)
+		list_for_each_entry(tfa98xx, &tfa98xx_device_list, list)
+			tfa98xx_cal_store_apply(tfa98xx);
+	mutex_unlock(&tfa98xx_mutex);
+
+	if (ret) {
+		pr_err("%s: invalid calibration store: %d\n", __func__, ret);
+		return ret;
+	}
+
+	return count;
+}
+
 #if KERNEL_VERSION(6, 17, 0) <= LINUX_VERSION_CODE
 static ssize_t tfa98xx_reg_write(struct file *filp, struct kobject *kobj,
 	const struct bin_attribute *bin_attr,
@@ -4895,9 +6476,9 @@ static ssize_t tfa98xx_blackbox_show(struct device *dev,
 	struct tfa98xx *tfa98xx = dev_get_drvdata(dev);
 	int count = 0;
 	int idx, ndev, offset, addr;
-	enum tfa98xx_error err = TFA98XX_ERROR_OK;
 	struct tfa_device *tfa0 = NULL;
 	struct tfa_device *ntfa = NULL;
+	struct tfa98xx *tfa98xx0;
 
 	if (tfa98xx->tfa->tfa_family == 0) {
 		pr_err("[0x%x] %s: system is not initialized: not probed yet!\n",
@@ -4913,8 +6494,16 @@ static ssize_t tfa98xx_blackbox_show(struct device *dev,
 	tfa0 = tfa98xx_get_tfa_device_from_index(-1);
 
 	/* update current session if it's active */
-	if (tfa98xx_count_active_stream(BIT_PSTREAM) > 0)
-		err = tfa_update_log();
+	if (tfa0 != NULL && tfa0->data != NULL
+		&& tfa98xx_count_active_stream(BIT_PSTREAM) > 0) {
+		tfa98xx0 = (struct tfa98xx *)tfa0->data;
+		mutex_lock(&tfa98xx_mutex);
+		mutex_lock(&tfa98xx0->dsp_lock);
+		tfa98xx_telemetry_get(tfa0, TFA_TELEMETRY_LOG,
+			telemetry_max_age_ms, NULL);
+		mutex_unlock(&tfa98xx0->dsp_lock);
+		mutex_unlock(&tfa98xx_mutex);
+	}
 
 	pr_info("blackbox state: %d\n",
 		tfa0->blackbox_enable);
@@ -5328,6 +6917,17 @@ static ssize_t tfa98xx_intr_store(struct device *dev,
 	return count;
 }
 
+static ssize_t tfa98xx_irq_counts_show(struct device *dev,
+	struct device_attribute *attr, char *buf)
+{
+	struct tfa98xx *tfa98xx = dev_get_drvdata(dev);
+
+	if (tfa98xx->tfa == NULL)
+		return -ENODEV;
+
+	return tfa98xx_irq_stat_print(tfa98xx->tfa, buf, PAGE_SIZE);
+}
+
 static ssize_t tfa98xx_overlay_show(struct device *dev,
 	struct device_attribute *attr, char *buf)
 {
@@ -5408,6 +7008,26 @@ static struct bin_attribute dev_attr_reg = {
 	.write = tfa98xx_reg_write,
 };
 
+static struct bin_attribute dev_attr_bb_samples = {
+	.attr = {
+		.name = "blackbox_samples",
+		.mode = 0400,
+	},
+	.size = 0,
+	.read = tfa98xx_bb_samples_read,
+	.write = NULL,
+};
+
+static struct bin_attribute dev_attr_cal_store = {
+	.attr = {
+		.name = "cal_store",
+		.mode = 0200,
+	},
+	.size = 0,
+	.read = NULL,
+	.write = tfa98xx_cal_store_write,
+};
+
 static struct bin_attribute dev_attr_customer = {
 	.attr = {
 		.name = "customer",
@@ -5472,6 +7092,14 @@ static struct device_attribute dev_attr_intr = {
 	.store = tfa98xx_intr_store,
 };
 
+static struct device_attribute dev_attr_irq_counts = {
+	.attr = {
+		.name = "irq_counts",
+		.mode = 0400,
+	},
+	.show = tfa98xx_irq_counts_show,
+};
+
 static struct device_attribute dev_attr_overlay = {
 	.attr = {
 		.name = "overlay",
@@ -5750,6 +7378,112 @@ enum tfa98xx_error tfa_get_cal_temp_channel(int channel, uint16_t *value)
 }
 EXPORT_SYMBOL(tfa_get_cal_temp_channel);
 
+/* one calibration job at a time, run by tfa_cal_job_work */
+static DEFINE_MUTEX(tfa_cal_job_lock);
+static struct tfa_cal_job tfa_cal_job;
+static tfa_cal_job_done_t tfa_cal_job_done;
+static void *tfa_cal_job_data;
+static ktime_t tfa_cal_job_time;
+static void tfa_cal_job_fn(struct work_struct *work);
+static DECLARE_WORK(tfa_cal_job_work, tfa_cal_job_fn);
+
+static void tfa_cal_job_fn(struct work_struct *work)
+{
+	struct tfa_cal_result result[MAX_HANDLES];
+	struct tfa_cal_job job;
+	struct tfa_device *tfa;
+	tfa_cal_job_done_t done;
+	void *data;
+	uint16_t value;
+	int idx, index, ndev = 0;
+	int err;
+
+	mutex_lock(&tfa_cal_job_lock);
+	index = tfa_cal_job.index;
+	mutex_unlock(&tfa_cal_job_lock);
+
+	/* the requested channels are calibrated together */
+	err = tfa_run_cal(index, &value);
+
+	/* then the results of all devices are read in one pass */
+	memset(result, 0, sizeof(result));
+	tfa = tfa98xx_get_tfa_device_from_index(0);
+	if (tfa != NULL)
+		ndev = min(tfa->dev_count, MAX_HANDLES);
+	for (idx = 0; idx < ndev; idx++) {
+		if (idx == 0 && index == SPK_CH) /* only SPK cal */
+			continue;
+		if (idx == 1 && index == RCV_CH) /* only RCV cal */
+			continue;
+
+		result[idx].calibrated = 1;
+		result[idx].err = tfa_get_cal_data(idx, &result[idx].rdc);
+		if (result[idx].err == TFA98XX_ERROR_OK)
+			result[idx].err
+				= tfa_get_cal_temp(idx, &result[idx].temp);
+		pr_info("%s: dev %d - calibration data (%d, %d), err %d\n",
+			__func__, idx, result[idx].rdc, result[idx].temp,
+			result[idx].err);
+	}
+
+	mutex_lock(&tfa_cal_job_lock);
+	memcpy(tfa_cal_job.result, result, sizeof(result));
+	tfa_cal_job.err = err;
+	tfa_cal_job.duration_ms
+		= (unsigned int)ktime_ms_delta(ktime_get(), tfa_cal_job_time);
+	tfa_cal_job.state = TFA_CAL_JOB_DONE;
+	job = tfa_cal_job;
+	done = tfa_cal_job_done;
+	data = tfa_cal_job_data;
+	mutex_unlock(&tfa_cal_job_lock);
+
+	pr_info("%s: calibration (%d) ended in %u ms, err %d\n",
+		__func__, index, job.duration_ms, err);
+
+	if (done)
+		done(&job, data);
+}
+
+int tfa_cal_job_start(int index, tfa_cal_job_done_t done, void *data)
+{
+	if (index != ALL_CH && index != RCV_CH && index != SPK_CH)
+		return -EINVAL;
+
+	mutex_lock(&tfa_cal_job_lock);
+	if (tfa_cal_job.state == TFA_CAL_JOB_RUNNING) {
+		mutex_unlock(&tfa_cal_job_lock);
+		return -EBUSY;
+	}
+	memset(&tfa_cal_job, 0, sizeof(tfa_cal_job));
+	tfa_cal_job.state = TFA_CAL_JOB_RUNNING;
+	tfa_cal_job.index = index;
+	tfa_cal_job_done = done;
+	tfa_cal_job_data = data;
+	tfa_cal_job_time = ktime_get();
+	mutex_unlock(&tfa_cal_job_lock);
+
+	queue_work(system_long_wq, &tfa_cal_job_work);
+
+	return 0;
+}
+EXPORT_SYMBOL(tfa_cal_job_start);
+
+int tfa_cal_job_get(struct tfa_cal_job *job)
+{
+	mutex_lock(&tfa_cal_job_lock);
+	*job = tfa_cal_job;
+	mutex_unlock(&tfa_cal_job_lock);
+
+	return job->state;
+}
+EXPORT_SYMBOL(tfa_cal_job_get);
+
+void tfa_cal_job_flush(void)
+{
+	flush_work(&tfa_cal_job_work);
+}
+EXPORT_SYMBOL(tfa_cal_job_flush);
+
 int tfa98xx_set_blackbox(int enable)
 {
 	enum tfa98xx_error ret = TFA98XX_ERROR_OK;
@@ -5900,6 +7634,7 @@ int tfa98xx_update_spkt_data(int idx)
 {
 	struct tfa_device *tfa = tfa98xx_get_tfa_device_from_index(0);
 	struct tfa98xx *tfa98xx;
+	struct tfa_telemetry telemetry;
 	int ret = 0;
 	int value[MAX_HANDLES] = {0};
 	int i, ndev, data = 0;
@@ -5916,7 +7651,7 @@ int tfa98xx_update_spkt_data(int idx)
 		if (tfa->active_handle & (1 << active_dev))
 			break;
 	}
-	pr_info("%s: switched to active handle - %d, active_dev - %d\n",
+	pr_debug("%s: switched to active handle - %d, active_dev - %d\n",
 		__func__, tfa->active_handle, active_dev);
 
 	if (active_dev == MAX_HANDLES)
@@ -5937,52 +7672,55 @@ int tfa98xx_update_spkt_data(int idx)
 		return DEFAULT_REF_TEMP;
 
 	if (tfa98xx_count_active_stream(BIT_PSTREAM) == 0) {
-		pr_info("%s: skipped - no active stream!\n",
+		pr_debug("%s: skipped - no active stream!\n",
 			__func__);
 		return DEFAULT_REF_TEMP;
 	}
 
 	if (tfa->is_bypass) {
-		pr_info("%s: skipped - tfadsp in bypass\n",
+		pr_debug("%s: skipped - tfadsp in bypass\n",
 			__func__);
 		return DEFAULT_REF_TEMP;
 	}
 
 	if (tfa->is_calibrating) {
-		pr_info("%s: skipped - tfadsp is running calibraion!\n",
+		pr_debug("%s: skipped - tfadsp is running calibraion!\n",
 			__func__);
 		return DEFAULT_REF_TEMP;
 	}
 
 	pm = tfa_get_power_state(idx);
 	// 0:normal, 1:low power mode, 2:idle power mode
-	pr_info("%s: tfa_stc - dev %d - power state 0x%x\n",
+	pr_debug("%s: tfa_stc - dev %d - power state 0x%x\n",
 		__func__, idx, pm);
 
 	if (pm > 1) /* reset temperature in idle power state */
 		return DEFAULT_REF_TEMP;
 
 	if (tfa->is_configured <= 0) {
-		pr_info("%s: skipped - tfadsp is not active\n",
+		pr_debug("%s: skipped - tfadsp is not active\n",
 			__func__);
 		return DEFAULT_REF_TEMP;
 	}
 
-	pr_info("%s: tfa_stc - read tspkr for stc\n",
+	pr_debug("%s: tfa_stc - read tspkr for stc\n",
 		__func__);
 
 	tfa98xx = (struct tfa98xx *)tfa->data;
 
 	mutex_lock(&tfa98xx->dsp_lock);
-	ret = tfa_read_tspkr(tfa, value);
+	tfa98xx_telemetry_get(tfa, TFA_TELEMETRY_TSPKR,
+		telemetry_max_age_ms, &telemetry);
 	mutex_unlock(&tfa98xx->dsp_lock);
+	ret = telemetry.err_tspkr;
+	memcpy(value, telemetry.spkt, sizeof(value));
 	if (ret) {
-		pr_info("%s: tfa_stc failed to read data from amplifier\n",
+		pr_err("%s: tfa_stc failed to read data from amplifier\n",
 			__func__);
 		value[idx] = DEFAULT_REF_TEMP;
 	}
 	if (value[idx] == 0xffff) {
-		pr_info("%s: tfa_stc read wrong data from amplifier\n",
+		pr_err("%s: tfa_stc read wrong data from amplifier\n",
 			__func__);
 	}
 	data = value[idx];
@@ -6151,6 +7889,26 @@ int tfa98xx_write_sknt_control_channel(int channel, int value)
 }
 EXPORT_SYMBOL(tfa98xx_write_sknt_control_channel);
 
+/*
+ * Head device: the one at the lowest bus and address, so that it does not
+ * depend on which amplifier finishes its asynchronous probe first.
+ * Called with tfa98xx_mutex held.
+ */
+static void tfa98xx_set_head_device(void)
+{
+	struct tfa98xx *tfa98xx, *head = NULL;
+
+	list_for_each_entry(tfa98xx, &tfa98xx_device_list, list) {
+		if (head == NULL
+			|| tfa98xx->i2c->adapter->nr < head->i2c->adapter->nr
+			|| (tfa98xx->i2c->adapter->nr == head->i2c->adapter->nr
+			&& tfa98xx->i2c->addr < head->i2c->addr))
+			head = tfa98xx;
+	}
+
+	tfa98xx_head_device = head;
+}
+
 #if KERNEL_VERSION(6, 6, 0) <= LINUX_VERSION_CODE
 static int tfa98xx_i2c_probe(struct i2c_client *i2c)
 #else
@@ -6222,6 +7980,9 @@ static int tfa98xx_i2c_probe(struct i2c_client *i2c,
 
 	i2c_set_clientdata(i2c, tfa98xx);
 	mutex_init(&tfa98xx->dsp_lock);
+	mutex_init(&tfa98xx->init_lock);
+	init_completion(&tfa98xx->init_done);
+	atomic_set(&tfa98xx->init_pending, 1); /* held by tfa98xx_init_work */
 	init_waitqueue_head(&tfa98xx->wq);
 
 	if (np) {
@@ -6308,6 +8069,10 @@ retry:
 
 	tfa98xx->tfa->data = (void *)tfa98xx;
 	tfa98xx->tfa->cachep = tfa98xx_cache;
+	init_completion(&tfa98xx->tfa->wait_event);
+	init_completion(&tfa98xx->tfa->ramp.done);
+	tfa98xx->tfa->ramp_curve = (ramp_curve == TFA_RAMP_LINEAR
+		|| ramp_curve == TFA_RAMP_EXP) ? ramp_curve : TFA_RAMP_DB;
 	mutex_unlock(&tfa98xx_mutex);
 
 	if (ret == 0) {
@@ -6337,6 +8102,7 @@ retry:
 		}
 		tfa98xx->tfa->mtpex = 1; // mtpex is 1 even in case the dummy cal is used
 		dev_info(&i2c->dev, "[0x%x] cal : %d\n", i2c->addr, tfa98xx->tfa->mohm[0]);
+		tfa98xx_cal_store_init(tfa98xx, np);
 #if 0 /* inchannel config was moved to tfa98xx_container_loaded after tfa98xx_tfa_start (with TDMSPKS) */
 		ret = tfa98xx_parse_inchannel_dt(&i2c->dev, tfa98xx, np);
 		if (ret) {
@@ -6384,13 +8150,15 @@ retry:
 		dev_err(&i2c->dev, "[0x%x] DAI init failed %d\n", i2c->addr, ret);
 	}
 
+	/* devices probe in parallel: first one with a GPIO owns the IRQ */
+	mutex_lock(&tfa98xx_mutex);
 	if (gpio_is_valid(tfa98xx->irq_gpio) &&
 		!(tfa98xx->flags & TFA98XX_FLAG_SKIP_INTERRUPTS)) {
 		/* register irq handler */
 		irq_flags = IRQF_TRIGGER_FALLING | IRQF_ONESHOT;
 		ret = devm_request_threaded_irq(&i2c->dev,
 			gpio_to_irq((unsigned int)tfa98xx->irq_gpio),
-			NULL, tfa98xx_irq, irq_flags,
+			tfa98xx_irq_hard, tfa98xx_irq, irq_flags,
 			"tfa98xx", tfa98xx);
 		if (ret != 0) {
 			dev_err(&i2c->dev, "Failed to request IRQ %d: %d\n",
@@ -6410,6 +8178,9 @@ retry:
 			tfa98xx->flags |= TFA98XX_FLAG_SKIP_INTERRUPTS;
 		}
 	}
+	/* let the interrupt end the waits for the device early */
+	tfa98xx->tfa->wait_irq = gpio_is_valid(tfa98xx->irq_gpio);
+	mutex_unlock(&tfa98xx_mutex);
 
 #if defined(CONFIG_DEBUG_FS)
 	if (no_start == 0)
@@ -6425,6 +8196,12 @@ retry:
 	ret = sysfs_create_bin_file(&i2c->dev.kobj, &dev_attr_customer);
 	if (ret)
 		dev_info(&i2c->dev, "error creating sysfs node, customer\n");
+	ret = sysfs_create_bin_file(&i2c->dev.kobj, &dev_attr_cal_store);
+	if (ret)
+		dev_info(&i2c->dev, "error creating sysfs node, cal_store\n");
+	ret = sysfs_create_bin_file(&i2c->dev.kobj, &dev_attr_bb_samples);
+	if (ret)
+		dev_info(&i2c->dev, "error creating sysfs node, blackbox_samples\n");
 
 	ret = device_create_file(&i2c->dev, &dev_attr_blackbox);
 	if (ret)
@@ -6450,21 +8227,28 @@ retry:
 	if (ret)
 		dev_info(&i2c->dev, "error creating sysfs node, intr\n");
 
+	ret = device_create_file(&i2c->dev, &dev_attr_irq_counts);
+	if (ret)
+		dev_info(&i2c->dev, "error creating sysfs node, irq_counts\n");
+
 	ret = device_create_file(&i2c->dev, &dev_attr_overlay);
 	if (ret)
 		dev_info(&i2c->dev, "error creating sysfs node, overlay\n");
 
+	if (np)
+		tfa98xx_thermal_init(tfa98xx, &i2c->dev, np);
+
 	pr_info("%s Probe completed successfully!\n", __func__);
 
 	INIT_LIST_HEAD(&tfa98xx->list);
 
 	mutex_lock(&tfa98xx_mutex);
-	/* set tfa98xx head device */
-	if (tfa98xx_device_count == 0)
-		tfa98xx_head_device = tfa98xx;
-
 	tfa98xx_device_count++;
+	mutex_lock(&tfa98xx_list_lock);
 	list_add(&tfa98xx->list, &tfa98xx_device_list); /* stack */
+	mutex_unlock(&tfa98xx_list_lock);
+	/* set tfa98xx head device */
+	tfa98xx_set_head_device();
 	mutex_unlock(&tfa98xx_mutex);
 
 	return 0;
@@ -6572,13 +8356,21 @@ static int tfa98xx_i2c_remove(struct i2c_client *i2c)
 #endif
 
 	tfa98xx_interrupt_enable(tfa98xx, false);
+	tfa98xx_thermal_exit(tfa98xx, &i2c->dev);
 
-	cancel_delayed_work_sync(&tfa98xx->interrupt_work);
+	cancel_delayed_work_sync(&tfa98xx_group_work);
+	cancel_delayed_work_sync(&tfa98xx_bb_work);
+	cancel_delayed_work_sync(&tfa98xx_spkt_work);
+	flush_work(&tfa_cal_job_work);
 	cancel_delayed_work_sync(&tfa98xx->monitor_work);
+	if (tfa98xx->tfa != NULL)
+		tfa_gain_ramp_cancel(tfa98xx->tfa);
 
 	sysfs_remove_bin_file(&i2c->dev.kobj, &dev_attr_reg);
 	sysfs_remove_bin_file(&i2c->dev.kobj, &dev_attr_rw);
 	sysfs_remove_bin_file(&i2c->dev.kobj, &dev_attr_customer);
+	sysfs_remove_bin_file(&i2c->dev.kobj, &dev_attr_cal_store);
+	sysfs_remove_bin_file(&i2c->dev.kobj, &dev_attr_bb_samples);
 #if defined(CONFIG_DEBUG_FS)
 	tfa98xx_debug_remove(tfa98xx);
 #endif
@@ -6591,14 +8383,15 @@ static int tfa98xx_i2c_remove(struct i2c_client *i2c)
 		gpio_free((unsigned int)tfa98xx->reset_gpio);
 
 	mutex_lock(&tfa98xx_mutex);
+	mutex_lock(&tfa98xx_list_lock);
 	list_del(&tfa98xx->list);
+	mutex_unlock(&tfa98xx_list_lock);
 	tfa98xx_device_count--;
-	if (tfa98xx_device_count == 0) {
-		mutex_lock(&cnt_lock);
-		kfree(tfa98xx_container);
-		tfa98xx_container = NULL;
-		mutex_unlock(&cnt_lock);
-	}
+	tfa98xx_set_head_device();
+	tfa_cont_image_put(tfa98xx->cnt_img);
+	tfa98xx->cnt_img = NULL;
+	if (tfa98xx_device_count == 0)
+		tfa_cont_image_publish(NULL);
 
 	if (tfa98xx) {
 		if (tfa98xx->tfa)
@@ -6633,6 +8426,7 @@ static struct i2c_driver tfa98xx_i2c_driver = {
 		.name = "tfa98xx",
 		.owner = THIS_MODULE,
 		.of_match_table = of_match_ptr(tfa98xx_dt_match),
+		.probe_type = PROBE_PREFER_ASYNCHRONOUS,
 	},
 	.probe = tfa98xx_i2c_probe,
 	.remove = tfa98xx_i2c_remove,
@@ -6669,7 +8463,15 @@ static int __init tfa98xx_i2c_init(void)
 		ret = -ENOMEM;
 	}
 
+	ret = power_supply_reg_notifier(&tfa98xx_ref_temp_nb);
+	if (ret)
+		pr_err("tfa98xx can't follow the reference temperature\n");
+	else /* look up the supply ahead of the first start */
+		schedule_work(&tfa98xx_ref_temp_work);
+
 	ret = i2c_add_driver(&tfa98xx_i2c_driver);
+	if (ret)
+		tfa98xx_ref_temp_exit();
 
 	return ret;
 }
@@ -6678,6 +8480,9 @@ module_init(tfa98xx_i2c_init);
 static void __exit tfa98xx_i2c_exit(void)
 {
 	i2c_del_driver(&tfa98xx_i2c_driver);
+	tfa98xx_ref_temp_exit();
+	/* wait for container images released via RCU */
+	rcu_barrier();
 	kmem_cache_destroy(tfa98xx_cache);
 }
 module_exit(tfa98xx_i2c_exit);
@@ -47,6 +47,14 @@ static ssize_t status_store(struct device *dev,
 	struct device_attribute *attr, const char *buf, size_t size);
 static DEVICE_ATTR_RW(status);
 
+static ssize_t start_store(struct device *dev,
+	struct device_attribute *attr, const char *buf, size_t size);
+static DEVICE_ATTR_WO(start);
+
+static ssize_t result_show(struct device *dev,
+	struct device_attribute *attr, char *buf);
+static DEVICE_ATTR_RO(result);
+
 static ssize_t ref_temp_show(struct device *dev,
 	struct device_attribute *attr, char *buf);
 static ssize_t ref_temp_store(struct device *dev,
@@ -75,6 +83,8 @@ static struct attribute *tfa_cal_attr[] = {
 	&dev_attr_temp_r.attr,
 #endif /* TFA_STEREO_NODE */
 	&dev_attr_status.attr,
+	&dev_attr_start.attr,
+	&dev_attr_result.attr,
 	&dev_attr_ref_temp.attr,
 #if defined(TFA_PLATFORM_QUALCOMM)
 	&dev_attr_config.attr,
@@ -97,6 +107,88 @@ struct tfa_cal {
 static struct device *tfa_cal_dev;
 static int cur_status;
 static struct tfa_cal cal_data[MAX_HANDLES];
+static DECLARE_COMPLETION(cal_job_end);
+/* cur_status, cal_data and cal_job_end, against the end of the job */
+static DEFINE_MUTEX(cal_job_lock);
+
+/* ---------------------------------------------------------------------- */
+
+/* a calibration job has ended: keep its data and wake up pollers */
+static void tfa_cal_job_end(const struct tfa_cal_job *job, void *data)
+{
+	struct tfa_cal_job cur;
+	int idx;
+
+	mutex_lock(&cal_job_lock);
+	/* a job started since this one ended owns the state now */
+	if (tfa_cal_job_get(&cur) == TFA_CAL_JOB_RUNNING) {
+		mutex_unlock(&cal_job_lock);
+		return;
+	}
+
+	for (idx = 0; idx < MAX_HANDLES; idx++) {
+		if (!job->result[idx].calibrated
+			|| job->result[idx].err != TFA98XX_ERROR_OK)
+			continue;
+		cal_data[idx].rdc = job->result[idx].rdc;
+		cal_data[idx].temp = job->result[idx].temp;
+	}
+
+	/* stays active at failure */
+	if (job->err == TFA98XX_ERROR_OK)
+		cur_status = 0; /* done - changed to inactive */
+
+	complete_all(&cal_job_end);
+	mutex_unlock(&cal_job_lock);
+
+	if (!IS_ERR_OR_NULL(tfa_cal_dev)) {
+		sysfs_notify(&tfa_cal_dev->kobj, NULL,
+			dev_attr_status.attr.name);
+		sysfs_notify(&tfa_cal_dev->kobj, NULL,
+			dev_attr_result.attr.name);
+	}
+}
+
+static int tfa_cal_start(const char *buf)
+{
+	int ret, status;
+
+	/* Compare string, excluding the trailing \0 and the potentials eol */
+	if (!sysfs_streq(buf, "1") && !sysfs_streq(buf, "0")
+		&& !sysfs_streq(buf, "2") && !sysfs_streq(buf, "3")) {
+		pr_info("%s: tfa_cal invalid value to start calibration\n",
+			__func__);
+		return -EINVAL;
+	}
+
+	/* status: 1=all, 2=top, 3=bottom */
+	ret = kstrtou32(buf, 10, &status);
+	if (!status) {
+		pr_info("%s: do nothing\n", __func__);
+		return -EINVAL;
+	}
+
+	/* the job ends no earlier than the state is set, under the lock */
+	mutex_lock(&cal_job_lock);
+	ret = tfa_cal_job_start(status, tfa_cal_job_end, NULL);
+	if (ret) {
+		mutex_unlock(&cal_job_lock);
+		pr_err("%s: tfa_cal failed to start calibration, %d\n",
+			__func__, ret);
+		return ret;
+	}
+
+	if (cur_status)
+		pr_info("%s: tfa_cal prior calibration failed\n", __func__);
+	pr_info("%s: tfa_cal begin, status=%d\n", __func__, status);
+
+	cur_status = status; /* run - changed to active */
+	memset(cal_data, 0, sizeof(struct tfa_cal) * MAX_HANDLES);
+	reinit_completion(&cal_job_end);
+	mutex_unlock(&cal_job_lock);
+
+	return 0;
+}
 
 /* ---------------------------------------------------------------------- */
 
@@ -348,92 +440,89 @@ static ssize_t status_show(struct device *dev,
 static ssize_t status_store(struct device *dev,
 	struct device_attribute *attr, const char *buf, size_t size)
 {
-	struct tfa_device *tfa = NULL;
-	int idx, ndev = MAX_HANDLES;
-	uint16_t value;
-	int ret = 0, status;
+	struct tfa_cal_job job;
+	struct tfa_cal_result *result;
+	int idx, ret;
 
-	/* Compare string, excluding the trailing \0 and the potentials eol */
-	if (!sysfs_streq(buf, "1") && !sysfs_streq(buf, "0")
-		&& !sysfs_streq(buf, "2") && !sysfs_streq(buf, "3")) {
-		pr_info("%s: tfa_cal invalid value to start calibration\n",
-			__func__);
-		return -EINVAL;
-	}
-
-	/* status: 1=all, 2=top, 3=bottom */
-	ret = kstrtou32(buf, 10, &status);
-	if (!status) {
-		pr_info("%s: do nothing\n", __func__);
-		return -EINVAL;
-	}
-	if (cur_status)
-		pr_info("%s: tfa_cal prior calibration still runs or failed\n", __func__);
-
-	pr_info("%s: tfa_cal begin, status=%d\n", __func__, status);
-
-	cur_status = status; /* run - changed to active */
+	ret = tfa_cal_start(buf);
+	if (ret)
+		return ret;
 
-	memset(cal_data, 0, sizeof(struct tfa_cal) * MAX_HANDLES);
+	/*
+	 * wait for the job, as the calibration used to run here; a restarted
+	 * write would only find it busy, so only a fatal signal ends the wait
+	 */
+	ret = wait_for_completion_killable(&cal_job_end);
+	if (ret)
+		return ret;
 
-	/* run calibration */
-	ret = tfa_run_cal(status, &value);
-	if (ret) {
-		pr_err("%s: tfa_cal failed to calibrate speaker, %d\n", __func__, ret);
+	tfa_cal_job_get(&job);
+	if (job.err) {
+		pr_err("%s: tfa_cal failed to calibrate speaker, %d\n",
+			__func__, job.err);
 		return -EINVAL;
 	}
 
-	cur_status = 0; /* done - changed to inactive */
-
-	tfa = tfa98xx_get_tfa_device_from_index(0);
-	if (tfa == NULL)
-		return -EINVAL; /* unused device */
-
-	ndev = tfa->dev_count;
-	if (ndev < 1)
-		return -EINVAL;
-
-	for (idx = 0; idx < ndev; idx++) {
-		if (idx == 0 && status == SPK_CH) /* only SPK cal */
-			continue;
-		if (idx == 1 && status == RCV_CH) /* only RCV cal */
+	for (idx = 0; idx < MAX_HANDLES; idx++) {
+		result = &job.result[idx];
+		if (!result->calibrated)
 			continue;
 
-		/* read data to store */
-		ret = tfa_get_cal_data(idx, &value);
-		if (ret) {
+		if (result->err) {
 			pr_info("%s: tfa_cal failed to read data after calibration\n",
 				__func__);
 			continue;
 		}
 
-		if (value == 0xffff) {
+		if (result->rdc == 0xffff || result->temp == 0xffff) {
 			pr_info("%s: tfa_cal invalid data\n", __func__);
 			return -EINVAL;
 		}
+	}
 
-		cal_data[idx].rdc = value;
+	pr_info("%s: tfa_cal end\n", __func__);
 
-		/* read temp to store */
-		ret = tfa_get_cal_temp(idx, &value);
-		if (ret) {
-			pr_info("%s: tfa_cal failed to read temp after calibration\n",
-				__func__);
-			continue;
-		}
+	return size;
+}
 
-		if (value == 0xffff) {
-			pr_info("%s: tfa_cal invalid data\n", __func__);
-			return -EINVAL;
-		}
+/* start calibration as status does, without waiting for it */
+static ssize_t start_store(struct device *dev,
+	struct device_attribute *attr, const char *buf, size_t size)
+{
+	int ret;
 
-		cal_data[idx].temp = value;
+	ret = tfa_cal_start(buf);
+	if (ret)
+		return ret;
 
-		pr_info("%s: tfa_cal - dev %d - calibration data (%d, %d)\n",
-			__func__, idx, cal_data[idx].rdc, cal_data[idx].temp);
-	}
+	return size;
+}
 
-	pr_info("%s: tfa_cal end\n", __func__);
+static ssize_t result_show(struct device *dev,
+	struct device_attribute *attr, char *buf)
+{
+	static const char * const state[] = {"idle", "running", "done"};
+	struct tfa_cal_job job;
+	struct tfa_cal_result *result;
+	ssize_t size;
+	int idx;
+
+	tfa_cal_job_get(&job);
+	size = scnprintf(buf, PAGE_SIZE, "%s %d %u\n",
+		(job.state == TFA_CAL_JOB_DONE && job.err)
+		? "failed" : state[job.state],
+		job.err, job.duration_ms);
+	if (job.state != TFA_CAL_JOB_DONE)
+		return size;
+
+	for (idx = 0; idx < MAX_HANDLES; idx++) {
+		result = &job.result[idx];
+		if (!result->calibrated)
+			continue;
+		size += scnprintf(buf + size, PAGE_SIZE - size,
+			"%d %d %d %d\n", idx,
+			result->rdc, result->temp, result->err);
+	}
 
 	return size;
 }
@@ -635,6 +724,8 @@ int tfa98xx_cal_init(struct class *tfa_class)
 
 void tfa98xx_cal_exit(struct class *tfa_class)
 {
+	/* done is called back into this module */
+	tfa_cal_job_flush();
 	device_destroy(tfa_class, DEV_ID_TFA_CAL);
 	pr_info("exited\n");
 }
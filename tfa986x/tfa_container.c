@@ -19,17 +19,65 @@
 
 #define TSEL_OFFSET	(1 * 3)
 #define TEMP_OFFSET	((1 + 2) * 3)
-static void tfa_overwrite_temp(struct tfa_device *tfa, char *data_buf);
+
+/* container CRC is computed in chunks on the unbound workqueue */
+#define TFA_CONT_CRC_CHUNK	(32 * 1024)
+#define TFA_CONT_CRC_JOBS	(TFA_MAX_CNT_LENGTH / TFA_CONT_CRC_CHUNK + 1)
+static char *tfa_overwrite_temp(struct tfa_device *tfa,
+	const char *msg, int size);
 
 /* module globals */
 static uint8_t gresp_address; /* in case of setting with option */
 
 extern struct mutex cnt_lock;
 
+struct tfa_cont_image;
+
+struct tfa_cont_crc_job {
+	struct work_struct work;
+	struct tfa_cont_image *img;
+	const uint8_t *base;
+	size_t size;
+	uint32_t crc;
+};
+
 /*
- * check the container file
+ * container image: a validated container with its prebuilt lookup indices.
+ * Images are immutable once built; the active one is published through RCU,
+ * devices hold a reference to the image they are configured from.
  */
-enum tfa_error tfa_load_cnt(void *cnt, int length)
+struct tfa_cont_image {
+	struct kref ref;
+	struct rcu_head rcu;
+	void *buf; /* file contents, legacy or compiled */
+	int buf_size;
+	struct tfa_container *cnt; /* legacy container, in buf */
+	int size;
+	int validated;
+	/* chunked CRC, pending until tfa_cont_image_validate() */
+	uint32_t crc;
+	int crc_jobs;
+	atomic_t crc_pending;
+	struct completion crc_done;
+	struct tfa_cont_crc_job crc_job[TFA_CONT_CRC_JOBS];
+	struct tfa_device_list *dev_list[TFACONT_MAXDEVS];
+	int nprof[TFACONT_MAXDEVS];
+	struct tfa_profile_list *prof_list[TFACONT_MAXDEVS][TFACONT_MAXPROFS];
+	/* compiled container sections, NULL for legacy */
+	const struct tfa_cont2_header *hdr2;
+	const struct tfa_cont2_dev *dev2;
+	const struct tfa_cont2_prof *prof2;
+	int nprof2;
+	const struct tfa_cont2_reg *reg2;
+	int nreg2;
+};
+
+static struct tfa_cont_image __rcu *tfa_cont_active;
+
+/*
+ * check the container header, everything except the CRC
+ */
+static enum tfa_error tfa_cont_check_header(void *cnt, int length)
 {
 	struct tfa_container *cntbuf = (struct tfa_container *)cnt;
 
@@ -57,9 +105,10 @@ enum tfa_error tfa_load_cnt(void *cnt, int length)
 		return tfa_error_container;
 	}
 
-	/* check CRC */
-	if (tfa_cont_crc_check_container(cntbuf)) {
-		pr_err("CRC error\n");
+	if (cntbuf->size > length
+		|| cntbuf->size < offsetof(struct tfa_container, rev)) {
+		pr_err("data size does not match length: %d, %d\n",
+			cntbuf->size, length);
 		return tfa_error_container;
 	}
 
@@ -74,6 +123,691 @@ enum tfa_error tfa_load_cnt(void *cnt, int length)
 	return tfa_error_ok;
 }
 
+/*
+ * check the container file
+ */
+enum tfa_error tfa_load_cnt(void *cnt, int length)
+{
+	enum tfa_error err;
+
+	if (length < (int)sizeof(struct tfa_container))
+		return tfa_error_container;
+
+	err = tfa_cont_check_header(cnt, length);
+	if (err != tfa_error_ok)
+		return err;
+
+	/* check CRC */
+	if (tfa_cont_crc_check_container((struct tfa_container *)cnt)) {
+		pr_err("CRC error\n");
+		return tfa_error_container;
+	}
+
+	return tfa_error_ok;
+}
+
+/*
+ * combine two CRC32 values, crc2 being of the len2 bytes following crc1
+ * (GF(2) matrix method, as in zlib crc32_combine)
+ */
+static uint32_t tfa_gf2_matrix_times(const uint32_t *mat, uint32_t vec)
+{
+	uint32_t sum = 0;
+
+	while (vec) {
+		if (vec & 1)
+			sum ^= *mat;
+		vec >>= 1;
+		mat++;
+	}
+
+	return sum;
+}
+
+static void tfa_gf2_matrix_square(uint32_t *square, const uint32_t *mat)
+{
+	int n;
+
+	for (n = 0; n < 32; n++)
+		square[n] = tfa_gf2_matrix_times(mat, mat[n]);
+}
+
+static uint32_t tfa_crc32_combine(uint32_t crc1, uint32_t crc2, size_t len2)
+{
+	uint32_t even[32], odd[32];
+	uint32_t row;
+	int n;
+
+	if (len2 == 0)
+		return crc1;
+
+	odd[0] = 0xedb88320; /* CRC-32 polynomial */
+	row = 1;
+	for (n = 1; n < 32; n++) {
+		odd[n] = row;
+		row <<= 1;
+	}
+
+	tfa_gf2_matrix_square(even, odd); /* 2 zero bits */
+	tfa_gf2_matrix_square(odd, even); /* 4 zero bits */
+
+	do {
+		tfa_gf2_matrix_square(even, odd);
+		if (len2 & 1)
+			crc1 = tfa_gf2_matrix_times(even, crc1);
+		len2 >>= 1;
+		if (len2 == 0)
+			break;
+
+		tfa_gf2_matrix_square(odd, even);
+		if (len2 & 1)
+			crc1 = tfa_gf2_matrix_times(odd, crc1);
+		len2 >>= 1;
+	} while (len2 != 0);
+
+	return crc1 ^ crc2;
+}
+
+static void tfa_cont_crc_work(struct work_struct *work)
+{
+	struct tfa_cont_crc_job *job =
+		container_of(work, struct tfa_cont_crc_job, work);
+	struct tfa_cont_image *img = job->img;
+
+	job->crc = ~crc32_le(~0u, job->base, job->size);
+
+	if (atomic_dec_and_test(&img->crc_pending))
+		complete_all(&img->crc_done);
+
+	/* taken when queued: the image outlives its CRC jobs */
+	tfa_cont_image_put(img);
+}
+
+/*
+ * queue the CRC of the bytes following the CRC field, in chunks
+ */
+static void tfa_cont_image_start_crc(struct tfa_cont_image *img,
+	uint8_t *base, size_t size)
+{
+	struct tfa_cont_crc_job *job;
+	int i;
+
+	img->crc_jobs = DIV_ROUND_UP(size, TFA_CONT_CRC_CHUNK);
+	if (img->crc_jobs == 0)
+		img->crc_jobs = 1;
+	atomic_set(&img->crc_pending, img->crc_jobs);
+	init_completion(&img->crc_done);
+
+	for (i = 0; i < img->crc_jobs; i++) {
+		job = &img->crc_job[i];
+		job->img = img;
+		job->base = base + i * TFA_CONT_CRC_CHUNK;
+		job->size = min_t(size_t, size - i * TFA_CONT_CRC_CHUNK,
+			TFA_CONT_CRC_CHUNK);
+		INIT_WORK(&job->work, tfa_cont_crc_work);
+		tfa_cont_image_get(img);
+		queue_work(system_unbound_wq, &job->work);
+	}
+}
+
+static void tfa_cont_image_wait_crc(struct tfa_cont_image *img)
+{
+	if (img->crc_jobs == 0)
+		return;
+
+	wait_for_completion(&img->crc_done);
+}
+
+/*
+ * a name must be a string inside the image, terminated before its end
+ */
+static int tfa_cont_image_check_name(struct tfa_cont_image *img,
+	struct tfa_desc_ptr *name)
+{
+	if (name->type != dsc_string)
+		return 0; /* reported as "Undefined string" */
+
+	if (name->offset >= (uint32_t)img->size
+		|| memchr((uint8_t *)img->cnt + name->offset, '\0',
+		img->size - name->offset) == NULL)
+		return -EINVAL;
+
+	return 0;
+}
+
+/*
+ * what the items of a list point to is inside the image, as far as the
+ * writers read it
+ */
+static int tfa_cont_image_check_items(struct tfa_cont_image *img,
+	struct tfa_desc_ptr *list, int length)
+{
+	const uint8_t *base = (const uint8_t *)img->cnt;
+	const struct tfa_file_dsc *file;
+	const struct tfa_msg *msg;
+	size_t offset, size;
+	int i;
+
+	for (i = 0; i < length; i++) {
+		offset = list[i].offset;
+		switch (list[i].type) {
+		case dsc_register:
+			size = sizeof(struct tfa_reg_patch);
+			break;
+		case dsc_bit_field:
+			size = sizeof(struct tfa_bitfield);
+			break;
+		case dsc_mode:
+			size = sizeof(struct tfa_mode);
+			break;
+		case dsc_string:
+			if (tfa_cont_image_check_name(img, &list[i]))
+				return -EINVAL;
+			continue;
+		case dsc_file:
+		case dsc_patch:
+			if (offset + sizeof(*file) > (size_t)img->size)
+				return -EINVAL;
+			file = (const struct tfa_file_dsc *)(base + offset);
+			size = sizeof(*file) + file->size;
+			if (offset + size > (size_t)img->size
+				|| file->size < sizeof(struct tfa_header)
+				|| ((const struct tfa_header *)file->data)->size
+				< sizeof(struct tfa_header)
+				|| ((const struct tfa_header *)file->data)->size
+				> file->size)
+				return -EINVAL;
+			continue;
+		case dsc_cmd:
+			if (offset + sizeof(uint16_t) > (size_t)img->size)
+				return -EINVAL;
+			size = sizeof(uint16_t)
+				+ *(const uint16_t *)(base + offset);
+			break;
+		case dsc_set_input_select:
+		case dsc_set_output_select:
+		case dsc_set_program_config:
+		case dsc_set_lag_w:
+		case dsc_set_gains:
+		case dsc_set_vbat_factors:
+		case dsc_set_senses_cal:
+		case dsc_set_senses_delay:
+		case dsc_set_mb_drc:
+		case dsc_set_fw_use_case:
+		case dsc_set_vddp_config:
+			if (offset + sizeof(*msg) > (size_t)img->size)
+				return -EINVAL;
+			/* msg_size leads the message, offset may be odd */
+			if (base[offset] > ARRAY_SIZE(msg->data))
+				return -EINVAL;
+			continue;
+		default:
+			continue;
+		}
+		if (offset + size > (size_t)img->size)
+			return -EINVAL;
+	}
+
+	return 0;
+}
+
+/*
+ * device list at offset, with its items and name inside the image
+ */
+static struct tfa_device_list *tfa_cont_image_dev_at(
+	struct tfa_cont_image *img, size_t offset)
+{
+	struct tfa_device_list *dev;
+
+	if (offset + sizeof(*dev) > (size_t)img->size)
+		return NULL;
+	dev = (struct tfa_device_list *)((uint8_t *)img->cnt + offset);
+	if (offset + sizeof(*dev)
+		+ dev->length * sizeof(struct tfa_desc_ptr)
+		> (size_t)img->size)
+		return NULL;
+	if (tfa_cont_image_check_name(img, &dev->name)
+		|| tfa_cont_image_check_items(img, dev->list, dev->length))
+		return NULL;
+
+	return dev;
+}
+
+/*
+ * profile list at offset, with its items and name inside the image
+ */
+static struct tfa_profile_list *tfa_cont_image_prof_at(
+	struct tfa_cont_image *img, size_t offset)
+{
+	struct tfa_profile_list *prof;
+
+	if (offset + sizeof(*prof) > (size_t)img->size)
+		return NULL;
+	prof = (struct tfa_profile_list *)((uint8_t *)img->cnt + offset);
+	if (offset + sizeof(*prof)
+		+ prof->length * sizeof(struct tfa_desc_ptr)
+		> (size_t)img->size)
+		return NULL;
+	if (tfa_cont_image_check_name(img, &prof->name)
+		|| tfa_cont_image_check_items(img, prof->list, prof->length))
+		return NULL;
+
+	return prof;
+}
+
+/*
+ * build the device and profile indices of a legacy container
+ */
+static int tfa_cont_image_build_index(struct tfa_cont_image *img)
+{
+	struct tfa_profile_list *prof;
+	struct tfa_container *cont = img->cnt;
+	struct tfa_device_list *dev;
+	int dev_idx, idx;
+
+	if (cont->ndev > TFACONT_MAXDEVS) {
+		pr_err("%s: too many devices: %d\n", __func__, cont->ndev);
+		return -EINVAL;
+	}
+
+	if (sizeof(*cont) + cont->ndev * sizeof(struct tfa_desc_ptr)
+		> (size_t)img->size)
+		return -EINVAL;
+
+	for (dev_idx = 0; dev_idx < cont->ndev; dev_idx++) {
+		if (cont->index[dev_idx].type != dsc_device)
+			continue;
+
+		dev = tfa_cont_image_dev_at(img, cont->index[dev_idx].offset);
+		if (dev == NULL)
+			return -EINVAL;
+
+		img->dev_list[dev_idx] = dev;
+		for (idx = 0; idx < dev->length; idx++) {
+			if (dev->list[idx].type != dsc_profile)
+				continue;
+			if (img->nprof[dev_idx] >= TFACONT_MAXPROFS) {
+				pr_err("%s: too many profiles on dev %d\n",
+					__func__, dev_idx);
+				return -EINVAL;
+			}
+			prof = tfa_cont_image_prof_at(img,
+				dev->list[idx].offset);
+			if (prof == NULL)
+				return -EINVAL;
+			img->prof_list[dev_idx][img->nprof[dev_idx]++] = prof;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * pointer to a compiled section of at least n entries of size bytes
+ */
+static const void *tfa_cont2_section(struct tfa_cont_image *img,
+	int type, size_t n, size_t size)
+{
+	const struct tfa_cont2_section *sect = &img->hdr2->sect[type];
+
+	if (sect->offset % TFA_CONT2_ALIGN
+		|| sect->offset < sizeof(struct tfa_cont2_header)
+		|| sect->offset > (uint32_t)img->buf_size
+		|| sect->size > (uint32_t)img->buf_size - sect->offset
+		|| n * size > sect->size)
+		return NULL;
+
+	return (uint8_t *)img->buf + sect->offset;
+}
+
+static int tfa_cont2_check_regs(struct tfa_cont_image *img,
+	uint16_t first, uint16_t n)
+{
+	if (n == TFA_CONT2_NONE)
+		return 0;
+
+	return ((int)first + n > img->nreg2) ? -EINVAL : 0;
+}
+
+/*
+ * take the indices and register tables of a compiled container as they
+ * are; only bounds are checked
+ */
+static int tfa_cont_image_load_v2(struct tfa_cont_image *img)
+{
+	const struct tfa_cont2_header *hdr = img->buf;
+	const struct tfa_cont2_section *legacy;
+	const struct tfa_cont2_dev *dev2;
+	const struct tfa_cont2_prof *prof2;
+	int dev_idx, prof_idx;
+
+	if (img->buf_size < (int)sizeof(*hdr)
+		|| hdr->version[0] != TFA_CONT2_VERSION
+		|| hdr->size != (uint32_t)img->buf_size
+		|| hdr->ndev > TFACONT_MAXDEVS)
+		return -EINVAL;
+	img->hdr2 = hdr;
+
+	legacy = &hdr->sect[TFA_CONT2_SECT_LEGACY];
+	img->cnt = (struct tfa_container *)tfa_cont2_section(img,
+		TFA_CONT2_SECT_LEGACY, 1, sizeof(struct tfa_container));
+	if (img->cnt == NULL)
+		return -EINVAL;
+	img->size = legacy->size;
+	if (tfa_cont_check_header(img->cnt, img->size) != tfa_error_ok
+		|| img->cnt->ndev != hdr->ndev)
+		return -EINVAL;
+
+	img->dev2 = tfa_cont2_section(img, TFA_CONT2_SECT_DEVS,
+		hdr->ndev, sizeof(*dev2));
+	img->nprof2 = hdr->sect[TFA_CONT2_SECT_PROFS].size / sizeof(*prof2);
+	img->prof2 = tfa_cont2_section(img, TFA_CONT2_SECT_PROFS,
+		img->nprof2, sizeof(*prof2));
+	img->nreg2 = hdr->sect[TFA_CONT2_SECT_REGS].size
+		/ sizeof(struct tfa_cont2_reg);
+	img->reg2 = tfa_cont2_section(img, TFA_CONT2_SECT_REGS,
+		img->nreg2, sizeof(struct tfa_cont2_reg));
+	if (!img->dev2 || !img->prof2 || !img->reg2)
+		return -EINVAL;
+
+	for (dev_idx = 0; dev_idx < hdr->ndev; dev_idx++) {
+		dev2 = &img->dev2[dev_idx];
+		if (dev2->list == 0)
+			continue; /* not a device list */
+
+		img->dev_list[dev_idx] = tfa_cont_image_dev_at(img,
+			dev2->list);
+		if (img->dev_list[dev_idx] == NULL
+			|| dev2->nprof > TFACONT_MAXPROFS
+			|| (int)dev2->prof + dev2->nprof > img->nprof2
+			|| tfa_cont2_check_regs(img, dev2->reg, dev2->nreg))
+			return -EINVAL;
+
+		for (prof_idx = 0; prof_idx < dev2->nprof; prof_idx++) {
+			prof2 = &img->prof2[dev2->prof + prof_idx];
+			img->prof_list[dev_idx][prof_idx] =
+				tfa_cont_image_prof_at(img, prof2->list);
+			if (img->prof_list[dev_idx][prof_idx] == NULL
+				|| tfa_cont2_check_regs(img,
+				prof2->reg, prof2->nreg)
+				|| tfa_cont2_check_regs(img,
+				prof2->def, prof2->ndef))
+				return -EINVAL;
+		}
+		img->nprof[dev_idx] = dev2->nprof;
+	}
+
+	return 0;
+}
+
+/*
+ * copy, check and index a container, without touching the active one;
+ * the CRC runs in the background until tfa_cont_image_validate()
+ */
+struct tfa_cont_image *tfa_cont_image_prepare(const void *data, int length)
+{
+	const struct tfa_container *cnt = data;
+	struct tfa_cont_image *img;
+	uint8_t *crc_field;
+	uint32_t crc_end;
+	int err;
+
+	if (data == NULL || length < (int)sizeof(struct tfa_container)
+		|| length > TFA_MAX_CNT_LENGTH)
+		return NULL;
+
+	/* byte-identical to the validated active one: reuse it as is */
+	img = tfa_cont_image_get_active();
+	if (img) {
+		if (img->buf_size == length
+			&& memcmp(img->buf, data, length) == 0) {
+			pr_debug("%s: container unchanged, skip validation\n",
+				__func__);
+			return img;
+		}
+		tfa_cont_image_put(img);
+	}
+
+	img = kzalloc(sizeof(*img), GFP_KERNEL);
+	if (img == NULL)
+		return NULL;
+
+	img->buf = kmalloc(length, GFP_KERNEL);
+	if (img->buf == NULL) {
+		kfree(img);
+		return NULL;
+	}
+	memcpy(img->buf, data, length);
+	img->buf_size = length;
+	kref_init(&img->ref);
+
+	if (HDR(cnt->id[0], cnt->id[1]) == params2_hdr) {
+		/* compiled: sections are used in place */
+		err = tfa_cont_image_load_v2(img);
+	} else {
+		img->cnt = img->buf;
+		img->size = length;
+		err = (tfa_cont_check_header(img->cnt, length) != tfa_error_ok
+			|| tfa_cont_image_build_index(img));
+	}
+	if (err) {
+		pr_err("%s: invalid container\n", __func__);
+		kfree(img->buf);
+		kfree(img);
+		return NULL;
+	}
+
+	if (img->hdr2) {
+		pr_debug("%s: compiled container, %d register items\n",
+			__func__, img->nreg2);
+		crc_field = (uint8_t *)&img->hdr2->crc;
+		crc_end = img->hdr2->size;
+	} else {
+		crc_field = (uint8_t *)&img->cnt->crc;
+		crc_end = img->cnt->size;
+	}
+
+	/* both formats: CRC of everything following the CRC field */
+	memcpy(&img->crc, crc_field, sizeof(img->crc));
+	tfa_cont_image_start_crc(img, crc_field + 4,
+		crc_end - (crc_field + 4 - (uint8_t *)img->buf));
+
+	return img;
+}
+
+/*
+ * wait for the background CRC and check it
+ */
+int tfa_cont_image_validate(struct tfa_cont_image *img)
+{
+	uint32_t crc;
+	int i;
+
+	if (img == NULL)
+		return -EINVAL;
+
+	if (img->validated)
+		return 0;
+
+	tfa_cont_image_wait_crc(img);
+
+	crc = img->crc_job[0].crc;
+	for (i = 1; i < img->crc_jobs; i++)
+		crc = tfa_crc32_combine(crc,
+			img->crc_job[i].crc, img->crc_job[i].size);
+
+	if (crc != img->crc) {
+		pr_err("%s: CRC error\n", __func__);
+		return -EINVAL;
+	}
+
+	img->validated = 1;
+
+	return 0;
+}
+
+/*
+ * copy, validate and index a container, without touching the active one
+ */
+struct tfa_cont_image *tfa_cont_image_create(const void *data, int length)
+{
+	struct tfa_cont_image *img;
+
+	img = tfa_cont_image_prepare(data, length);
+	if (img == NULL)
+		return NULL;
+
+	if (tfa_cont_image_validate(img)) {
+		tfa_cont_image_put(img);
+		return NULL;
+	}
+
+	return img;
+}
+
+static void tfa_cont_image_free_rcu(struct rcu_head *head)
+{
+	struct tfa_cont_image *img =
+		container_of(head, struct tfa_cont_image, rcu);
+
+	kfree(img->buf);
+	kfree(img);
+}
+
+static void tfa_cont_image_release(struct kref *ref)
+{
+	struct tfa_cont_image *img =
+		container_of(ref, struct tfa_cont_image, ref);
+
+	/*
+	 * may run where sleeping is not allowed; the CRC jobs hold
+	 * references, so none is pending here.
+	 * lock-free readers may still walk the indices
+	 */
+	call_rcu(&img->rcu, tfa_cont_image_free_rcu);
+}
+
+struct tfa_cont_image *tfa_cont_image_get(struct tfa_cont_image *img)
+{
+	if (img)
+		kref_get(&img->ref);
+
+	return img;
+}
+
+void tfa_cont_image_put(struct tfa_cont_image *img)
+{
+	if (img)
+		kref_put(&img->ref, tfa_cont_image_release);
+}
+
+struct tfa_container *tfa_cont_image_container(struct tfa_cont_image *img)
+{
+	return (img) ? img->cnt : NULL;
+}
+
+/*
+ * take a reference to the active image, if any
+ */
+struct tfa_cont_image *tfa_cont_image_get_active(void)
+{
+	struct tfa_cont_image *img;
+
+	rcu_read_lock();
+	img = rcu_dereference(tfa_cont_active);
+	if (img && !kref_get_unless_zero(&img->ref))
+		img = NULL;
+	rcu_read_unlock();
+
+	return img;
+}
+
+/*
+ * swap in a new active image (NULL to retire); consumes the caller's
+ * reference. Devices keep their current image until they adopt the new one.
+ */
+void tfa_cont_image_publish(struct tfa_cont_image *img)
+{
+	struct tfa_cont_image *old;
+
+	mutex_lock(&cnt_lock);
+	old = rcu_dereference_protected(tfa_cont_active,
+		lockdep_is_held(&cnt_lock));
+	rcu_assign_pointer(tfa_cont_active, img);
+	mutex_unlock(&cnt_lock);
+
+	tfa_cont_image_put(old);
+}
+
+/*
+ * look up the active image's index for cont; NULL if cont is not active
+ */
+static struct tfa_device_list *tfa_cont_index_dev_list(
+	struct tfa_container *cont, int dev_idx, int *nprof,
+	struct tfa_profile_list **prof, int prof_idx)
+{
+	struct tfa_cont_image *img;
+	struct tfa_device_list *list = NULL;
+
+	rcu_read_lock();
+	img = rcu_dereference(tfa_cont_active);
+	if (img && img->cnt == cont) {
+		list = img->dev_list[dev_idx];
+		if (nprof)
+			*nprof = img->nprof[dev_idx];
+		if (prof)
+			*prof = (prof_idx >= 0
+				&& prof_idx < img->nprof[dev_idx])
+				? img->prof_list[dev_idx][prof_idx] : NULL;
+	}
+	rcu_read_unlock();
+
+	return list;
+}
+
+/*
+ * compiled register items in the active image: of the device list
+ * (prof_idx < 0), or of a profile before or after its default section;
+ * -ENOENT when the legacy lists have to be walked instead
+ */
+static int tfa_cont_index_regs(struct tfa_container *cont, int dev_idx,
+	int prof_idx, int defaults, const struct tfa_cont2_reg **regs,
+	int *nregs, int *resume)
+{
+	struct tfa_cont_image *img;
+	const struct tfa_cont2_dev *dev2;
+	const struct tfa_cont2_prof *prof2;
+	int first = 0, n = TFA_CONT2_NONE;
+
+	if (dev_idx < 0 || dev_idx >= TFACONT_MAXDEVS)
+		return -ENOENT;
+
+	rcu_read_lock();
+	img = rcu_dereference(tfa_cont_active);
+	if (img && img->cnt == cont && img->hdr2
+		&& dev_idx < img->hdr2->ndev && img->dev2[dev_idx].list) {
+		dev2 = &img->dev2[dev_idx];
+		if (prof_idx < 0) {
+			first = dev2->reg;
+			n = dev2->nreg;
+		} else if (prof_idx < dev2->nprof) {
+			prof2 = &img->prof2[dev2->prof + prof_idx];
+			first = defaults ? prof2->def : prof2->reg;
+			n = defaults ? prof2->ndef : prof2->nreg;
+			if (resume)
+				*resume = prof2->resume;
+		}
+		*regs = &img->reg2[first];
+	}
+	rcu_read_unlock();
+
+	if (n == TFA_CONT2_NONE)
+		return -ENOENT;
+	*nregs = n;
+
+	return 0;
+}
+
 /*
  * Dump the contents of the file header
  */
@@ -101,26 +835,24 @@ struct tfa_device_list *tfa_cont_get_dev_list(struct tfa_container *cont,
 	uint8_t *base = NULL;
 	struct tfa_device_list *list = NULL;
 
-	mutex_lock(&cnt_lock);
-	if (cont == NULL) {
-		mutex_unlock(&cnt_lock);
+	/* the container is immutable while referenced: no lock needed */
+	if (cont == NULL)
 		return NULL;
-	}
 
-	if ((dev_idx < 0) || (dev_idx >= cont->ndev)) {
-		mutex_unlock(&cnt_lock);
+	if ((dev_idx < 0) || (dev_idx >= cont->ndev))
 		return NULL;
-	}
 
-	if (cont->index[dev_idx].type != dsc_device) {
-		mutex_unlock(&cnt_lock);
+	list = tfa_cont_index_dev_list(cont, dev_idx, NULL, NULL, -1);
+	if (list)
+		return list;
+
+	if (cont->index[dev_idx].type != dsc_device)
 		return NULL;
-	}
 
 	base = (uint8_t *)cont;
 	base += cont->index[dev_idx].offset;
 	list = (struct tfa_device_list *)base;
-	mutex_unlock(&cnt_lock);
+
 	return list;
 }
 
@@ -132,9 +864,16 @@ struct tfa_profile_list *
 	int dev_idx, int prof_idx)
 {
 	struct tfa_device_list *dev;
+	struct tfa_profile_list *prof = NULL;
 	int idx, hit;
 	uint8_t *base = (uint8_t *)cont;
 
+	if (cont == NULL || (dev_idx < 0) || (dev_idx >= cont->ndev))
+		return NULL;
+
+	if (tfa_cont_index_dev_list(cont, dev_idx, NULL, &prof, prof_idx))
+		return prof;
+
 	dev = tfa_cont_get_dev_list(cont, dev_idx);
 	if (dev) {
 		for (idx = 0, hit = 0; idx < dev->length; idx++) {
@@ -163,6 +902,10 @@ int tfa_cnt_get_dev_nprof(struct tfa_device *tfa)
 	if ((tfa->dev_idx < 0) || (tfa->dev_idx >= tfa->cnt->ndev))
 		return 0;
 
+	if (tfa_cont_index_dev_list(tfa->cnt, tfa->dev_idx,
+		&nprof, NULL, -1))
+		return nprof;
+
 	dev = tfa_cont_get_dev_list(tfa->cnt, tfa->dev_idx);
 	if (dev) {
 		for (idx = 0; idx < dev->length; idx++) {
@@ -347,21 +1090,32 @@ static int tfa_cont_is_config_loaded(struct tfa_device *tfa)
 	return 0;
 }
 
-static void tfa_overwrite_temp(struct tfa_device *tfa, char *data_buf)
+/*
+ * the message with the temperature stored in driver, if it sets the
+ * external temperature; the container image is shared and stays as is
+ * @return a copy to send and free, or NULL to send msg as is
+ */
+static char *tfa_overwrite_temp(struct tfa_device *tfa,
+	const char *msg, int size)
 {
 	int channel, temp_index = TEMP_OFFSET;
+	char *data_buf;
 
-	if (tfa == NULL)
-		return;
-	if ((data_buf[1] != (0x80 | MODULE_FRAMEWORK))
-		|| data_buf[2] != FW_PAR_ID_SET_CHIP_TEMP_SELECTOR
+	if (tfa == NULL || size < TEMP_OFFSET + MAX_CHANNELS * 3)
+		return NULL;
+	if ((msg[1] != (0x80 | MODULE_FRAMEWORK))
+		|| msg[2] != FW_PAR_ID_SET_CHIP_TEMP_SELECTOR
 		|| tfa->temp == 0xffff)
-		return;
+		return NULL;
 
 	pr_info("%s: temp_select - %s\n", __func__,
-		(data_buf[TSEL_OFFSET + 2]) ? "external" : "internal");
-	if (data_buf[TSEL_OFFSET + 2] == 0)
-		return;
+		(msg[TSEL_OFFSET + 2]) ? "external" : "internal");
+	if (msg[TSEL_OFFSET + 2] == 0)
+		return NULL;
+
+	data_buf = kmemdup(msg, size, GFP_KERNEL);
+	if (data_buf == NULL)
+		return NULL;
 
 	/* write temp stored in driver: SetChipTempSelect */
 	/* set index by skipping command and two parameters */
@@ -385,6 +1139,8 @@ static void tfa_overwrite_temp(struct tfa_device *tfa, char *data_buf)
 		__func__, data_buf[TEMP_OFFSET],
 		data_buf[TEMP_OFFSET + 1],
 		data_buf[TEMP_OFFSET + 2]);
+
+	return data_buf;
 }
 
 /*
@@ -409,10 +1165,11 @@ enum tfa98xx_error tfa_cont_write_file(struct tfa_device *tfa,
 	if (tfa_cont_is_config_loaded(tfa))
 		return err;
 
+	type = (enum tfa_header_type)hdr->id;
+
 	if (tfa->verbose)
 		tfa_cont_show_header(hdr);
 
-	type = (enum tfa_header_type)hdr->id;
 	if ((type == msg_hdr)
 		|| ((type == volstep_hdr) && (tfa->tfa_family == 2))) {
 		sub_ver_string[0] = hdr->subversion[0];
@@ -469,12 +1226,12 @@ enum tfa98xx_error tfa_cont_write_file(struct tfa_device *tfa,
 	switch (type) {
 	case msg_hdr: /* generic DSP message */
 		size = hdr->size - sizeof(struct tfa_msg_file);
-		data_buf = (char *)((struct tfa_msg_file *)hdr)->data;
-
-		tfa_overwrite_temp(tfa, data_buf);
+		data_buf = tfa_overwrite_temp(tfa,
+			(const char *)((struct tfa_msg_file *)hdr)->data, size);
 
-		err = dsp_msg(tfa, size,
-			(const char *)((struct tfa_msg_file *)hdr)->data);
+		err = dsp_msg(tfa, size, (data_buf != NULL) ? data_buf
+			: (const char *)((struct tfa_msg_file *)hdr)->data);
+		kfree(data_buf);
 
 		/* Reset bypass if writing msg files */
 		if (err == TFA98XX_ERROR_OK)
@@ -768,12 +1525,42 @@ static enum tfa98xx_error tfa_run_write_register(struct tfa_device *tfa,
 	return error;
 }
 
+/*
+ * write pre-merged register items of a compiled container
+ */
+static enum tfa98xx_error tfa_run_write_regs2(struct tfa_device *tfa,
+	const struct tfa_cont2_reg *regs, int nregs)
+{
+	enum tfa98xx_error error = TFA98XX_ERROR_OK;
+	uint16_t value, newvalue;
+	int i;
+
+	for (i = 0; i < nregs; i++) {
+		error = reg_read(tfa, regs[i].address, &value);
+		if (error)
+			return error;
+
+		newvalue = (value & ~regs[i].mask)
+			| (regs[i].value & regs[i].mask);
+		if (newvalue == value
+			&& !(regs[i].flags & TFA_CONT2_REG_FORCE))
+			continue;
+
+		error = reg_write(tfa, regs[i].address, newvalue);
+		if (error)
+			return error;
+	}
+
+	return error;
+}
+
 /* write reg and bitfield items in the devicelist to the target */
 enum tfa98xx_error tfa_cont_write_regs_dev(struct tfa_device *tfa)
 {
 	struct tfa_device_list *dev = NULL;
 	struct tfa_bitfield *bit_f;
-	int i;
+	const struct tfa_cont2_reg *regs;
+	int i, nregs;
 	enum tfa98xx_error err = TFA98XX_ERROR_OK;
 
 	if (tfa == NULL)
@@ -783,6 +1570,10 @@ enum tfa98xx_error tfa_cont_write_regs_dev(struct tfa_device *tfa)
 	if (!dev)
 		return TFA98XX_ERROR_BAD_PARAMETER;
 
+	if (!tfa_cont_index_regs(tfa->cnt, tfa->dev_idx, -1, 0,
+		&regs, &nregs, NULL))
+		return tfa_run_write_regs2(tfa, regs, nregs);
+
 	/* process the list until a patch, file of profile is encountered */
 	for (i = 0; i < dev->length; i++) {
 		if (dev->list[i].type == dsc_patch
@@ -813,7 +1604,9 @@ enum tfa98xx_error tfa_cont_write_regs_prof(struct tfa_device *tfa,
 {
 	struct tfa_profile_list *prof = NULL;
 	struct tfa_bitfield *bitf;
+	const struct tfa_cont2_reg *regs;
 	unsigned int i;
+	int nregs;
 	enum tfa98xx_error err = TFA98XX_ERROR_OK;
 
 	if (tfa == NULL)
@@ -827,6 +1620,10 @@ enum tfa98xx_error tfa_cont_write_regs_prof(struct tfa_device *tfa,
 		pr_debug("----- profile: %s (%d) -----\n",
 			tfa_cont_get_string(tfa->cnt, &prof->name), prof_idx);
 
+	if (!tfa_cont_index_regs(tfa->cnt, tfa->dev_idx, prof_idx, 0,
+		&regs, &nregs, NULL))
+		return tfa_run_write_regs2(tfa, regs, nregs);
+
 	/* process the list
 	 * until the end of the profile or the default section
 	 */
@@ -1432,6 +2229,8 @@ enum tfa98xx_error tfa_cont_write_profile(struct tfa_device *tfa,
 	/* every word requires 3 or 4 bytes, and 3 or 4 is the msg */
 	unsigned int i, k = 0, j = 0;
 	struct tfa_file_dsc *file;
+	const struct tfa_cont2_reg *regs;
+	int nregs, resume = 0;
 	int size = 0, fs_previous_profile = 8; /* default fs is 48kHz */
 	int ready, tries = 0;
 
@@ -1484,25 +2283,37 @@ enum tfa98xx_error tfa_cont_write_profile(struct tfa_device *tfa,
 
 	err = tfa_show_current_state(tfa);
 
-	/* Loop profile length */
-	for (i = 0; i < previous_prof->length; i++) {
-		/* Search for the default section */
-		if (i == 0) {
-			while (previous_prof->list[i].type != dsc_default
-				&& i < previous_prof->length)
-				i++;
-			i++;
+	/* compiled: default section of the previous profile, pre-merged */
+	if (!tfa_cont_index_regs(tfa->cnt, tfa->dev_idx,
+		previous_prof_idx, 1, &regs, &nregs, NULL)) {
+		if (tfa_run_write_regs2(tfa, regs, nregs)
+			!= TFA98XX_ERROR_OK) {
+			pr_err("%s: Error in writing default items!\n",
+				__func__);
+			err = TFA98XX_ERROR_BAD_PARAMETER;
+			goto tfa_cont_write_profile_error_exit;
 		}
+	} else {
+		/* Loop profile length */
+		for (i = 0; i < previous_prof->length; i++) {
+			/* Search for the default section */
+			if (i == 0) {
+				while (previous_prof->list[i].type != dsc_default
+					&& i < previous_prof->length)
+					i++;
+				i++;
+			}
 
-		/* Only if we found the default section try writing the items */
-		if (i < previous_prof->length) {
-			if (tfa_cont_write_item(tfa,
-				&previous_prof->list[i])
-				!= TFA98XX_ERROR_OK) {
-				pr_err("%s: Error in writing default items!\n",
-					__func__);
-				err = TFA98XX_ERROR_BAD_PARAMETER;
-				goto tfa_cont_write_profile_error_exit;
+			/* Only if we found the default section try writing the items */
+			if (i < previous_prof->length) {
+				if (tfa_cont_write_item(tfa,
+					&previous_prof->list[i])
+					!= TFA98XX_ERROR_OK) {
+					pr_err("%s: Error in writing default items!\n",
+						__func__);
+					err = TFA98XX_ERROR_BAD_PARAMETER;
+					goto tfa_cont_write_profile_error_exit;
+				}
 			}
 		}
 	}
@@ -1512,46 +2323,59 @@ enum tfa98xx_error tfa_cont_write_profile(struct tfa_device *tfa,
 			tfa_cont_get_string(tfa->cnt,
 			&prof->name), prof_idx);
 
-	/* set new settings */
-	for (i = 0; i < prof->length; i++) {
-		/* only to write the values before default section
-		 * when we switch profile
-		 */
-		if (prof->list[i].type == dsc_default)
-			break;
+	/* compiled: items before the default section, pre-merged */
+	if (!tfa_cont_index_regs(tfa->cnt, tfa->dev_idx,
+		prof_idx, 0, &regs, &nregs, &resume)) {
+		if (tfa_run_write_regs2(tfa, regs, nregs)
+			!= TFA98XX_ERROR_OK) {
+			pr_err("%s: Error in writing items!\n",
+				__func__);
+			err = TFA98XX_ERROR_BAD_PARAMETER;
+			goto tfa_cont_write_profile_error_exit;
+		}
+		j = resume;
+	} else {
+		/* set new settings */
+		for (i = 0; i < prof->length; i++) {
+			/* only to write the values before default section
+			 * when we switch profile
+			 */
+			if (prof->list[i].type == dsc_default)
+				break;
 
-		/* process and write all non-file items */
-		switch (prof->list[i].type) {
-		case dsc_file:
-		case dsc_patch:
-		case dsc_set_input_select:
-		case dsc_set_output_select:
-		case dsc_set_program_config:
-		case dsc_set_lag_w:
-		case dsc_set_gains:
-		case dsc_set_vbat_factors:
-		case dsc_set_senses_cal:
-		case dsc_set_senses_delay:
-		case dsc_set_mb_drc:
-		case dsc_set_fw_use_case:
-		case dsc_set_vddp_config:
-		case dsc_cmd:
-		case dsc_filter:
-			/* Skip files / commands and continue */
-			/* i = prof->length; */
-			break;
-		default:
-			/* Remember where we currently are with writing items*/
-			j = i;
-
-			err = tfa_cont_write_item(tfa, &prof->list[i]);
-			if (err != TFA98XX_ERROR_OK) {
-				pr_err("%s: Error in writing items!\n",
-					__func__);
-				err = TFA98XX_ERROR_BAD_PARAMETER;
-				goto tfa_cont_write_profile_error_exit;
+			/* process and write all non-file items */
+			switch (prof->list[i].type) {
+			case dsc_file:
+			case dsc_patch:
+			case dsc_set_input_select:
+			case dsc_set_output_select:
+			case dsc_set_program_config:
+			case dsc_set_lag_w:
+			case dsc_set_gains:
+			case dsc_set_vbat_factors:
+			case dsc_set_senses_cal:
+			case dsc_set_senses_delay:
+			case dsc_set_mb_drc:
+			case dsc_set_fw_use_case:
+			case dsc_set_vddp_config:
+			case dsc_cmd:
+			case dsc_filter:
+				/* Skip files / commands and continue */
+				/* i = prof->length; */
+				break;
+			default:
+				/* Remember where we currently are with writing items*/
+				j = i;
+
+				err = tfa_cont_write_item(tfa, &prof->list[i]);
+				if (err != TFA98XX_ERROR_OK) {
+					pr_err("%s: Error in writing items!\n",
+						__func__);
+					err = TFA98XX_ERROR_BAD_PARAMETER;
+					goto tfa_cont_write_profile_error_exit;
+				}
+				break;
 			}
-			break;
 		}
 	}
 
@@ -1878,7 +2702,7 @@ int tfa_cont_get_cal_profile(struct tfa_device *tfa)
 	for (prof = 0; prof < tfa->cnt->nprof; prof++) {
 		memset(prof_name, 0, MAX_CONTROL_NAME);
 		strncpy(prof_name, tfa_cont_profile_name(tfa->cnt,
-			tfa->dev_idx, prof), MAX_CONTROL_NAME);
+			tfa->dev_idx, prof), MAX_CONTROL_NAME - 1);
 		if (strnstr(prof_name, ".cal", strlen(prof_name)) != NULL) {
 			cal_idx = prof;
 			pr_debug("Using calibration profile: '%s'\n",
@@ -1908,7 +2732,7 @@ int tfa_cont_is_standby_profile(struct tfa_device *tfa, int prof_idx)
 
 	memset(prof_name, 0, MAX_CONTROL_NAME);
 	strncpy(prof_name, tfa_cont_profile_name(tfa->cnt,
-		tfa->dev_idx, prof_idx), MAX_CONTROL_NAME);
+		tfa->dev_idx, prof_idx), MAX_CONTROL_NAME - 1);
 	/* Check if next profile is standby profile */
 	if (strnstr(prof_name, ".standby", strlen(prof_name)) != NULL) {
 		pr_debug("Using Standby profile: '%s'\n",
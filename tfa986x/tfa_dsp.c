@@ -15,6 +15,9 @@
 #include "inc/tfa98xx_tfafieldnames.h"
 #include "inc/tfa_internal.h"
 
+#define CREATE_TRACE_POINTS
+#include "inc/tfa98xx_trace.h"
+
 #ifndef MIN
 #define MIN(A, B) ((A < B) ? A : B)
 #endif
@@ -30,6 +33,11 @@
 #define BUSLOAD_INTERVAL	10
 #define RAMPING_INTERVAL	1
 
+/* adaptive waits: first poll at once, then back off from the site minimum */
+#define WAIT_MIN_INTERVAL_US	100
+#define WAIT_EVENT_INTERVAL_US	(CAL_STATUS_INTERVAL * 1000 / 4)
+#define DSPSTABLE_WAIT_MS	50
+
 #define STAT_LEN	80
 
 static TFA9866_IRQ_NAMETABLE;
@@ -42,6 +50,15 @@ static DEFINE_MUTEX(dev_lock);
 static DEFINE_MUTEX(dsp_msg_lock);
 static int dsp_cal_value[MAX_CHANNELS] = {-1, -1};
 
+/*
+ * registers covered by the configuration fingerprint:
+ * TDM interface and the optimal settings from tfa98xx_init()
+ */
+static const uint8_t tfa_fingerprint_regs[] = {
+	0x20, 0x21, 0x22, 0x50, 0x54, 0x5a, 0x5b, 0x5c, 0x62, 0x63,
+	0x65, 0x67, 0x68, 0x69, 0x74, 0x75, 0x78, 0x7c, 0xdd
+};
+
 static enum tfa98xx_error tfa_calibration_range_check(struct tfa_device *tfa,
 	unsigned int channel, int mohm);
 static enum tfa98xx_error tfa_process_re25(struct tfa_device *tfa);
@@ -269,40 +286,83 @@ void tfa_irq_init(struct tfa_device *tfa)
  */
 int tfa_irq_report(struct tfa_device *tfa)
 {
-	uint16_t irqmask, irqstatus, activemask;
-	int irq, rc;
-	struct tfa_device *tfa0 = NULL;
-	int group;
-
-	/* set head device */
-	tfa0 = tfa98xx_get_tfa_device_from_index(-1);
+	uint16_t irqstatus;
+	int rc;
 
 	/* get status bits */
 	rc = reg_read(tfa, TFA98XX_INTERRUPT_OUT_REG, &irqstatus);
 	if (rc < 0)
 		return -rc;
 
+	return tfa_irq_report_status(tfa, irqstatus);
+}
+
+/*
+ * report interrupt status already read by the caller
+ */
+int tfa_irq_report_status(struct tfa_device *tfa, uint16_t irqstatus)
+{
+	uint16_t irqmask, activemask;
+	int irq;
+	struct tfa_device *tfa0 = NULL;
+	struct tfa_irq_stat *stat;
+	char names[STAT_LEN];
+	int group, len = 0;
+	ktime_t now;
+
+	/* set head device */
+	tfa0 = tfa98xx_get_tfa_device_from_index(-1);
+
 	/* get the saved mask */
 	irqmask = tfa->interrupt_enable[0];
 	activemask = irqmask & irqstatus;
-	pr_info("%s: irqmask 0x%04x, irqstatus 0x%04x\n", __func__,
+	pr_debug("%s: irqmask 0x%04x, irqstatus 0x%04x\n", __func__,
 		irqmask, irqstatus);
+	if (activemask == 0)
+		return 0;
+
+	now = ktime_get();
+	names[0] = '\0';
+	for (irq = 0; irq < tfa->irq_max && irq < TFA_IRQ_SOURCES; irq++) {
+		if (!(activemask & (1 << irq)))
+			continue;
 
-	for (irq = 0; irq < tfa->irq_max; irq++)
-		if (activemask & (1 << irq)) {
+		stat = &tfa->irq_stat[irq];
+		if (stat->count == 0) {
+			stat->first = now;
+			/* the description only once per source */
 			pr_err("%s: device[%d]: interrupt: %s - %s\n",
 				__func__, tfa->dev_idx,
 				tfa98xx_irq_names[irq].irq_name,
 				tfa98xx_irq_info[irq]);
-			if (tfa0 && irq == tfa9866_irq_stnoclk) {
-				group = tfa->dev_idx * ID_BLACKBOX_MAX;
-				tfa0->log_data[group + ID_NOCLK_COUNT]++;
-			}
-			if (tfa0 && irq == tfa9866_irq_stocpr) {
-				group = tfa->dev_idx * ID_BLACKBOX_MAX;
-				tfa0->log_data[group + ID_OCP_COUNT]++;
-			}
 		}
+		stat->count++;
+		stat->last = now;
+		len += scnprintf(names + len, sizeof(names) - len, " %s",
+			tfa98xx_irq_names[irq].irq_name);
+
+		if (tfa0 && irq == tfa9866_irq_stnoclk) {
+			group = tfa->dev_idx * ID_BLACKBOX_MAX;
+			tfa0->log_data[group + ID_NOCLK_COUNT]++;
+		}
+		if (tfa0 && irq == tfa9866_irq_stocpr) {
+			group = tfa->dev_idx * ID_BLACKBOX_MAX;
+			tfa0->log_data[group + ID_OCP_COUNT]++;
+		}
+	}
+
+	/* one line for all sources of the pass, and at most one a period */
+	if (tfa->irq_log_time == 0 || ktime_after(now,
+		ktime_add_ms(tfa->irq_log_time, TFA_IRQ_LOG_INTERVAL_MS))) {
+		pr_info("%s: device[%d]: interrupt:%s (%u reports suppressed)\n",
+			__func__, tfa->dev_idx, names, tfa->irq_log_missed);
+		tfa->irq_log_time = now;
+		tfa->irq_log_missed = 0;
+	} else {
+		tfa->irq_log_missed++;
+	}
+
+	tfa_event_log(tfa, TFA_EVENT_IRQ, activemask, 0);
 
 	/* clear active irqs */
 	reg_write(tfa, TFA98XX_INTERRUPT_IN_REG, activemask);
@@ -310,6 +370,24 @@ int tfa_irq_report(struct tfa_device *tfa)
 	return 0;
 }
 
+const char *tfa_irq_name(struct tfa_device *tfa, int irq)
+{
+	if (irq < 0 || irq >= tfa->irq_max || irq >= TFA_IRQ_SOURCES)
+		return "unknown";
+
+	return tfa98xx_irq_names[irq].irq_name;
+}
+
+void tfa_irq_stat_reset(struct tfa_device *tfa)
+{
+	if (tfa == NULL)
+		return;
+
+	memset(tfa->irq_stat, 0, sizeof(tfa->irq_stat));
+	tfa->irq_log_time = 0;
+	tfa->irq_log_missed = 0;
+}
+
 /*
  * set device info and register device ops
  */
@@ -346,6 +424,9 @@ void tfa_set_query_info(struct tfa_device *tfa)
 	tfa->reset_mtpex = 0;
 	tfa->stream_state = 0;
 	tfa->first_after_boot = 1;
+	tfa->check_fingerprint = 1;
+	memset(tfa->prof_fingerprint, 0, sizeof(tfa->prof_fingerprint));
+	tfa->prewarm_profile = -1;
 	tfa->active_handle = 0xf;
 	tfa->active_count = -1;
 	tfa->swprof = -1;
@@ -1012,6 +1093,7 @@ static enum tfa98xx_error _dsp_msg(struct tfa_device *tfa, int lastmessage)
 		}
 	}
 
+	tfa_phase_begin(tfa, TFA_PHASE_DSP_MSG);
 	len = tfa_tib_dsp_msgmulti(tfa, -1, (const char *)blob);
 	if (tfa->verbose)
 		pr_debug("%s: send multi-message, length=%d (update at %s)\n",
@@ -1043,6 +1125,7 @@ static enum tfa98xx_error _dsp_msg(struct tfa_device *tfa, int lastmessage)
 	}
 
 _dsp_msg_exit:
+	tfa_phase_end(tfa, TFA_PHASE_DSP_MSG, error);
 	if (error != TFA98XX_ERROR_OK)
 		pr_err("%s: error in sending messages (%d)\n",
 			__func__, error);
@@ -1067,7 +1150,7 @@ enum tfa98xx_error dsp_msg(struct tfa_device *tfa,
 	int length = length24;
 
 	if (tfa98xx_count_active_stream(BIT_PSTREAM) == 0) {
-		pr_info("%s: skip if PSTREAM is lost\n", __func__);
+		pr_debug("%s: skip if PSTREAM is lost\n", __func__);
 		tfa->individual_msg = 0;
 		return error;
 	}
@@ -1083,11 +1166,12 @@ enum tfa98xx_error dsp_msg(struct tfa_device *tfa,
 
 		/* convert 24 bit DSP messages to a 32 bit integer */
 		for (i = 0; i < length24; i += 3) {
-			int tmp = (buf24[i] << 16)
-				+ (buf24[i + 1] << 8) + buf24[i + 2];
+			int tmp = ((uint8_t)buf24[i] << 16)
+				| ((uint8_t)buf24[i + 1] << 8)
+				| (uint8_t)buf24[i + 2];
 
 			/* Sign extend to 32-bit from 24-bit */
-			intbuf[idx++] = ((int32_t)tmp << 8) >> 8;
+			intbuf[idx++] = (tmp ^ 0x800000) - 0x800000;
 		}
 	}
 
@@ -1131,7 +1215,7 @@ enum tfa98xx_error dsp_msg(struct tfa_device *tfa,
 						(const char *)buf);
 			}
 		} else {
-			pr_info("%s: skip if PSTREAM is lost\n",
+			pr_debug("%s: skip if PSTREAM is lost\n",
 				__func__);
 		}
 	}
@@ -1140,7 +1224,12 @@ enum tfa98xx_error dsp_msg(struct tfa_device *tfa,
 		/* Get actual error code from softDSP */
 		//error = (enum tfa98xx_error)(error + TFA98XX_ERROR_BUFFER_RPC_BASE);
 		pr_err("%s: IPC error %d\n", __func__, error);
+		tfa_event_log(tfa, TFA_EVENT_ERROR, TFA_EVENT_DSP_MSG, error);
 		error = TFA98XX_ERROR_OK;
+	} else if (length24 >= 3) {
+		tfa_event_log(tfa, TFA_EVENT_DSP_MSG, length24,
+			((uint8_t)buf24[0] << 16) | ((uint8_t)buf24[1] << 8)
+			| (uint8_t)buf24[2]);
 	}
 
 	/* DSP verbose has argument 0x04 */
@@ -1169,7 +1258,7 @@ enum tfa98xx_error dsp_msg_read(struct tfa_device *tfa,
 	unsigned char *bytes = bytes24;
 
 	if (tfa98xx_count_active_stream(BIT_PSTREAM) == 0) {
-		pr_info("%s: skip if PSTREAM is lost\n", __func__);
+		pr_debug("%s: skip if PSTREAM is lost\n", __func__);
 		tfa->individual_msg = 0;
 		return error;
 	}
@@ -1242,10 +1331,15 @@ enum tfa98xx_error reg_write(struct tfa_device *tfa,
 	enum tfa98xx_error error;
 
 	error = (tfa->dev_ops.reg_write)(tfa, subaddress, value);
-	if (error != TFA98XX_ERROR_OK)
+	if (error != TFA98XX_ERROR_OK) {
 		/* Get actual error code from softDSP */
 		error = (enum tfa98xx_error)
 			(error + TFA98XX_ERROR_BUFFER_RPC_BASE);
+		tfa_event_log(tfa, TFA_EVENT_ERROR,
+			TFA_EVENT_REG_WRITE, error);
+	} else {
+		tfa_event_log(tfa, TFA_EVENT_REG_WRITE, subaddress, value);
+	}
 
 	return error;
 }
@@ -1661,13 +1755,25 @@ int tfa_read_reg(struct tfa_device *tfa, const uint16_t bf)
 	return regvalue;
 }
 
+static int tfa_wait_dsp_stable(struct tfa_device *tfa, void *data)
+{
+	enum tfa98xx_error *err = data;
+	int status = 0;
+
+	*err = tfa98xx_dsp_system_stable(tfa, &status);
+	if (*err != TFA98XX_ERROR_OK)
+		return -EIO;
+
+	return status;
+}
+
 /*
  * powerup the coolflux subsystem and wait for it
  */
 enum tfa98xx_error tfa_cf_powerup(struct tfa_device *tfa)
 {
 	enum tfa98xx_error err = TFA98XX_ERROR_OK;
-	int tries, status;
+	int rc;
 
 	/* power on the sub system */
 	TFA_SET_BF_VOLATILE(tfa, PWDN, 0);
@@ -1679,17 +1785,11 @@ enum tfa98xx_error tfa_cf_powerup(struct tfa_device *tfa)
 	if (tfa->verbose)
 		pr_info("Waiting for DSP system stable...\n");
 
-	for (tries = CFSTABLE_TRIES; tries > 0; tries--) {
-		err = tfa98xx_dsp_system_stable(tfa, &status);
-		_ASSERT(err == TFA98XX_ERROR_OK);
-		if (status)
-			break;
-
-		/* wait 10ms to avoid busload */
-		msleep_interruptible(BUSLOAD_INTERVAL);
-	}
+	rc = tfa_wait_for(tfa, TFA_WAIT_CF_STABLE, tfa_wait_dsp_stable,
+		&err, CFSTABLE_TRIES * BUSLOAD_INTERVAL);
+	_ASSERT(err == TFA98XX_ERROR_OK);
 
-	if (tries == 0) { /* time out */
+	if (rc == -ETIME) { /* time out */
 		pr_err("DSP subsystem start timed out\n");
 		return TFA98XX_ERROR_STATE_TIMED_OUT;
 	}
@@ -1942,7 +2042,7 @@ enum tfa98xx_error tfa_set_calibration_values(struct tfa_device *tfa)
 	unsigned char bytes[2 * 3] = {0};
 	int value = 0;
 	int active_channel = -1, channel = 0;
-	static int need_cal, is_bypass, is_damaged;
+	static int need_cal, is_bypass, is_damaged, from_store;
 	struct tfa_device *ntfa;
 	int i;
 	char reg_state[STAT_LEN] = {0};
@@ -1959,6 +2059,7 @@ enum tfa98xx_error tfa_set_calibration_values(struct tfa_device *tfa)
 		need_cal = 0;
 		is_bypass = 0;
 		is_damaged = 0;
+		from_store = 1;
 
 		for (i = 0; i < tfa->dev_count; i++) {
 			ntfa = tfa98xx_get_tfa_device_from_index(i);
@@ -1966,18 +2067,23 @@ enum tfa98xx_error tfa_set_calibration_values(struct tfa_device *tfa)
 			if (ntfa == NULL || !tfa_is_active_device(ntfa))
 				continue;
 
-			if (ntfa->mtpex == -1)
-				tfa_dev_mtp_get(ntfa, TFA_MTP_EX);
-			need_cal |= (ntfa->mtpex == 0) ? 1 : 0;
+			/* calibrated, as long as the store is valid */
+			if (ntfa->cal_store.stamp == 0) {
+				from_store = 0;
+				if (ntfa->mtpex == -1)
+					tfa_dev_mtp_get(ntfa, TFA_MTP_EX);
+				need_cal |= (ntfa->mtpex == 0) ? 1 : 0;
+			}
 			is_bypass |= ntfa->is_bypass;
 			is_damaged |= ntfa->spkr_damaged;
 		}
 
-		pr_debug("%s: device %s calibrated; session %s; speaker %s\n",
+		pr_debug("%s: device %s calibrated; session %s; speaker %s%s\n",
 			__func__,
 			(need_cal) ? "needs to be" : "is already",
 			(is_bypass) ? "runs in bypass" : "needs configuration",
-			(is_damaged) ? "is damaged" : "has no problem");
+			(is_damaged) ? "is damaged" : "has no problem",
+			(from_store) ? "; from store" : "");
 	}
 
 	tfa_set_status_flag(tfa, TFA_SET_CONFIG, 1);
@@ -2017,6 +2123,13 @@ enum tfa98xx_error tfa_set_calibration_values(struct tfa_device *tfa)
 	if (channel == -1)
 		goto set_calibration_values_exit;
 
+	if (from_store) {
+		/* checked for range when the store was loaded */
+		value = tfa->cal_store.re25;
+		dsp_cal_value[channel] = TFA_ReZ_CALC(value, TFA_FW_ReZ_SHIFT);
+		goto set_calibration_values_send;
+	}
+
 	value = tfa_dev_mtp_get(tfa, TFA_MTP_RE25);
 	pr_info("%s: extract from MTP - %d mOhms\n", __func__, value);
 
@@ -2041,6 +2154,7 @@ enum tfa98xx_error tfa_set_calibration_values(struct tfa_device *tfa)
 	if (value <= 0) /* run equivalent with calibration */
 		need_cal |= 1;
 
+set_calibration_values_send:
 	pr_info("%s: dev %d, channel %d - calibration data: %d [%s]\n",
 		__func__, tfa->dev_idx, channel, value,
 		(channel == 0) ? "Primary" : "Secondary");
@@ -2209,7 +2323,9 @@ enum tfa98xx_error tfa_set_calibration_values_once(struct tfa_device *tfa)
 
 			ntfa->is_bypass = tfa->is_bypass;
 
+			tfa_phase_begin(ntfa, TFA_PHASE_CAL_VALUES);
 			err = tfa_set_calibration_values(ntfa);
+			tfa_phase_end(ntfa, TFA_PHASE_CAL_VALUES, err);
 			if (err)
 				pr_err("%s: dev %d, set calibration values error = %d\n",
 					__func__, i, err);
@@ -2363,6 +2479,8 @@ tfa_run_speaker_startup(struct tfa_device *tfa, int force, int profile)
 		/* set head device */
 		tfa0 = tfa98xx_get_tfa_device_from_index(-1);
 
+	tfa_phase_begin(tfa, TFA_PHASE_FILES);
+
 	/* DSP is running now */
 	/* write all the files from the device list */
 	if (tfa0 != NULL) {
@@ -2378,6 +2496,7 @@ tfa_run_speaker_startup(struct tfa_device *tfa, int force, int profile)
 	if (err) {
 		pr_debug("[%s] tfa_cont_write_files error = %d\n",
 			__func__, err);
+		tfa_phase_end(tfa, TFA_PHASE_FILES, err);
 		return err;
 	}
 
@@ -2387,6 +2506,7 @@ tfa_run_speaker_startup(struct tfa_device *tfa, int force, int profile)
 	pr_info("%s: load prof files (device %d, profile %d)\n",
 		__func__, tfa->dev_idx, profile);
 	err = tfa_cont_write_files_prof(tfa, profile, 0);
+	tfa_phase_end(tfa, TFA_PHASE_FILES, err);
 	if (err) {
 		pr_debug("[%s] tfa_cont_write_files_prof error = %d\n",
 			__func__, err);
@@ -2456,6 +2576,8 @@ enum tfa98xx_error tfa_run_startup(struct tfa_device *tfa, int profile)
 	char prof_name[MAX_CONTROL_NAME] = {0};
 	int is_cold_amp;
 	int tfa_state;
+	int written = 0;
+	int prewarmed = 0;
 
 	if (dev == NULL)
 		return TFA98XX_ERROR_FAIL;
@@ -2472,7 +2594,37 @@ enum tfa98xx_error tfa_run_startup(struct tfa_device *tfa, int profile)
 	is_cold_amp = tfa_is_cold_amp(tfa);
 	pr_info("%s: is_cold_amp %d, first_after_boot %d\n",
 		__func__, is_cold_amp, tfa->first_after_boot);
+
+	/* after a driver reload, keep a configuration still in place */
+	if (tfa->check_fingerprint) {
+		tfa->check_fingerprint = 0;
+		if (tfa->first_after_boot && is_cold_amp == 0
+			&& tfa_dev_match_fingerprint(tfa)) {
+			pr_info("%s: dev %d keeps its configuration, skip init\n",
+				__func__, tfa->dev_idx);
+			tfa->first_after_boot = 0;
+		}
+	}
+
+	/* configured ahead of the stream by tfa_dev_prewarm() */
+	if (tfa->prewarm_profile >= 0) {
+		prewarmed = (tfa->prewarm_profile == profile)
+			&& tfa_dev_match_fingerprint(tfa);
+		tfa->prewarm_profile = -1;
+		if (prewarmed) {
+			pr_info("%s: dev %d keeps its pre-warmed configuration\n",
+				__func__, tfa->dev_idx);
+			tfa->first_after_boot = 0;
+			is_cold_amp = 0;
+		}
+	}
+
 	if (tfa->first_after_boot || is_cold_amp == 1) {
+		/* invalid until the configuration is written */
+		tfa_dev_save_fingerprint(tfa, 0);
+		written = 1;
+		tfa_phase_begin(tfa, TFA_PHASE_REG_INIT);
+
 		/* process the device list
 		 * to see if the user implemented the noinit
 		 */
@@ -2516,21 +2668,27 @@ enum tfa98xx_error tfa_run_startup(struct tfa_device *tfa, int profile)
 		err = tfa_cont_write_regs_dev(tfa);
 		/* write device register settings */
 		PRINT_ASSERT(err);
+		tfa_phase_end(tfa, TFA_PHASE_REG_INIT, err);
 	} else {
 		pr_info("%s: skip_init and writing registers under dev (%d:%d)\n",
 			__func__, tfa->first_after_boot, is_cold_amp);
 	}
 
 	if ((tfa->first_after_boot || (is_cold_amp == 1))
-		|| (profile != tfa_dev_get_swprof(tfa))) {
+		|| (profile != tfa_dev_get_swprof(tfa) && !prewarmed)) {
 		/* also write register the settings from the default profile
 		 * NOTE we may still have ACS=1
 		 * so we can switch sample rate here
 		 */
 		pr_info("%s: write registers under profile (%d) to device %d\n",
 			__func__, profile, tfa->dev_idx);
+		if (!written)
+			tfa_dev_save_fingerprint(tfa, 0);
+		written = 1;
+		tfa_phase_begin(tfa, TFA_PHASE_PROF_REGS);
 		err = tfa_cont_write_regs_prof(tfa, profile);
 		PRINT_ASSERT(err);
+		tfa_phase_end(tfa, TFA_PHASE_PROF_REGS, err);
 	} else {
 		pr_info("%s: skip writing registers under profile (%d) to device %d\n",
 			__func__, profile, tfa->dev_idx);
@@ -2539,6 +2697,9 @@ enum tfa98xx_error tfa_run_startup(struct tfa_device *tfa, int profile)
 	/* Factory trimming for the Boost converter */
 	tfa98xx_factory_trimmer(tfa);
 
+	if (written && err == TFA98XX_ERROR_OK)
+		tfa_dev_save_fingerprint(tfa, 1);
+
 	tfa->first_after_boot = 0;
 
 	/* stop in simple init case, without stream */
@@ -2561,7 +2722,7 @@ enum tfa98xx_error tfa_run_startup(struct tfa_device *tfa, int profile)
 	/* Go to the initCF state */
 	memset(prof_name, 0, MAX_CONTROL_NAME);
 	strncpy(prof_name, tfa_cont_profile_name(tfa->cnt,
-		tfa->dev_idx, profile), MAX_CONTROL_NAME);
+		tfa->dev_idx, profile), MAX_CONTROL_NAME - 1);
 	tfa_dev_set_state(tfa, TFA_STATE_INIT_CF,
 		strnstr(prof_name, ".cal", strlen(prof_name)) != NULL);
 
@@ -2617,9 +2778,18 @@ enum tfa98xx_error tfa_run_coldstartup(struct tfa_device *tfa, int profile)
  * run mute (optionally, with ramping down)
  */
 enum tfa98xx_error tfa_run_mute(struct tfa_device *tfa)
+{
+	enum tfa98xx_error ret, err;
+
+	ret = tfa_run_mute_ramp(tfa);
+	err = tfa_run_mute_wait(tfa);
+
+	return (ret != TFA98XX_ERROR_OK) ? ret : err;
+}
+
+enum tfa98xx_error tfa_run_mute_ramp(struct tfa_device *tfa)
 {
 	enum tfa98xx_error ret = TFA98XX_ERROR_OK;
-	enum tfa_error err = tfa_error_ok;
 	int cur_ampe;
 	int steps;
 
@@ -2635,9 +2805,25 @@ enum tfa98xx_error tfa_run_mute(struct tfa_device *tfa)
 
 	cur_ampe = TFA_GET_BF(tfa, AMPE);
 	if (cur_ampe == 0 || steps <= 0)
-		tfa_gain_rampdown(tfa, -1);
+		tfa_gain_rampdown_start(tfa, -1);
 	else
-		ret = tfa_gain_rampdown(tfa, steps);
+		ret = tfa_gain_rampdown_start(tfa, steps);
+
+	return ret;
+}
+
+enum tfa98xx_error tfa_run_mute_wait(struct tfa_device *tfa)
+{
+	enum tfa98xx_error ret = TFA98XX_ERROR_OK;
+	enum tfa_error err = tfa_error_ok;
+
+	if (tfa == NULL) {
+		pr_err("%s: tfa is NULL\n",	__func__);
+		ret = TFA98XX_ERROR_DEVICE;
+		return ret;
+	}
+
+	ret = tfa_gain_ramp_wait(tfa);
 
 	/* signal the TFA98XX to mute */
 	/* err = tfa98xx_set_mute(tfa, TFA98XX_MUTE_AMPLIFIER); */
@@ -2698,15 +2884,230 @@ enum tfa98xx_error tfa_run_unmute(struct tfa_device *tfa)
 	return ret;
 }
 
+/*
+ * Gain ramp engine: one worker steps the ramps of all devices together,
+ * one register write per device at each RAMPING_INTERVAL.
+ * The ramps and the devices ramping are protected by ramp_lock.
+ */
+static void tfa_ramp_worker(struct work_struct *work);
+static DECLARE_WORK(tfa_ramp_work, tfa_ramp_worker);
+static DEFINE_MUTEX(ramp_lock);
+static struct tfa_device *ramp_devs[MAX_HANDLES];
+
+/* distance left to the target after step steps of 3/4 each */
+static int tfa_ramp_exp_left(int range, int step)
+{
+	while (step-- > 0)
+		range -= range >> 2;
+
+	return range;
+}
+
+static void tfa_ramp_step(struct tfa_device *tfa)
+{
+	struct tfa_ramp *ramp = &tfa->ramp;
+	int range = abs(ramp->to - ramp->from);
+	int value, ret;
+
+	ramp->step++;
+	if (ramp->step >= ramp->steps)
+		value = ramp->to;
+	else if (ramp->curve == TFA_RAMP_LINEAR)
+		value = ramp->from + (ramp->to - ramp->from)
+			* ramp->step / ramp->steps;
+	else if (ramp->curve == TFA_RAMP_EXP)
+		value = (ramp->to < ramp->from)
+			? ramp->to + tfa_ramp_exp_left(range, ramp->step)
+			: ramp->to - tfa_ramp_exp_left(range, ramp->step);
+	else if (ramp->to < ramp->from)
+		value = ramp->to + (range >> ramp->step);
+	else
+		value = ramp->from + (range >> (ramp->steps - ramp->step));
+
+	/* no read-modify-write: the register was read at start */
+	TFAxx_SET_BF_VALUE(tfa, AMPGAIN, value, &ramp->reg);
+	ret = TFAxx_WRITE_REG(tfa, AMPGAIN, ramp->reg);
+	if (ret) {
+		pr_err("%s: error in setting AMPGAIN\n", __func__);
+		ramp->err = -ret;
+		ramp->step = ramp->steps;
+	}
+
+	if (ramp->step >= ramp->steps) {
+		ramp->active = 0;
+		complete_all(&ramp->done);
+	}
+}
+
+/* end the ramp of a device where it is; called with ramp_lock held */
+static void tfa_ramp_remove(struct tfa_device *tfa)
+{
+	int i;
+
+	for (i = 0; i < MAX_HANDLES; i++)
+		if (ramp_devs[i] == tfa)
+			ramp_devs[i] = NULL;
+
+	if (tfa->ramp.active) {
+		tfa->ramp.active = 0;
+		complete_all(&tfa->ramp.done);
+	}
+}
+
+static void tfa_ramp_worker(struct work_struct *work)
+{
+	struct tfa_device *ntfa;
+	int i, busy;
+
+	do {
+		busy = 0;
+		mutex_lock(&ramp_lock);
+		for (i = 0; i < MAX_HANDLES; i++) {
+			ntfa = ramp_devs[i];
+			if (ntfa == NULL)
+				continue;
+
+			tfa_ramp_step(ntfa);
+			if (ntfa->ramp.active)
+				busy = 1;
+			else
+				ramp_devs[i] = NULL;
+		}
+		mutex_unlock(&ramp_lock);
+
+		if (busy)
+			usleep_range(RAMPING_INTERVAL * 1000,
+				RAMPING_INTERVAL * 1000 + 5);
+	} while (busy);
+}
+
+enum tfa98xx_error tfa_gain_ramp_start(struct tfa_device *tfa,
+	int to, int steps)
+{
+	enum tfa98xx_error err;
+	struct tfa_ramp *ramp;
+	int i, slot = -1;
+	int reg;
+
+	if (tfa == NULL) {
+		pr_err("%s: tfa is NULL\n",	__func__);
+		return TFA98XX_ERROR_DEVICE;
+	}
+	ramp = &tfa->ramp;
+
+	mutex_lock(&ramp_lock);
+	/* a new ramp takes over from where the last one is */
+	reg = TFAxx_READ_REG(tfa, AMPGAIN);
+	if (reg < 0) {
+		mutex_unlock(&ramp_lock);
+		pr_err("%s: error in reading AMPGAIN\n", __func__);
+		return -reg;
+	}
+
+	ramp->reg = (uint16_t)reg;
+	ramp->from = TFAxx_GET_BF_VALUE(tfa, AMPGAIN, ramp->reg);
+	ramp->to = to;
+	ramp->step = 0;
+	ramp->steps = steps;
+	ramp->curve = tfa->ramp_curve;
+	ramp->err = TFA98XX_ERROR_OK;
+	ramp->active = 1;
+	reinit_completion(&ramp->done);
+
+	/* the slot of the device, or a free one */
+	for (i = 0; i < MAX_HANDLES; i++) {
+		if (ramp_devs[i] == tfa) {
+			slot = i;
+			break;
+		}
+		if (ramp_devs[i] == NULL && slot < 0)
+			slot = i;
+	}
+
+	if (steps <= 0 || slot < 0) { /* direct set */
+		ramp->steps = 1;
+		tfa_ramp_step(tfa);
+		if (slot >= 0 && ramp_devs[slot] == tfa)
+			ramp_devs[slot] = NULL;
+		steps = 0;
+	} else {
+		ramp_devs[slot] = tfa;
+	}
+	err = ramp->err;
+	mutex_unlock(&ramp_lock);
+
+	if (steps > 0)
+		queue_work(system_highpri_wq, &tfa_ramp_work);
+
+	return err;
+}
+
+enum tfa98xx_error tfa_gain_ramp_wait(struct tfa_device *tfa)
+{
+	struct tfa_ramp *ramp;
+	int timeout;
+
+	if (tfa == NULL) {
+		pr_err("%s: tfa is NULL\n",	__func__);
+		return TFA98XX_ERROR_DEVICE;
+	}
+	ramp = &tfa->ramp;
+
+	mutex_lock(&ramp_lock);
+	if (!ramp->active) {
+		mutex_unlock(&ramp_lock);
+		return ramp->err;
+	}
+	timeout = ramp->steps * RAMPING_INTERVAL * 2 + BUSLOAD_INTERVAL;
+	mutex_unlock(&ramp_lock);
+
+	if (!wait_for_completion_timeout(&ramp->done,
+		msecs_to_jiffies(timeout))) {
+		pr_err("%s: ramp is not done in %d msec\n", __func__, timeout);
+		/* the engine must not step it any more */
+		mutex_lock(&ramp_lock);
+		if (ramp->active) {
+			tfa_ramp_remove(tfa);
+			ramp->err = TFA98XX_ERROR_FAIL;
+		}
+		mutex_unlock(&ramp_lock);
+	}
+
+	return ramp->err;
+}
+
+void tfa_gain_ramp_cancel(struct tfa_device *tfa)
+{
+	if (tfa == NULL)
+		return;
+
+	mutex_lock(&ramp_lock);
+	tfa_ramp_remove(tfa);
+	mutex_unlock(&ramp_lock);
+
+	/* the worker may still be in its last sleep */
+	flush_work(&tfa_ramp_work);
+}
+
 enum tfa98xx_error tfa_gain_rampdown(struct tfa_device *tfa, int count)
 {
-	enum tfa98xx_error err = TFA98XX_ERROR_OK;
-	int step = 0, cur_ampgain, value = 0;
+	enum tfa98xx_error err;
+
+	err = tfa_gain_rampdown_start(tfa, count);
+	if (err == TFA98XX_ERROR_OK)
+		err = tfa_gain_ramp_wait(tfa);
+
+	return err;
+}
+
+enum tfa98xx_error tfa_gain_rampdown_start(struct tfa_device *tfa,
+	int count)
+{
+	int cur_ampgain;
 
 	if (tfa == NULL) {
 		pr_err("%s: tfa is NULL\n",	__func__);
-		err = TFA98XX_ERROR_DEVICE;
-		return err;
+		return TFA98XX_ERROR_DEVICE;
 	}
 
 	cur_ampgain = TFAxx_GET_BF(tfa, AMPGAIN);
@@ -2723,44 +3124,14 @@ enum tfa98xx_error tfa_gain_rampdown(struct tfa_device *tfa, int count)
 		pr_debug("%s: ramp down ampgain (%d)\n",
 			__func__, tfa->ampgain);
 
-	if (tfa->ampgain == -1) {
-		pr_debug("%s: reference gain is not valid\n", __func__);
-		return TFA98XX_ERROR_BAD_PARAMETER;
-	}
-
 	/* ramp down amplifier gain for "count" msec */
-	if (count >= 0) {
-		/* stepwise set */
-		for (step = 0; step < count; step++) {
-			value = tfa->ampgain >> (step + 1);
-			err = TFAxx_SET_BF(tfa, AMPGAIN, value);
-			if (err) {
-				pr_err("%s: error in setting AMPGAIN\n",
-					__func__);
-				return err;
-			}
-
-			usleep_range(RAMPING_INTERVAL * 1000,
-				RAMPING_INTERVAL * 1000 + 5);
-		}
-		if (value > 0)
-			count = -1; /* to set 0 at final step */
-	}
-
-	if (count < 0) { /* direct set */
-		err = TFAxx_SET_BF(tfa, AMPGAIN, 0);
-		if (err)
-			pr_err("%s: error in setting AMPGAIN\n",
-				__func__);
-	}
-
-	return err;
+	return tfa_gain_ramp_start(tfa, 0, count);
 }
 
 enum tfa98xx_error tfa_gain_restore(struct tfa_device *tfa, int count)
 {
 	enum tfa98xx_error err = TFA98XX_ERROR_OK;
-	int step = 0, cur_ampgain, value = 0;
+	int cur_ampgain;
 
 	if (tfa == NULL) {
 		pr_err("%s: tfa is NULL\n",	__func__);
@@ -2771,12 +3142,7 @@ enum tfa98xx_error tfa_gain_restore(struct tfa_device *tfa, int count)
 	if (count < 0) { /* direct set */
 		pr_debug("%s: direct set ampgain (0 to %d)\n",
 			__func__, tfa->ampgain);
-		err = TFAxx_SET_BF(tfa, AMPGAIN, tfa->ampgain);
-		if (err)
-			pr_err("%s: error in setting AMPGAIN\n",
-				__func__);
-
-		return err;
+		return tfa_gain_ramp_start(tfa, tfa->ampgain, -1);
 	}
 
 	/* stepwise set */
@@ -2791,31 +3157,56 @@ enum tfa98xx_error tfa_gain_restore(struct tfa_device *tfa, int count)
 		__func__, tfa->ampgain);
 
 	/* ramp up amplifier gain for "count" msec */
-	/* stepwise set */
-	for (step = 0; step < count; step++) {
-		value = tfa->ampgain >> (count - step - 1);
-		err = TFAxx_SET_BF(tfa, AMPGAIN, value);
-		if (err) {
-			pr_err("%s: error in setting AMPGAIN\n",
-				__func__);
-			return err;
-		}
-
-		usleep_range(RAMPING_INTERVAL * 1000,
-			RAMPING_INTERVAL * 1000 + 5);
-	}
+	err = tfa_gain_ramp_start(tfa, tfa->ampgain, count);
+	if (err == TFA98XX_ERROR_OK)
+		err = tfa_gain_ramp_wait(tfa);
 
 	return err;
 }
 
-void tfa_set_spkgain(struct tfa_device *tfa)
+/*
+ * without a mixer gain, attenuate the profile gain: the register holds it
+ * unless it still holds the attenuated value written last
+ */
+static int tfa_get_spkgain_base(struct tfa_device *tfa)
 {
-	if (tfa == NULL || tfa->spkgain == -1)
-		return;
+	int value;
+
+	value = TFAxx_GET_BF(tfa, TDMSPKG);
+	if (value < 0)
+		return value;
+
+	if (tfa->spkgain_out == -1 || value != tfa->spkgain_out)
+		tfa->spkgain_base = value;
+
+	return tfa->spkgain_base;
+}
+
+enum tfa98xx_error tfa_set_spkgain(struct tfa_device *tfa)
+{
+	enum tfa98xx_error err;
+	int base, value;
+
+	if (tfa == NULL)
+		return TFA98XX_ERROR_OK;
+
+	if (tfa->spkgain == -1) {
+		if (tfa->spkgain_att == 0 && tfa->spkgain_out == -1)
+			return TFA98XX_ERROR_OK;
+		base = tfa_get_spkgain_base(tfa);
+		if (base < 0)
+			return -base;
+	} else {
+		base = tfa->spkgain;
+	}
 
-	pr_info("%s: set speaker gain %d inplev %d\n",
-		__func__, tfa->spkgain, tfa->inplev);
-	TFAxx_SET_BF(tfa, TDMSPKG, tfa->spkgain);
+	value = min(base + tfa->spkgain_att, TFA_TDMSPKG_MAX);
+	pr_info("%s: set speaker gain %d (attenuation %d) inplev %d\n",
+		__func__, base, tfa->spkgain_att, tfa->inplev);
+	err = TFAxx_SET_BF(tfa, TDMSPKG, value);
+	if (err == TFA98XX_ERROR_OK)
+		tfa->spkgain_out = (tfa->spkgain == -1 && tfa->spkgain_att)
+			? value : -1;
 
 #if 0 // not need anymore as TDMSPKG is configured by only mixer 
 	if (tfa->inplev == -1)
@@ -2829,6 +3220,8 @@ void tfa_set_spkgain(struct tfa_device *tfa)
 		break;
 	}
 #endif
+
+	return err;
 }
 
 enum tfa98xx_error tfa_wait_cal(struct tfa_device *tfa)
@@ -3007,7 +3400,7 @@ EXPORT_SYMBOL(tfa_restore_after_cal);
 int tfa_run_damage_check(struct tfa_device *tfa,
 	int dsp_event, int dsp_status)
 {
-	int damaged = 0, damage_event = 0;
+	int damaged = 0;
 	struct tfa_device *ntfa = NULL;
 	int i;
 
@@ -3027,9 +3420,6 @@ int tfa_run_damage_check(struct tfa_device *tfa,
 		if (ntfa->cal_channel == SPK_CH && ntfa->dev_idx == 0)
 			continue;
 
-		damage_event
-			= (TFA_GET_BIT_VALUE(dsp_event,
-			i + 1)) ? 1 : 0;
 		/* set damage flag with status */
 		ntfa->spkr_damaged
 			= (TFA_GET_BIT_VALUE(dsp_status,
@@ -3047,94 +3437,104 @@ int tfa_run_damage_check(struct tfa_device *tfa,
 /*
  * wait for calibrate_done
  */
-enum tfa98xx_error
-tfa_run_wait_calibration(struct tfa_device *tfa, int *calibrate_done)
+static int tfa_wait_mtpb_clear(struct tfa_device *tfa, void *data)
 {
-	enum tfa98xx_error err = TFA98XX_ERROR_OK;
-	int tries = 0, mtp_busy = 1, tries_mtp_busy = 0;
-	char buffer[2 * 3] = {0};
-	int res_len;
-	int fw_status[2] = {0};
-	int dsp_event = 0, dsp_status = 0;
-	struct tfa_device *ntfa;
-	int i;
-	int damaged = 0;
+	return tfa_dev_get_mtpb(tfa) != 1;
+}
 
-	if (tfa == NULL) {
-		pr_err("%s: tfa is NULL\n",	__func__);
-		err = TFA98XX_ERROR_DEVICE;
-		return err;
-	}
+static int tfa_wait_mtpex_set(struct tfa_device *tfa, void *data)
+{
+	return tfa_dev_mtp_get(tfa, TFA_MTP_EX) == 1;
+}
 
-	*calibrate_done = 0;
+/* read the status change of the DSP into data (int[2]) */
+static int tfa_wait_cal_status(struct tfa_device *tfa, void *data)
+{
+	enum tfa98xx_error err;
+	char buffer[2 * 3] = {0};
+	int *fw_status = data;
 
-	/* in case of calibrate once wait for MTPEX */
+	err = tfa_dsp_cmd_id_write_read(tfa, MODULE_FRAMEWORK,
+		FW_PAR_ID_GET_STATUS_CHANGE,
+		sizeof(buffer), (unsigned char *)buffer);
+	if (err != TFA98XX_ERROR_OK)
+		return -EIO;
+
+	tfa98xx_convert_bytes2data(sizeof(buffer),
+		(unsigned char *)buffer, fw_status);
+	pr_debug("%s: status (0x%06x:0x%06x)\n",
+		__func__, fw_status[0], fw_status[1]);
+
+	/* calibration done status is set */
+	return fw_status[1] & 0x1;
+}
+
+static int tfa_wait_cal_idle(struct tfa_device *tfa, void *data)
+{
+	return tfa->is_calibrating == 0;
+}
+
+/* calibration has ended: wake up who waits for it */
+static void tfa_cal_end(struct tfa_device *tfa)
+{
+	tfa->is_calibrating = 0;
+	tfa_wait_kick(tfa);
+}
+
+enum tfa98xx_error
+tfa_run_wait_calibration(struct tfa_device *tfa, int *calibrate_done)
+{
+	enum tfa98xx_error err = TFA98XX_ERROR_OK;
+	int tries = 0, tries_mtp_busy = 0, rc;
+	int fw_status[2] = {0};
+	int dsp_event = 0, dsp_status = 0;
+	struct tfa_device *ntfa;
+	int i;
+	int damaged = 0;
+
+	if (tfa == NULL) {
+		pr_err("%s: tfa is NULL\n",	__func__);
+		err = TFA98XX_ERROR_DEVICE;
+		return err;
+	}
+
+	*calibrate_done = 0;
+
+	/* in case of calibrate once wait for MTPEX */
 	if (!tfa->is_probus_device
 		&& tfa_dev_mtp_get(tfa, TFA_MTP_OTC)) {
 		/* Check if MTP_busy is clear! */
-		while (tries_mtp_busy < MTPBWAIT_TRIES) {
-			mtp_busy = tfa_dev_get_mtpb(tfa);
-			if (mtp_busy == 1)
-				/* wait 10ms to avoid busload */
-				msleep_interruptible(BUSLOAD_INTERVAL);
-			else
-				break;
-			tries_mtp_busy++;
-		}
+		rc = tfa_wait_for(tfa, TFA_WAIT_MTPB, tfa_wait_mtpb_clear,
+			NULL, MTPBWAIT_TRIES * BUSLOAD_INTERVAL);
 
-		if (tries_mtp_busy < MTPBWAIT_TRIES) {
-			/* Because of the msleep
-			 * TFA98XX_API_WAITRESULT_NTRIES is way to long!
-			 * Setting this to 25 will take
-			 * at least 25*50ms = 1.25 sec
-			 */
-			while ((*calibrate_done == 0)
-				&& (tries < MTPEX_WAIT_NTRIES)) {
-				*calibrate_done
-					= tfa_dev_mtp_get(tfa, TFA_MTP_EX);
-				if (*calibrate_done == 1)
-					break;
-				/* wait 50ms to avoid busload */
-				msleep_interruptible(5 * BUSLOAD_INTERVAL);
-				tries++;
-			}
+		if (rc == 0) {
+			/* MTPEX is set in the order of a second */
+			rc = tfa_wait_for(tfa, TFA_WAIT_MTPEX,
+				tfa_wait_mtpex_set, NULL,
+				MTPEX_WAIT_NTRIES * 5 * BUSLOAD_INTERVAL);
+			*calibrate_done = (rc == 0) ? 1 : 0;
 
-			if (tries >= MTPEX_WAIT_NTRIES)
+			if (rc == -ETIME)
 				tries = TFA98XX_API_WAITRESULT_NTRIES;
 		} else {
-			pr_err("MTP busy after %d tries\n", MTPBWAIT_TRIES);
+			tries_mtp_busy = MTPBWAIT_TRIES;
+			pr_err("MTP busy after %d ms\n",
+				MTPBWAIT_TRIES * BUSLOAD_INTERVAL);
 		}
 	}
 
-	if (tfa->is_probus_device) {
-		res_len = 2 * 3;
-
-		while ((*calibrate_done != 1)
-			&& (tries < TFA98XX_API_WAITCAL_NTRIES)) {
-			msleep_interruptible(CAL_STATUS_INTERVAL);
-
-			err = tfa_dsp_cmd_id_write_read
-				(tfa, MODULE_FRAMEWORK,
-				FW_PAR_ID_GET_STATUS_CHANGE,
-				res_len, (unsigned char *)buffer);
-			if (err != TFA98XX_ERROR_OK)
-				break;
-
-			tfa98xx_convert_bytes2data(res_len,
-				buffer, fw_status);
-			dsp_event = fw_status[0];
-			dsp_status = fw_status[1];
-			pr_debug("%s: err (%d), status (0x%06x:0x%06x), count (%d)\n",
-				__func__, err,
-				dsp_event, dsp_status,
-				tries + 1);
-
-			/* wait until calibration done status is set */
-			if (!(dsp_status & 0x1)) {
-				tries++;
-				continue;
-			}
+	if (tfa->is_probus_device && *calibrate_done != 1) {
+		/*
+		 * woken up by TFADSP_CALIBRATE_DONE (or the interrupt),
+		 * polling the status at a growing interval otherwise
+		 */
+		rc = tfa_wait_for(tfa, TFA_WAIT_CAL, tfa_wait_cal_status,
+			fw_status,
+			TFA98XX_API_WAITCAL_NTRIES * CAL_STATUS_INTERVAL);
+		dsp_event = fw_status[0];
+		dsp_status = fw_status[1];
 
+		if (rc == 0) {
 			*calibrate_done = 1;
 
 			if ((dsp_status & 0x6) != 0) /* damage status */
@@ -3143,11 +3543,9 @@ tfa_run_wait_calibration(struct tfa_device *tfa, int *calibrate_done)
 
 			if (damaged)
 				*calibrate_done = 0; /* failure */
-			break;
-		}
-
-		if (tries >= TFA98XX_API_WAITCAL_NTRIES)
+		} else if (rc == -ETIME) {
 			tries = TFA98XX_API_WAITRESULT_NTRIES;
+		}
 	}
 
 	if (*calibrate_done != 1) {
@@ -3175,7 +3573,7 @@ tfa_run_wait_calibration(struct tfa_device *tfa, int *calibrate_done)
 			if (ntfa == NULL)
 				continue;
 
-			ntfa->is_calibrating = 0;
+			tfa_cal_end(ntfa);
 			ntfa->spkr_damaged = 0;
 		}
 
@@ -3191,7 +3589,7 @@ tfa_run_wait_calibration(struct tfa_device *tfa, int *calibrate_done)
 		for (i = 0; i < tfa->dev_count; i++) {
 			ntfa = tfa98xx_get_tfa_device_from_channel(i);
 			if (ntfa != NULL)
-				ntfa->is_calibrating = 0;
+				tfa_cal_end(ntfa);
 		}
 		return err;
 	}
@@ -3202,7 +3600,7 @@ tfa_run_wait_calibration(struct tfa_device *tfa, int *calibrate_done)
 		if (ntfa == NULL)
 			continue;
 
-		ntfa->is_calibrating = 0;
+		tfa_cal_end(ntfa);
 		ntfa->spkr_damaged
 			= (TFA_GET_BIT_VALUE(fw_status[1], i + 1))
 			? 1 : 0;
@@ -3240,7 +3638,8 @@ tfa_check_speaker_damage(struct tfa_device *tfa)
 	if (err != TFA98XX_ERROR_OK)
 		return err;
 
-	tfa98xx_convert_bytes2data(res_len, buffer, fw_status);
+	tfa98xx_convert_bytes2data(res_len,
+		(unsigned char *)buffer, fw_status);
 	dsp_event = fw_status[0];
 	dsp_status = fw_status[1];
 	pr_info("%s: status (0x%06x:0x%06x)\n",
@@ -3280,7 +3679,7 @@ void tfa_set_active_handle(struct tfa_device *tfa, int profile)
 	if (count == tfa->dev_count)
 		active_handle = 0xf;
 
-	pr_info("%s: active handle: 0x%x, active count %d\n",
+	pr_debug("%s: active handle: 0x%x, active count %d\n",
 		__func__, active_handle, count);
 
 	for (dev = 0; dev < tfa->dev_count; dev++) {
@@ -3413,6 +3812,7 @@ enum tfa_error tfa_dev_start(struct tfa_device *tfa,
 		__func__, tfa98xx_log_start_cnt, next_profile);
 
 	tfa->next_profile = next_profile;
+	tfa_phase_begin(tfa, TFA_PHASE_START);
 	tfa->swprof = -1; /* reset to read */
 	tfa_dev_get_swprof(tfa);
 
@@ -3622,6 +4022,8 @@ tfa_dev_start_exit:
 	if (err != TFA98XX_ERROR_OK)
 		ret = tfa_convert_error_code(err);
 
+	tfa_phase_end(tfa, TFA_PHASE_START, ret);
+
 	return ret;
 }
 
@@ -3654,9 +4056,13 @@ enum tfa_error tfa_dev_switch_profile(struct tfa_device *tfa,
 			tfa->blackbox_config_msg = 0; /* reset */
 		}
 
+		tfa_dev_save_fingerprint(tfa, 0);
+		tfa_phase_begin(tfa, TFA_PHASE_PROF_REGS);
 		err = tfa_cont_write_profile(tfa, next_profile, vstep);
+		tfa_phase_end(tfa, TFA_PHASE_PROF_REGS, err);
 		if (err != TFA98XX_ERROR_OK)
 			return tfa_error_other;
+		tfa_dev_save_prof_fingerprint(tfa, next_profile);
 	}
 
 	/* If the profile contains the .standby suffix go
@@ -3691,27 +4097,99 @@ enum tfa_error tfa_dev_switch_profile(struct tfa_device *tfa,
 	return ret;
 }
 
+enum tfa_error tfa_dev_prewarm(struct tfa_device *tfa, int profile)
+{
+	enum tfa98xx_error err;
+
+	if (tfa == NULL) {
+		pr_err("%s: tfa is NULL\n",	__func__);
+		return tfa_error_device;
+	}
+
+	/* with a stream, tfa_run_startup() would go on to INIT_CF */
+	if (tfa98xx_count_active_stream(BIT_PSTREAM) > 0
+		|| tfa98xx_count_active_stream(BIT_CSTREAM) > 0)
+		return tfa_error_ok;
+
+	mutex_lock(&dev_lock);
+	tfa->prewarm_profile = -1;
+	tfa->first_after_boot = 1; /* write the full configuration */
+	err = tfa_run_startup(tfa, profile);
+	if (err == TFA98XX_ERROR_OK)
+		tfa->prewarm_profile = profile;
+	mutex_unlock(&dev_lock);
+
+	return tfa_convert_error_code(err);
+}
+
+enum tfa_error tfa_dev_prewarm_drop(struct tfa_device *tfa)
+{
+	if (tfa == NULL) {
+		pr_err("%s: tfa is NULL\n",	__func__);
+		return tfa_error_device;
+	}
+
+	if (tfa->prewarm_profile < 0)
+		return tfa_error_ok;
+
+	pr_info("%s: dev %d, no start at profile %d\n",
+		__func__, tfa->dev_idx, tfa->prewarm_profile);
+	tfa->prewarm_profile = -1;
+
+	return tfa_dev_stop_powerdown(tfa);
+}
+
 enum tfa_error tfa_dev_stop(struct tfa_device *tfa)
 {
-	enum tfa_error ret = tfa_error_ok;
-	enum tfa98xx_error err = TFA98XX_ERROR_OK;
+	enum tfa_error ret;
+
+	ret = tfa_dev_stop_ramp(tfa);
+	if (ret != tfa_error_ok)
+		return ret;
+
+	ret = tfa_dev_stop_powerdown(tfa);
+	if (ret != tfa_error_ok)
+		return ret;
+
+	msleep_interruptible(TFA_STOP_SETTLE_MS);
+
+	return tfa_dev_stop_done(tfa);
+}
+
+enum tfa_error tfa_dev_stop_ramp(struct tfa_device *tfa)
+{
 	int ramp_steps;
 
 	if (tfa == NULL) {
 		pr_err("%s: tfa is NULL\n",	__func__);
-		ret = tfa_error_device;
-		return ret;
+		return tfa_error_device;
 	}
 
 	pr_info("Stopping device [%s]\n",
 		tfa_cont_device_name(tfa->cnt, tfa->dev_idx));
 
-	/* mute */
+	/* mute: start ramping down */
 	ramp_steps = tfa->ramp_steps;
 	tfa->ramp_steps = RAMPDOWN_SHORT;
-	err = tfa_run_mute(tfa);
+	tfa_run_mute_ramp(tfa);
 	tfa->ramp_steps = ramp_steps;
 
+	return tfa_error_ok;
+}
+
+enum tfa_error tfa_dev_stop_powerdown(struct tfa_device *tfa)
+{
+	enum tfa_error ret = tfa_error_ok;
+	enum tfa98xx_error err = TFA98XX_ERROR_OK;
+
+	if (tfa == NULL) {
+		pr_err("%s: tfa is NULL\n",	__func__);
+		return tfa_error_device;
+	}
+
+	/* mute, when ramped down */
+	tfa_run_mute_wait(tfa);
+
 	/* Make sure internal oscillator is not running
 	 * for DSP devices (non-dsp and max1 this is no-op)
 	 */
@@ -3719,10 +4197,24 @@ enum tfa_error tfa_dev_stop(struct tfa_device *tfa)
 
 	/* powerdown CF */
 	err = tfa98xx_powerdown(tfa, 1);
-	if (err != TFA98XX_ERROR_OK)
-		goto tfa_dev_stop_exit;
+	if (err != TFA98XX_ERROR_OK) {
+		ret = tfa_convert_error_code(err);
+		pr_err("%s: error (%d) in device stop\n",
+				__func__, ret);
+	}
+
+	return ret;
+}
+
+enum tfa_error tfa_dev_stop_done(struct tfa_device *tfa)
+{
+	enum tfa_error ret = tfa_error_ok;
+	enum tfa98xx_error err = TFA98XX_ERROR_OK;
 
-	msleep_interruptible(BUSLOAD_INTERVAL);
+	if (tfa == NULL) {
+		pr_err("%s: tfa is NULL\n",	__func__);
+		return tfa_error_device;
+	}
 
 	/* CHECK: only once after buffering fully */
 	/* at last device only: to flush buffer */
@@ -3754,7 +4246,6 @@ enum tfa_error tfa_dev_stop(struct tfa_device *tfa)
 		tfa_reset_active_handle(tfa);
 	}
 
-tfa_dev_stop_exit:
 	if (err != TFA98XX_ERROR_OK) {
 		ret = tfa_convert_error_code(err);
 		pr_err("%s: error (%d) in device stop\n",
@@ -3768,6 +4259,17 @@ tfa_dev_stop_exit:
 	return ret;
 }
 
+static int tfa_wait_powerdown(struct tfa_device *tfa, void *data)
+{
+	int state = tfa_get_manstate(tfa);
+
+	if (state < 0)
+		return -EIO;
+
+	/* Check for MANSTATE=Powerdown (0) */
+	return state == 0;
+}
+
 /*
  * int registers and coldboot dsp
  */
@@ -3775,7 +4277,6 @@ int tfa_reset(struct tfa_device *tfa)
 {
 	enum tfa98xx_error err = TFA98XX_ERROR_OK;
 	int state = -1;
-	int retry_cnt = 0;
 
 	if (tfa == NULL) {
 		pr_err("%s: tfa is NULL\n",	__func__);
@@ -3860,18 +4361,10 @@ int tfa_reset(struct tfa_device *tfa)
 			return err;
 
 		/* Powerdown state should be reached within 1ms */
-		for (retry_cnt = 0;
-			retry_cnt < TFA98XX_WAITRESULT_NTRIES;
-			retry_cnt++) {
-			state = tfa_get_manstate(tfa);
-			if (state < 0)
-				return err;
-
-			/* Check for MANSTATE=Powerdown (0) */
-			if (state == 0)
-				break;
-			msleep_interruptible(BUSLOAD_INTERVAL);
-		}
+		if (tfa_wait_for(tfa, TFA_WAIT_POWERDOWN,
+			tfa_wait_powerdown, NULL,
+			TFA98XX_WAITRESULT_NTRIES * BUSLOAD_INTERVAL) == -EIO)
+			return err;
 
 		/* Reset all I2C registers to default values,
 		 * now device state is consistent, same as after powerup
@@ -4139,6 +4632,214 @@ int tfa_is_cold_amp(struct tfa_device *tfa)
 	return value;
 }
 
+/*
+ * fingerprint of the device configuration: container CRC, device index
+ * and the configuration registers; never 0, the reset value
+ * @return fingerprint, or -1 if it cannot be computed
+ */
+static int tfa_calc_fingerprint(struct tfa_device *tfa)
+{
+	unsigned short value;
+	uint32_t crc;
+	int i;
+
+	if (tfa->cnt == NULL)
+		return -1;
+
+	crc = crc32_le(~0u, (uint8_t *)&tfa->cnt->crc, sizeof(tfa->cnt->crc));
+	crc = crc32_le(crc, (uint8_t *)&tfa->dev_idx, sizeof(tfa->dev_idx));
+	for (i = 0; i < (int)ARRAY_SIZE(tfa_fingerprint_regs); i++) {
+		if (reg_read(tfa, tfa_fingerprint_regs[i], &value))
+			return -1;
+		crc = crc32_le(crc, (uint8_t *)&value, sizeof(value));
+	}
+
+	crc = (crc ^ (crc >> 16)) & 0xffff;
+
+	return (crc != 0) ? (int)crc : 1;
+}
+
+int tfa_dev_match_fingerprint(struct tfa_device *tfa)
+{
+	int stored, value;
+
+	if (tfa == NULL || !tfa->dev_ops.get_fingerprint)
+		return 0;
+
+	stored = (tfa->dev_ops.get_fingerprint)(tfa);
+	if (stored <= 0)
+		return 0;
+
+	value = tfa_calc_fingerprint(tfa);
+	pr_debug("%s: dev %d, fingerprint 0x%04x (stored 0x%04x)\n",
+		__func__, tfa->dev_idx, value, stored);
+
+	return value == stored;
+}
+
+void tfa_dev_save_fingerprint(struct tfa_device *tfa, int valid)
+{
+	int value = 0;
+
+	if (tfa == NULL || !tfa->dev_ops.set_fingerprint)
+		return;
+
+	if (valid) {
+		value = tfa_calc_fingerprint(tfa);
+		if (value < 0)
+			value = 0;
+	}
+
+	(tfa->dev_ops.set_fingerprint)(tfa, (uint16_t)value);
+}
+
+void tfa_dev_save_prof_fingerprint(struct tfa_device *tfa, int profile)
+{
+	int value;
+
+	if (tfa == NULL || !tfa->dev_ops.set_fingerprint)
+		return;
+
+	if (profile < 0 || profile >= TFA_FINGERPRINT_PROFS) {
+		tfa_dev_save_fingerprint(tfa, 1);
+		return;
+	}
+
+	/* the registers are read at the first switch to the profile only */
+	if (tfa->prof_fingerprint[profile] == 0) {
+		value = tfa_calc_fingerprint(tfa);
+		if (value < 0)
+			value = 0;
+		tfa->prof_fingerprint[profile] = (uint16_t)value;
+	}
+
+	(tfa->dev_ops.set_fingerprint)(tfa, tfa->prof_fingerprint[profile]);
+}
+
+static const char * const tfa_phase_names[TFA_PHASE_MAX] = {
+	"start", "reg_init", "prof_regs", "files", "dsp_msg",
+	"init_cf", "cal_values", "sync", "unmute"
+};
+
+const char *tfa_phase_name(int phase)
+{
+	if (phase < 0 || phase >= TFA_PHASE_MAX)
+		return "unknown";
+
+	return tfa_phase_names[phase];
+}
+
+void tfa_phase_begin(struct tfa_device *tfa, int phase)
+{
+	ktime_t now;
+
+	if (tfa == NULL || phase < 0 || phase >= TFA_PHASE_MAX)
+		return;
+
+	now = ktime_get();
+	if (phase == TFA_PHASE_START) {
+		tfa->start_seq++;
+		tfa->start_profile = tfa->next_profile;
+		tfa->start_time = now;
+	}
+	tfa->phase_begin[phase] = now;
+}
+
+void tfa_phase_end(struct tfa_device *tfa, int phase, int err)
+{
+	struct tfa_phase_stat *stat;
+	ktime_t now;
+	s64 us;
+
+	if (tfa == NULL || phase < 0 || phase >= TFA_PHASE_MAX)
+		return;
+	if (tfa->phase_begin[phase] == 0)
+		return; /* not begun */
+
+	now = ktime_get();
+	us = ktime_us_delta(now, tfa->phase_begin[phase]);
+
+	stat = &tfa->phase_stat[phase];
+	stat->count++;
+	if (err)
+		stat->errors++;
+	stat->last_us = (unsigned int)us;
+	if (stat->last_us > stat->max_us)
+		stat->max_us = stat->last_us;
+	stat->offset_us = (unsigned int)ktime_us_delta(tfa->phase_begin[phase],
+		tfa->start_time);
+	stat->total_us += us;
+	tfa->phase_begin[phase] = 0;
+
+	trace_tfa98xx_phase(tfa->dev_idx, tfa->start_profile,
+		tfa->start_seq, phase, us, err);
+}
+
+void tfa_phase_reset(struct tfa_device *tfa)
+{
+	if (tfa == NULL)
+		return;
+
+	memset(tfa->phase_stat, 0, sizeof(tfa->phase_stat));
+}
+
+static const char * const tfa_event_names[TFA_EVENT_MAX] = {
+	[TFA_EVENT_STATE] = "state",
+	[TFA_EVENT_DSP_MSG] = "dsp_msg",
+	[TFA_EVENT_REG_WRITE] = "reg_write",
+	[TFA_EVENT_IRQ] = "irq",
+	[TFA_EVENT_TSPKR] = "tspkr",
+	[TFA_EVENT_ERROR] = "error",
+};
+
+const char *tfa_event_name(int type)
+{
+	if (type < 0 || type >= TFA_EVENT_MAX)
+		return "unknown";
+
+	return tfa_event_names[type];
+}
+
+void tfa_event_log(struct tfa_device *tfa, int type, int arg0, int arg1)
+{
+	struct tfa_event *ev;
+	unsigned int slot;
+
+	if (tfa == NULL)
+		return;
+
+	switch (type) {
+	case TFA_EVENT_STATE:
+		trace_tfa98xx_state(tfa->dev_idx, arg0, arg1);
+		break;
+	case TFA_EVENT_DSP_MSG:
+		trace_tfa98xx_dsp_msg(tfa->dev_idx, arg0, arg1);
+		break;
+	case TFA_EVENT_REG_WRITE:
+		trace_tfa98xx_reg_write(tfa->dev_idx, arg0, arg1);
+		return; /* not kept in the ring */
+	case TFA_EVENT_IRQ:
+		trace_tfa98xx_irq(tfa->dev_idx, arg0);
+		break;
+	case TFA_EVENT_TSPKR:
+		trace_tfa98xx_tspkr(arg0, arg1);
+		break;
+	case TFA_EVENT_ERROR:
+		trace_tfa98xx_error(tfa->dev_idx, arg0, arg1);
+		break;
+	default:
+		return;
+	}
+
+	/* claim a slot: writers never wait for each other or a reader */
+	slot = (unsigned int)atomic_inc_return(&tfa->events.head) - 1;
+	ev = &tfa->events.ev[slot & (TFA_EVENT_RING_SIZE - 1)];
+	ev->time_ns = ktime_to_ns(ktime_get());
+	ev->type = (u16)type;
+	ev->arg0 = (u16)arg0;
+	ev->arg1 = arg1;
+}
+
 int tfa_count_status_flag(struct tfa_device *tfa, int type)
 {
 	struct tfa_device *ntfa = NULL;
@@ -4242,25 +4943,6 @@ int tfa_cf_enabled(struct tfa_device *tfa)
 	return value;
 }
 
-#define NR_COEFFS 6
-#define NR_BIQUADS 28
-#define BQ_SIZE (3 * NR_COEFFS)
-#define DSP_MSG_OVERHEAD 27
-
-#pragma pack(push, 1)
-struct dsp_msg_all_coeff {
-	uint8_t select_eq[3];
-	uint8_t biquad[NR_BIQUADS][NR_COEFFS][3];
-};
-#pragma pack(pop)
-
-/* number of biquads for each equalizer */
-static const int eq_biquads[] = {
-	10, 10, 2, 2, 2, 2
-};
-
-#define NR_EQ (int)(sizeof(eq_biquads) / sizeof(int))
-
 /* fill context info */
 int tfa_dev_probe(int resp_addr, struct tfa_device *tfa)
 {
@@ -4310,6 +4992,7 @@ int tfa_dev_probe(int resp_addr, struct tfa_device *tfa)
 	tfa->mute_state = 0; /* unmute by default */
 	tfa->pause_state = 0; /* not paused by default */
 	tfa->spkgain = -1; /* undefined */
+	tfa->spkgain_out = -1; /* not attenuated */
 	tfa->inplev = -1; /* undefined */
 
 	tfa_set_query_info(tfa);
@@ -4361,8 +5044,7 @@ enum tfa_error tfa_dev_set_state(struct tfa_device *tfa,
 	enum tfa_state state, int is_calibration)
 {
 	enum tfa98xx_error ret = TFA98XX_ERROR_OK;
-	int loop = 50, ready = 0;
-	int count;
+	int rc;
 	int get_state;
 
 	if (tfa == NULL) {
@@ -4370,9 +5052,6 @@ enum tfa_error tfa_dev_set_state(struct tfa_device *tfa,
 		return tfa_error_device;
 	}
 
-	pr_info("%s: [%d] state = 0x%02x\n",
-		__func__, tfa->dev_idx, state & 0xff);
-
 	/* Base states */
 	/* Do not change the order of setting bits as this is important! */
 	switch (state & 0x0f) {
@@ -4388,16 +5067,18 @@ enum tfa_error tfa_dev_set_state(struct tfa_device *tfa,
 			TFA_SET_BF(tfa, MANSCONF, 1);
 
 		/* And finally set PWDN to 0 to leave powerdown state */
+		tfa_phase_begin(tfa, TFA_PHASE_INIT_CF);
 		TFA_SET_BF(tfa, PWDN, 0);
 
 		/* Make sure the DSP is running! */
-		do {
-			ret = tfa98xx_dsp_system_stable(tfa, &ready);
-			if (ret != TFA98XX_ERROR_OK)
-				return tfa_error_dsp;
-			if (ready)
-				break;
-		} while (loop--);
+		rc = tfa_wait_for(tfa, TFA_WAIT_DSP_STABLE,
+			tfa_wait_dsp_stable, &ret, DSPSTABLE_WAIT_MS);
+		tfa_phase_end(tfa, TFA_PHASE_INIT_CF, rc);
+		if (ret != TFA98XX_ERROR_OK) {
+			tfa_event_log(tfa, TFA_EVENT_ERROR,
+				TFA_EVENT_STATE, ret);
+			return tfa_error_dsp;
+		}
 
 		if ((!tfa->is_probus_device && is_calibration)
 			|| ((tfa->rev & 0xff) == 0x13)) {
@@ -4427,17 +5108,15 @@ enum tfa_error tfa_dev_set_state(struct tfa_device *tfa,
 		 * (This should be case only during calibration).
 		 */
 		if (!tfa->is_probus_device && is_calibration) {
-			count = MTPEX_WAIT_NTRIES * 4;
+			rc = 0;
 			if (tfa_dev_mtp_get(tfa, TFA_MTP_OTC) == 1
-				&& tfa->tfa_family == 2) {
+				&& tfa->tfa_family == 2)
 				/* Calibration takes a lot of time */
-				while ((tfa_dev_mtp_get(tfa, TFA_MTP_EX) != 1)
-					&& count) {
-					msleep_interruptible(BUSLOAD_INTERVAL);
-					count--;
-				}
-			}
-			if (count <= 0)
+				rc = tfa_wait_for(tfa, TFA_WAIT_MTPEX,
+					tfa_wait_mtpex_set, NULL,
+					MTPEX_WAIT_NTRIES * 4
+					* BUSLOAD_INTERVAL);
+			if (rc == -ETIME)
 				pr_err("%s: MTPEX is not set - timeout\n",
 					__func__);
 
@@ -4468,17 +5147,19 @@ enum tfa_error tfa_dev_set_state(struct tfa_device *tfa,
 		tfa98xx_set_mute(tfa, TFA98XX_MUTE_AMPLIFIER);
 
 	if (state & TFA_STATE_UNMUTE) {
-		if (tfa->mute_state)
-			pr_info("%s: skip UNMUTE dev %d (by force)\n",
+		if (tfa->mute_state) {
+			pr_debug("%s: skip UNMUTE dev %d (by force)\n",
 				__func__, tfa->dev_idx);
-		else
-			tfa98xx_set_mute(tfa, TFA98XX_MUTE_OFF);
+		} else {
+			tfa_phase_begin(tfa, TFA_PHASE_UNMUTE);
+			ret = tfa98xx_set_mute(tfa, TFA98XX_MUTE_OFF);
+			tfa_phase_end(tfa, TFA_PHASE_UNMUTE, ret);
+		}
 	}
 
 	/* tfa->state = state; */ /* to correct with real state of device */
 	get_state = tfa_dev_get_state(tfa);
-	if (get_state != state)
-		pr_debug("%s: set_state %d, get_state %d\n", __func__, state, get_state);
+	tfa_event_log(tfa, TFA_EVENT_STATE, state & 0xff, get_state);
 
 	return tfa_error_ok;
 }
@@ -4568,6 +5249,7 @@ enum tfa_error tfa_dev_mtp_set(struct tfa_device *tfa,
 		if (value == 0) {
 			tfa->mohm[0] = 0;
 			tfa->reset_mtpex = 0;
+			tfa->cal_store.stamp = 0; /* to calibrate again */
 		} else {
 			if (tfa->mohm[0] <= 0) {
 				rdc = 6000; /* hard-coded */
@@ -4588,6 +5270,8 @@ enum tfa_error tfa_dev_mtp_set(struct tfa_device *tfa,
 			}
 		}
 		/* write RE25, calibration data */
+		if (value != tfa->cal_store.re25)
+			tfa->cal_store.stamp = 0; /* superseded */
 		tfa->mohm[0] = value;
 		pr_info("%s: ch. %d, mohm[0] %d\n", __func__, 
 			tfa_get_channel_from_dev_idx(tfa, -1), tfa->mohm[0]);
@@ -4627,6 +5311,14 @@ int tfa_reset_sticky_bits(struct tfa_device *tfa)
 	pr_debug("%s: read sticky bits: (STATUS_FLAGS0 0x%04x, STATUS_FLAGS3 0x%04x)\n",
 		__func__, status0, status3);
 
+	return tfa_clear_sticky_bits(tfa, status0, status3);
+}
+
+int tfa_clear_sticky_bits(struct tfa_device *tfa,
+	uint16_t status0, uint16_t status3)
+{
+	enum tfa98xx_error err = TFA98XX_ERROR_OK;
+
 	/* reset by writing on the flag */
 	switch (tfa->rev & 0xff) {
 	case 0x66:
@@ -4742,7 +5434,7 @@ enum tfa98xx_error tfaxx_status(struct tfa_device *tfa)
 		return -value;
 	val = (uint16_t)value;
 
-	pr_info("%s: manstate %d, ampstate %d\n", __func__,
+	pr_debug("%s: manstate %d, ampstate %d\n", __func__,
 		TFAxx_GET_BF_VALUE(tfa, MANSTATE, val),
 		TFAxx_GET_BF_VALUE(tfa, AMPSTE, val));
 
@@ -4753,7 +5445,7 @@ enum tfa98xx_error tfaxx_status(struct tfa_device *tfa)
 
 	if (!TFAxx_GET_BF_VALUE(tfa, SWS, val)) {
 		if (idle_power)
-			pr_info("%s: idle power disabled amplifier\n",
+			pr_debug("%s: idle power disabled amplifier\n",
 				__func__);
 		else
 			pr_err("%s: ERROR: SWS\n", __func__);
@@ -4767,7 +5459,7 @@ enum tfa98xx_error tfaxx_status(struct tfa_device *tfa)
 		if (TFAxx_GET_BF(tfa, TDMERR)) {
 			if ((low_power || idle_power)
 				&& TFAxx_GET_BF(tfa, TDMSTAT) == 0x7)
-				pr_info("%s: low power disabled sensing block\n",
+				pr_debug("%s: low power disabled sensing block\n",
 					__func__);
 			else
 				pr_err("%s: TDM related errors: STATUS_FLAG1 = 0x%x, STATUS_FLAG2 = 0x%x\n",
@@ -4796,27 +5488,148 @@ enum tfa98xx_error tfaxx_status(struct tfa_device *tfa)
 	return TFA98XX_ERROR_OK;
 }
 
+static const struct {
+	const char *name;
+	unsigned int min_us; /* first and post-kick poll interval */
+	unsigned int max_us; /* cap of the poll interval */
+	int event; /* kicked by a DSP event, even without interrupt */
+} tfa_wait_sites[TFA_WAIT_MAX] = {
+	[TFA_WAIT_MANSTATE] = {"manstate",
+		WAIT_MIN_INTERVAL_US, 1000},
+	[TFA_WAIT_CF_STABLE] = {"cf_stable",
+		WAIT_MIN_INTERVAL_US, BUSLOAD_INTERVAL * 1000},
+	[TFA_WAIT_DSP_STABLE] = {"dsp_stable",
+		WAIT_MIN_INTERVAL_US, 1000},
+	[TFA_WAIT_MTPB] = {"mtpb",
+		WAIT_MIN_INTERVAL_US, BUSLOAD_INTERVAL * 1000},
+	[TFA_WAIT_MTPEX] = {"mtpex",
+		WAIT_MIN_INTERVAL_US, 5 * BUSLOAD_INTERVAL * 1000},
+	[TFA_WAIT_POWERDOWN] = {"powerdown",
+		WAIT_MIN_INTERVAL_US, BUSLOAD_INTERVAL * 1000},
+	/* each poll is a DSP message: no bursts, not even after a kick */
+	[TFA_WAIT_CAL] = {"cal",
+		WAIT_EVENT_INTERVAL_US, CAL_STATUS_INTERVAL * 1000, 1},
+	[TFA_WAIT_CAL_IDLE] = {"cal_idle",
+		WAIT_EVENT_INTERVAL_US, CAL_STATUS_INTERVAL * 1000, 1},
+};
+
+const char *tfa_wait_site_name(int site)
+{
+	if (site < 0 || site >= TFA_WAIT_MAX)
+		return "unknown";
+
+	return tfa_wait_sites[site].name;
+}
+
+int tfa_wait_for(struct tfa_device *tfa, int site,
+	int (*done)(struct tfa_device *tfa, void *data), void *data,
+	int timeout_ms)
+{
+	struct tfa_wait_stat *stat;
+	unsigned int interval;
+	unsigned int polls = 0, early = 0;
+	ktime_t start, deadline;
+	s64 us;
+	int rc, kicked;
+
+	if (tfa == NULL || done == NULL || site < 0 || site >= TFA_WAIT_MAX)
+		return -EINVAL;
+
+	interval = tfa_wait_sites[site].min_us;
+	start = ktime_get();
+	deadline = ktime_add_ms(start, timeout_ms);
+	kicked = tfa->wait_irq || tfa_wait_sites[site].event;
+	if (kicked)
+		reinit_completion(&tfa->wait_event);
+
+	for (;;) {
+		polls++;
+		rc = done(tfa, data);
+		if (rc) {
+			rc = (rc > 0) ? 0 : rc;
+			break;
+		}
+		if (ktime_after(ktime_get(), deadline)) {
+			rc = -ETIME;
+			break;
+		}
+
+		/* sleep on the interrupt once the interval reaches a tick */
+		if (kicked && interval >= jiffies_to_usecs(1)) {
+			if (wait_for_completion_timeout(&tfa->wait_event,
+				usecs_to_jiffies(interval))) {
+				reinit_completion(&tfa->wait_event);
+				early++;
+				/* the state is moving: poll closely again */
+				interval = tfa_wait_sites[site].min_us;
+				continue;
+			}
+		} else {
+			usleep_range(interval, interval + interval / 4);
+		}
+		interval = min(interval * 2, tfa_wait_sites[site].max_us);
+	}
+
+	us = ktime_us_delta(ktime_get(), start);
+	stat = &tfa->wait_stat[site];
+	stat->count++;
+	if (rc == -ETIME)
+		stat->timeouts++;
+	stat->early += early;
+	stat->polls += polls;
+	stat->last_us = (unsigned int)us;
+	if (stat->last_us > stat->max_us)
+		stat->max_us = stat->last_us;
+	stat->total_us += us;
+
+	return rc;
+}
+
+void tfa_wait_kick(struct tfa_device *tfa)
+{
+	if (tfa == NULL)
+		return;
+
+	complete(&tfa->wait_event);
+}
+
+void tfa_wait_reset(struct tfa_device *tfa)
+{
+	if (tfa == NULL)
+		return;
+
+	memset(tfa->wait_stat, 0, sizeof(tfa->wait_stat));
+}
+
+struct tfa_wait_bf {
+	uint16_t bf;
+	uint16_t value;
+};
+
+static int tfa_wait_bf_reached(struct tfa_device *tfa, void *data)
+{
+	struct tfa_wait_bf *wait = data;
+
+	return tfa_get_bf(tfa, wait->bf) >= wait->value;
+}
+
 int tfa_wait4manstate(struct tfa_device *tfa,
-	uint16_t bf, uint16_t wait_value, int loop)
+	uint16_t bf, uint16_t wait_value, int timeout_ms)
 {
-	/* TODO: use tfa->reg_time */
-	int value, rc;
-	int loop_arg = loop;
+	struct tfa_wait_bf wait = {bf, wait_value};
+	int rc;
 
 	if (tfa == NULL) {
 		pr_err("%s: tfa is NULL\n",	__func__);
 		return 0;
 	}
 
-	do {
-		value = tfa_get_bf(tfa, bf); /* read */
-	} while (value < wait_value && --loop);
-
-	rc = loop ? 0 : -ETIME;
+	rc = tfa_wait_for(tfa, TFA_WAIT_MANSTATE,
+		tfa_wait_bf_reached, &wait, timeout_ms);
 
 	if (rc == -ETIME)
-		pr_err("%s: timeout waiting for bitfield:0x%04x, value:%d, %d times\n",
-			__func__, bf, wait_value, loop_arg);
+		pr_err("%s: timeout waiting for bitfield:0x%04x, value:%d, %d ms\n",
+			__func__, bf, wait_value, timeout_ms);
 
 	return rc;
 }
@@ -4824,6 +5637,7 @@ int tfa_wait4manstate(struct tfa_device *tfa,
 int tfa_ext_event_handler(enum tfadsp_event_en tfadsp_event)
 {
 	int dirt_flag = 0;
+	int i;
 
 	pr_info("%s: tfadsp event 0x%04x\n", __func__, tfadsp_event);
 
@@ -4844,7 +5658,9 @@ int tfa_ext_event_handler(enum tfadsp_event_en tfadsp_event)
 		dirt_flag = 1;
 	}
 	if (tfadsp_event & TFADSP_CALIBRATE_DONE) {
-		/* action for TFADSP_CALIBRATE_DONE */
+		/* wake up the calibration to read its status */
+		for (i = 0; i < MAX_HANDLES; i++)
+			tfa_wait_kick(tfa98xx_get_tfa_device_from_index(i));
 		dirt_flag = 1;
 	}
 	if (tfadsp_event & TFADSP_SPARSESIG_DETECTED) {
@@ -4903,8 +5719,6 @@ tfa_calibration_range_check(struct tfa_device *tfa,
 
 int tfa_wait_until_calibration_done(struct tfa_device *tfa)
 {
-	int tries = 0;
-
 	if (tfa == NULL) {
 		pr_err("%s: tfa is NULL\n",	__func__);
 		return 0;
@@ -4915,12 +5729,9 @@ int tfa_wait_until_calibration_done(struct tfa_device *tfa)
 
 	pr_info("%s: calibration / V validation now runs\n",
 		__func__);
-	while (tries < TFA98XX_API_WAITCAL_NTRIES) {
-		msleep_interruptible(CAL_STATUS_INTERVAL);
-		if (tfa->is_calibrating == 0)
-			return 1; /* done */
-		tries++;
-	}
+	if (tfa_wait_for(tfa, TFA_WAIT_CAL_IDLE, tfa_wait_cal_idle, NULL,
+		TFA98XX_API_WAITCAL_NTRIES * CAL_STATUS_INTERVAL) == 0)
+		return 1; /* done */
 
 	return 0; /* timeout */
 }
@@ -5003,7 +5814,7 @@ enum tfa98xx_error tfa_configure_log2(int enable)
 	return err;
 }
 
-enum tfa98xx_error tfa_update_log(void)
+enum tfa98xx_error tfa_update_log_sample(struct tfa_log_sample *sample)
 {
 	enum tfa98xx_error err = TFA98XX_ERROR_OK;
 	struct tfa_device *tfa = NULL, *ntfa = NULL;
@@ -5019,7 +5830,7 @@ enum tfa98xx_error tfa_update_log(void)
 		return TFA98XX_ERROR_DEVICE; /* unused device */
 
 	if (!tfa->blackbox_enable) {
-		pr_info("%s: blackbox is inactive\n", __func__);
+		pr_debug("%s: blackbox is inactive\n", __func__);
 		return err;
 	}
 
@@ -5029,7 +5840,7 @@ enum tfa98xx_error tfa_update_log(void)
 
 	read_size = TFA_LOG_MAX_COUNT * ndev * 3;
 
-	pr_info("%s: read from blackbox\n", __func__);
+	pr_debug("%s: read from blackbox\n", __func__);
 	err = tfa_dsp_cmd_id_write_read(tfa, MODULE_SPEAKERBOOST,
 		SB_PARAM_GET_DATA_LOGGER, read_size, cmd_buf);
 	if (err) {
@@ -5055,7 +5866,7 @@ enum tfa98xx_error tfa_update_log(void)
 		offset = channel * TFA_LOG_MAX_COUNT;
 		group = idx * ID_BLACKBOX_MAX;
 
-		pr_info("%s: dev %d - raw blackbox: [X = 0x%08x, T = 0x%08x]\n",
+		pr_debug("%s: dev %d - raw blackbox: [X = 0x%08x, T = 0x%08x]\n",
 			__func__, idx,
 			data[offset + ID_MAXX_LOG],
 			data[offset + ID_MAXT_LOG]);
@@ -5098,15 +5909,23 @@ enum tfa98xx_error tfa_update_log(void)
 		tfa->log_data[group + ID_OVERTMAX_COUNT]
 			+= data[offset + ID_OVERTMAX_COUNT];
 
+		if (sample) {
+			sample[idx].valid = 1;
+			sample[idx].maxx = data[offset + ID_MAXX_LOG];
+			sample[idx].maxt = data[offset + ID_MAXT_LOG];
+			sample[idx].overxmax = data[offset + ID_OVERXMAX_COUNT];
+			sample[idx].overtmax = data[offset + ID_OVERTMAX_COUNT];
+		}
+
 		for (i = 0; i < TFA_LOG_MAX_COUNT; i++)
-			pr_info("%s: dev %d - blackbox: data[%d] = %d (<- %d)\n",
+			pr_debug("%s: dev %d - blackbox: data[%d] = %d (<- %d)\n",
 				__func__, idx, i,
 				tfa->log_data[group + i],
 				data[offset + i]);
-		pr_info("%s: dev %d - blackbox: data[%d] = %d\n",
+		pr_debug("%s: dev %d - blackbox: data[%d] = %d\n",
 			__func__, idx, ID_MAXX_KEEP_LOG,
 			tfa->log_data[group + ID_MAXX_KEEP_LOG]);
-		pr_info("%s: dev %d - blackbox: data[%d] = %d\n",
+		pr_debug("%s: dev %d - blackbox: data[%d] = %d\n",
 			__func__, idx, ID_MAXT_KEEP_LOG,
 			tfa->log_data[group + ID_MAXT_KEEP_LOG]);
 	}
@@ -5114,7 +5933,7 @@ enum tfa98xx_error tfa_update_log(void)
 	return err;
 }
 
-enum tfa98xx_error tfa_update_log2(void)
+enum tfa98xx_error tfa_update_log2_sample(struct tfa_log_sample *sample)
 {
 	enum tfa98xx_error err = TFA98XX_ERROR_OK;
 	struct tfa_device *tfa = NULL, *ntfa = NULL;
@@ -5129,7 +5948,7 @@ enum tfa98xx_error tfa_update_log2(void)
 		return TFA98XX_ERROR_DEVICE; /* unused device */
 
 	if (!tfa->blackbox_enable) {
-		pr_info("%s: blackbox is inactive\n", __func__);
+		pr_debug("%s: blackbox is inactive\n", __func__);
 		return err;
 	}
 
@@ -5139,7 +5958,7 @@ enum tfa98xx_error tfa_update_log2(void)
 
 	read_size = ((TFA_LOG2_MAX_COUNT * ndev) + 1) * 3;
 
-	pr_info("%s: read from blackbox\n", __func__);
+	pr_debug("%s: read from blackbox\n", __func__);
 	err = tfa_dsp_cmd_id_write_read(tfa, MODULE_SPEAKERBOOST,
 		SB_PARAM_GET_DATA_LOGGER2, read_size, cmd_buf);
 	if (err) {
@@ -5149,7 +5968,7 @@ enum tfa98xx_error tfa_update_log2(void)
 	}
 
 	tfa98xx_convert_bytes2data(read_size, cmd_buf, data);
-	pr_info("%s: DataLogger command version 0x%x\n", __func__, data[0]);
+	pr_debug("%s: DataLogger command version 0x%x\n", __func__, data[0]);
 
 	for (idx = 0; idx < ndev; idx++) {
 		ntfa = tfa98xx_get_tfa_device_from_index(idx);
@@ -5171,7 +5990,7 @@ enum tfa98xx_error tfa_update_log2(void)
 			tfa->log_data[group + ID_MAXX_LOG]
 				= data[offset + ID2_MAXX_LOG];
 
-		pr_info("%s: dev %d - blackbox: data[%d] = %d (<- %d)\n",
+		pr_debug("%s: dev %d - blackbox: data[%d] = %d (<- %d)\n",
 				__func__, idx, ID_MAXX_LOG,
 				tfa->log_data[group + ID_MAXX_LOG],
 				data[offset + ID2_MAXX_LOG]);
@@ -5191,7 +6010,7 @@ enum tfa98xx_error tfa_update_log2(void)
 			tfa->log_data[group + ID_MAXT_LOG]
 				= data[offset + ID2_MAXT_LOG];
 
-		pr_info("%s: dev %d - blackbox: data[%d] = %d (<- %d)\n",
+		pr_debug("%s: dev %d - blackbox: data[%d] = %d (<- %d)\n",
 				__func__, idx, ID_MAXT_LOG,
 				tfa->log_data[group + ID_MAXT_LOG],
 				data[offset + ID2_MAXT_LOG]);
@@ -5206,7 +6025,7 @@ enum tfa98xx_error tfa_update_log2(void)
 		tfa->log_data[group + ID_OVERXMAX_COUNT]
 			+= data[offset + ID2_OVERXMAX_COUNT];
 
-		pr_info("%s: dev %d - blackbox: data[%d] = %d (<- %d)\n",
+		pr_debug("%s: dev %d - blackbox: data[%d] = %d (<- %d)\n",
 				__func__, idx, ID_OVERXMAX_COUNT,
 				tfa->log_data[group + ID_OVERXMAX_COUNT],
 				data[offset + ID2_OVERXMAX_COUNT]);
@@ -5215,25 +6034,33 @@ enum tfa98xx_error tfa_update_log2(void)
 		tfa->log_data[group + ID_OVERTMAX_COUNT]
 			+= data[offset + ID2_OVERTMAX_COUNT];
 
-		pr_info("%s: dev %d - blackbox: data[%d] = %d (<- %d)\n",
+		if (sample) {
+			sample[idx].valid = 1;
+			sample[idx].maxx = data[offset + ID2_MAXX_LOG];
+			sample[idx].maxt = data[offset + ID2_MAXT_LOG];
+			sample[idx].overxmax = data[offset + ID2_OVERXMAX_COUNT];
+			sample[idx].overtmax = data[offset + ID2_OVERTMAX_COUNT];
+		}
+
+		pr_debug("%s: dev %d - blackbox: data[%d] = %d (<- %d)\n",
 				__func__, idx, ID_OVERTMAX_COUNT,
 				tfa->log_data[group + ID_OVERTMAX_COUNT],
 				data[offset + ID2_OVERTMAX_COUNT]);
 
-		pr_info("%s: dev %d - blackbox: data[%d] = %d\n",
+		pr_debug("%s: dev %d - blackbox: data[%d] = %d\n",
 			__func__, idx, ID_MAXX_KEEP_LOG,
 			tfa->log_data[group + ID_MAXX_KEEP_LOG]);
-		pr_info("%s: dev %d - blackbox: data[%d] = %d\n",
+		pr_debug("%s: dev %d - blackbox: data[%d] = %d\n",
 			__func__, idx, ID_MAXT_KEEP_LOG,
 			tfa->log_data[group + ID_MAXT_KEEP_LOG]);
 
-		pr_info("%s: dev %d - blackbox: [MuteIC = %d, MuteOC = %d, OpenC = %d]\n",
+		pr_debug("%s: dev %d - blackbox: [MuteIC = %d, MuteOC = %d, OpenC = %d]\n",
 			__func__, idx,
 			data[offset + ID2_MUTEIN_COUNT],
 			data[offset + ID2_MUTEOUT_COUNT],
 			data[offset + ID2_OPEN_CIRCUIT]);
 	
-		pr_info("%s: dev %d - blackbox: [OCPC = %d, NOCLKC = %d]\n",
+		pr_debug("%s: dev %d - blackbox: [OCPC = %d, NOCLKC = %d]\n",
 			__func__, idx,
 			tfa->log_data[group + ID_OCP_COUNT],
 			tfa->log_data[group + ID_NOCLK_COUNT]);
@@ -5260,7 +6087,7 @@ enum tfa98xx_error tfa_read_tspkr(struct tfa_device *tfa, int *spkt)
 
 	if (tfa_count_status_flag(tfa, TFA_SET_DEVICE) != 0
 		|| tfa_count_status_flag(tfa, TFA_SET_CONFIG) != 0) {
-		pr_info("%s: skip if device is being configured\n", __func__);
+		pr_debug("%s: skip if device is being configured\n", __func__);
 		return TFA98XX_ERROR_DSP_NOT_RUNNING;
 	}
 
@@ -5276,14 +6103,15 @@ enum tfa98xx_error tfa_read_tspkr(struct tfa_device *tfa, int *spkt)
 
 	nr_bytes = (TEMP_INDEX + spkr_count) * 3;
 
-	pr_info("%s: read SB_PARAM_GET_TSPKR\n", __func__);
+	pr_debug("%s: read SB_PARAM_GET_TSPKR\n", __func__);
 	error = tfa_dsp_cmd_id_write_read(tfa,
 		MODULE_SPEAKERBOOST,
 		SB_PARAM_GET_TSPKR, nr_bytes, bytes);
 
 	if (error != TFA98XX_ERROR_OK) {
-		pr_info("%s: failure in reading speaker temperature (err %d)\n",
+		pr_err("%s: failure in reading speaker temperature (err %d)\n",
 			__func__, error);
+		tfa_event_log(tfa, TFA_EVENT_ERROR, TFA_EVENT_TSPKR, error);
 		return error;
 	}
 
@@ -5311,11 +6139,41 @@ enum tfa98xx_error tfa_read_tspkr(struct tfa_device *tfa, int *spkt)
 
 		spkt[i] = (int)(data[TEMP_INDEX + channel]
 			/ TFA2_FW_T_DATA_SCALE);
+		tfa_event_log(ntfa, TFA_EVENT_TSPKR, i, spkt[i]);
 	}
 
 	return error;
 }
 
+enum tfa98xx_error tfa_read_telemetry(struct tfa_device *tfa, int what,
+	struct tfa_telemetry *telemetry)
+{
+	enum tfa98xx_error err = TFA98XX_ERROR_OK;
+	int i;
+
+	if (what & TFA_TELEMETRY_TSPKR) {
+		for (i = 0; i < MAX_HANDLES; i++)
+			telemetry->spkt[i] = 0xffff;
+		telemetry->err_tspkr = tfa_read_tspkr(tfa, telemetry->spkt);
+		telemetry->time_tspkr = ktime_get();
+		err = telemetry->err_tspkr;
+	}
+
+	if (what & TFA_TELEMETRY_LOG) {
+		memset(telemetry->log, 0, sizeof(telemetry->log));
+#if defined(TFA_SUPPORT_NEW_DATALOGGER)
+		telemetry->err_log = tfa_update_log2_sample(telemetry->log);
+#else
+		telemetry->err_log = tfa_update_log_sample(telemetry->log);
+#endif
+		telemetry->time_log = ktime_get();
+		if (err == TFA98XX_ERROR_OK)
+			err = telemetry->err_log;
+	}
+
+	return err;
+}
+
 enum tfa98xx_error tfa_write_volume(struct tfa_device *tfa, int *sknt)
 {
 	enum tfa98xx_error error = TFA98XX_ERROR_OK;
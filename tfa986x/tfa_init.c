@@ -18,6 +18,12 @@
 #define TFA98XX_CURRENTSENSE4_CTRL_CLKGATECFOFF (1 << 2)
 #define TFA98XX_CURRENTSENSE4 0x49
 
+/*
+ * manstate changes in power up/down, in ms; used to be 50 reads
+ * back to back, a few ms on the bus
+ */
+#define TFA9866_MANSTATE_TIMEOUT_MS 50
+
 /*********************/
 /* GLOBAL (Defaults) */
 /*********************/
@@ -312,7 +318,8 @@ static enum tfa98xx_error tfa986x_specific(struct tfa_device *tfa)
 	tfa_set_bf(tfa, TFA9866_BF_PWDN, 0);
 	tfa_set_bf(tfa, TFA9866_BF_MANAOOSC, 0);
 
-	rc = tfa_wait4manstate(tfa, TFA9866_BF_MANSTATE, 1, 50);
+	rc = tfa_wait4manstate(tfa, TFA9866_BF_MANSTATE, 1,
+		TFA9866_MANSTATE_TIMEOUT_MS);
 	if (rc < 0) {
 		pr_err("Error, waiting powerdown leaving\n");
 		return rc;
@@ -503,7 +510,8 @@ static enum tfa98xx_error tfa986x_specific(struct tfa_device *tfa)
 	tfa_irq_init(tfa); /* init irq regs */
 
 	tfa_set_bf(tfa, TFA9866_BF_PWDN, 1); /* 1 = off */
-	rc = tfa_wait4manstate(tfa, TFA9866_BF_MANSTATE, 0, 50);
+	rc = tfa_wait4manstate(tfa, TFA9866_BF_MANSTATE, 0,
+		TFA9866_MANSTATE_TIMEOUT_MS);
 	if (rc < 0) {
 		pr_err("Timeout waiting for manstate 0\n");
 		return rc;
@@ -556,6 +564,17 @@ static int tfa986x_get_swvstep(struct tfa_device *tfa)
 	return tfa->vstep; /* vstep is not used */
 }
 
+/* vstep is not kept in the device: its register holds the fingerprint */
+static int tfa986x_set_fingerprint(struct tfa_device *tfa, uint16_t value)
+{
+	return tfa_set_bf_volatile(tfa, TFA9866_BF_SWVSTEP, value);
+}
+
+static int tfa986x_get_fingerprint(struct tfa_device *tfa)
+{
+	return tfa_get_bf(tfa, TFA9866_BF_SWVSTEP);
+}
+
 /* tfa98xx_dsp_system_stable
  *  return: *ready = 1 when clocks are stable to allow DSP subsystem access
  */
@@ -593,6 +612,8 @@ void tfa986x_ops(struct tfa_device_ops *ops)
 	ops->get_swprof = tfa986x_get_swprofile;
 	ops->set_swvstep = tfa986x_set_swvstep;
 	ops->get_swvstep = tfa986x_get_swvstep;
+	ops->set_fingerprint = tfa986x_set_fingerprint;
+	ops->get_fingerprint = tfa986x_get_fingerprint;
 	ops->dsp_system_stable = tfa986x_dsp_system_stable;
 	ops->set_mute = tfa_set_mute_nodsp;
 	ops->set_bitfield = tfa986x_set_bitfield;
@@ -31,6 +31,10 @@ static ssize_t sknt_store(struct device *dev,
 static DEVICE_ATTR_RW(sknt);
 #endif
 
+static ssize_t spkt_poll_show(struct device *dev,
+	struct device_attribute *attr, char *buf);
+static DEVICE_ATTR_RO(spkt_poll);
+
 static ssize_t power_state_show(struct device *dev,
 	struct device_attribute *attr, char *buf);
 static ssize_t power_state_store(struct device *dev,
@@ -57,6 +61,9 @@ static ssize_t sknt_r_store(struct device *dev,
 	struct device_attribute *attr, const char *buf, size_t size);
 static DEVICE_ATTR_RW(sknt_r);
 #endif
+static ssize_t spkt_poll_r_show(struct device *dev,
+	struct device_attribute *attr, char *buf);
+static DEVICE_ATTR_RO(spkt_poll_r);
 static ssize_t power_state_r_show(struct device *dev,
 	struct device_attribute *attr, char *buf);
 static ssize_t power_state_r_store(struct device *dev,
@@ -69,6 +76,7 @@ static struct attribute *tfa_stc_attr[] = {
 	&dev_attr_spkt.attr,
 	&dev_attr_sknt.attr,
 #endif
+	&dev_attr_spkt_poll.attr,
 	&dev_attr_power_state.attr,
 	&dev_attr_ocp_noclk.attr,
 #if defined(TFA_STEREO_NODE)
@@ -76,6 +84,7 @@ static struct attribute *tfa_stc_attr[] = {
 	&dev_attr_spkt_r.attr,
 	&dev_attr_sknt_r.attr,
 #endif
+	&dev_attr_spkt_poll_r.attr,
 	&dev_attr_power_state_r.attr,
 #endif /* TFA_STEREO_NODE */
 	NULL,
@@ -89,6 +98,56 @@ static struct attribute_group tfa_stc_attr_grp = {
 
 static struct device *tfa_stc_dev;
 
+/* wake up pollers of spkt_poll (and spkt) / spkt_poll_r (and spkt_r) */
+static int tfa_stc_spkt_notify(struct notifier_block *nb,
+	unsigned long channel, void *data)
+{
+	if (IS_ERR_OR_NULL(tfa_stc_dev))
+		return NOTIFY_DONE;
+
+	if (channel == 0) {
+		sysfs_notify(&tfa_stc_dev->kobj, NULL,
+			dev_attr_spkt_poll.attr.name);
+#if !defined(TFA_PLATFORM_QUALCOMM)
+		sysfs_notify(&tfa_stc_dev->kobj, NULL,
+			dev_attr_spkt.attr.name);
+#endif
+	}
+#if defined(TFA_STEREO_NODE)
+	else if (channel == 1) {
+		sysfs_notify(&tfa_stc_dev->kobj, NULL,
+			dev_attr_spkt_poll_r.attr.name);
+#if !defined(TFA_PLATFORM_QUALCOMM)
+		sysfs_notify(&tfa_stc_dev->kobj, NULL,
+			dev_attr_spkt_r.attr.name);
+#endif
+	}
+#endif
+
+	return NOTIFY_OK;
+}
+
+static struct notifier_block tfa_stc_spkt_nb = {
+	.notifier_call = tfa_stc_spkt_notify,
+};
+
+/* read-only cached speaker temperature, on every platform, for poll() */
+static ssize_t spkt_poll_show(struct device *dev,
+	struct device_attribute *attr, char *buf)
+{
+	return snprintf(buf, FILESIZE_STC, "%d",
+		tfa98xx_get_spkt_cached(0));
+}
+
+#if defined(TFA_STEREO_NODE)
+static ssize_t spkt_poll_r_show(struct device *dev,
+	struct device_attribute *attr, char *buf)
+{
+	return snprintf(buf, FILESIZE_STC, "%d",
+		tfa98xx_get_spkt_cached(1));
+}
+#endif
+
 #if !defined(TFA_PLATFORM_QUALCOMM)
 static int sknt_data[MAX_HANDLES];
 
@@ -131,8 +190,8 @@ static ssize_t spkt_show(struct device *dev,
 	int value = 0, size;
 	char spkt_result[FILESIZE_STC] = {0};
 
-	value = tfa98xx_update_spkt_data(idx);
-	pr_info("%s: tfa_stc - dev %d - speaker temperature (%d)\n",
+	value = tfa98xx_get_spkt_cached(0);
+	pr_debug("%s: tfa_stc - dev %d - speaker temperature (%d)\n",
 		__func__, idx, value);
 
 	snprintf(spkt_result, FILESIZE_STC,
@@ -294,8 +353,8 @@ static ssize_t spkt_r_show(struct device *dev,
 	int value = 0, size;
 	char spkt_result[FILESIZE_STC] = {0};
 
-	value = tfa98xx_update_spkt_data(idx);
-	pr_info("%s: tfa_stc - dev %d - speaker temperature (%d)\n",
+	value = tfa98xx_get_spkt_cached(1);
+	pr_debug("%s: tfa_stc - dev %d - speaker temperature (%d)\n",
 		__func__, idx, value);
 
 	snprintf(spkt_result, FILESIZE_STC,
@@ -419,6 +478,9 @@ int tfa98xx_stc_init(struct class *tfa_class)
 			if (ret)
 				pr_err("%s: failed to create sysfs group. ret (%d)\n",
 					__func__, ret);
+			else
+				tfa98xx_spkt_register_notifier(
+					&tfa_stc_spkt_nb);
 		}
 	}
 
@@ -430,6 +492,7 @@ int tfa98xx_stc_init(struct class *tfa_class)
 
 void tfa98xx_stc_exit(struct class *tfa_class)
 {
+	tfa98xx_spkt_unregister_notifier(&tfa_stc_spkt_nb);
 	device_destroy(tfa_class, DEV_ID_TFA_STC);
 	pr_info("exited\n");
 }